@@ -0,0 +1,43 @@
+#pragma once
+
+#include "simd.h"
+
+#include <cstddef>
+#include <optional>
+
+
+// Base 64 (RFC 4648) en- and decoding with lookup tables,
+// the SIMD kernels translate 12 bytes (SSE4.1) or 24 bytes (AVX2) at once
+namespace base64 {
+    // returns the number of chars the given number of bytes is encoded to,
+    // including the padding
+    inline size_t encoded_size(size_t size) {
+        return (size + 2) / 3 * 4;
+    }
+
+    // returns the largest number of bytes the given number of chars
+    // can be decoded to
+    inline size_t decoded_size(size_t size) {
+        return size / 4 * 3 + (size % 4 * 3) / 4;
+    }
+
+    // writes the encoding of the given bytes to encoded,
+    // which needs to hold encoded_size(size) chars
+    void encode(
+        const unsigned char* data,
+        size_t size,
+        char* encoded,
+        simd::Kernel = simd::best_kernel()
+    );
+
+    // writes the decoding of the given chars to decoded, which needs to hold
+    // decoded_size(size) bytes, and returns the number of decoded bytes,
+    // a missing padding is accepted, returns nothing if a char isn't part of
+    // the alphabet, padding chars aren't at the end or the size is 1 mod 4
+    std::optional<size_t> decode(
+        const char* encoded,
+        size_t size,
+        unsigned char* decoded,
+        simd::Kernel = simd::best_kernel()
+    );
+}
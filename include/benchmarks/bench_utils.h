@@ -0,0 +1,35 @@
+#pragma once
+
+#include <chrono>
+#include <functional>
+#include <string>
+#include <vector>
+
+
+// A named benchmark,
+// every global Benchmark object gets run by the benchmarks executable
+struct Benchmark {
+    std::string name;
+    std::function<void()> run;
+
+    Benchmark(std::string name, std::function<void()> run);
+};
+
+// returns all registered benchmarks
+std::vector<Benchmark*>& get_benchmarks();
+
+
+// runs the given function the given number of times
+// and returns the fastest of its durations
+std::chrono::nanoseconds measure(
+    const std::function<void()>&,
+    unsigned int repetitions = 5
+);
+
+// prints the duration of processing the given number of bytes
+// together with the resulting throughput
+void report(
+    const std::string& label,
+    size_t bytes,
+    std::chrono::nanoseconds duration
+);
@@ -3,7 +3,14 @@
 #include "config.h"
 #include "internal_msg.h"
 #include "pipe.h"
+#include "messages/basic.pb.h"
 
 
-// runs the synchronization client
-int run_client(const ServerData&, SendingPipe<InternalMsgWithOriginator>&);
+// runs the synchronization client, which proposes the given framing
+// and number of requests in flight to the server
+int run_client(
+    const ServerData&, 
+    Framing, 
+    size_t window,
+    SendingPipe<InternalMsgWithOriginator>&
+);
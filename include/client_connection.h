@@ -0,0 +1,106 @@
+#pragma once
+
+#include "internal_msg.h"
+#include "pipe.h"
+#include "utils.h"
+#include "messages/all.pb.h"
+
+#include <asio/io_context.hpp>
+#include <asio/io_context_strand.hpp>
+#include <asio/ip/tcp.hpp>
+#include <asio/streambuf.hpp>
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+
+// A client of the server, whose requests are read and answered
+// asynchronously on the io_context. All handlers of a connection run
+// on its strand. The requests are handed to the file operator without
+// waiting for it, its responses get posted back to the strand and are
+// written as soon as they are ready, so they may be out of order.
+// Reading pauses while the agreed window of requests is in flight.
+class ClientConnection: public std::enable_shared_from_this<ClientConnection> {
+  private:
+    // The pipe to which the file operator sends the responses,
+    // sending posts them to the strand of the connection
+    class Responses: public SendingPipe<InternalMsg> {
+      private:
+        ClientConnection& connection;
+
+      public:
+        Responses(ClientConnection& connection): connection{connection} {}
+
+        void close() override {}
+
+        bool is_open() const override { return true; }
+        bool is_closed() const override { return false; }
+
+        bool is_empty() const override { return true; }
+        bool is_not_empty() const override { return false; }
+
+        bool send(const std::vector<InternalMsg>&) override;
+        bool send(InternalMsg) override;
+    };
+
+    asio::ip::tcp::socket socket;
+    asio::io_context::strand strand;
+    SendingPipe<InternalMsgWithOriginator>& file_operator;
+    std::atomic<size_t>& connections;
+    const size_t max_window;
+
+    Responses responses{*this};
+    // keeps the connection alive while the file operator holds
+    // a reference to its responses
+    std::shared_ptr<ClientConnection> self{};
+    size_t at_file_operator{0};
+
+    // a line of base 64 above the maximum frame size doesn't fit
+    asio::streambuf input{(MAX_FRAME_SIZE + 2) / 3 * 4 + 1};
+    std::deque<std::string> output{};
+    bool reading{false};
+    bool writing{false};
+
+    // every client starts with base 64 lines and one request at a time
+    // and may propose others in a handshake
+    Framing framing{FRAMING_BASE64};
+    size_t window{1};
+    // the requests at the file operator and the responses not written yet
+    // together fill the window
+    size_t in_flight{0};
+
+    std::optional<Message> finish{};
+    bool finish_sent{false};
+    bool closed{false};
+
+    size_t get_missing_bytes();
+    void read_request();
+    void handle_request(const Message&);
+    void dispatch(const Message&);
+    void answer(std::vector<InternalMsg>&&);
+    void respond(const std::vector<Message>&);
+    void write_response();
+    void finish_if_answered();
+    void read_request_if_paused();
+    void close();
+
+  public:
+    ClientConnection(
+        asio::io_context&,
+        asio::ip::tcp::socket&&,
+        SendingPipe<InternalMsgWithOriginator>& file_operator,
+        std::atomic<size_t>& connections,
+        size_t max_window
+    );
+    ~ClientConnection();
+
+    // starts reading the requests
+    void start();
+
+    // closes the connection after the file operator finished, 
+    // so it doesn't wait for the responses to dropped requests
+    void stop();
+};
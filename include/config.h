@@ -29,12 +29,36 @@ struct SyncConfig {
     bool sync_hidden_files{false};
     size_t number_of_workers{4};
     unsigned short minutes_between{5};
+    std::string strong_hash{"md5"};
+    size_t tree_hash_threshold{256}; // in MiB
+    size_t hash_threads{0}; // 0 ... number_of_workers
+    std::string chunking{"fixed"}; // fixed or content-defined
+    std::string weak_hash{"checksum32"}; // checksum32 or rabin-karp64
+    size_t range_threshold{0}; // in MiB, 0 ... never
+    bool one_round_trip{false};
+    size_t refinement_floor{0}; // in B, 0 ... gaps aren't refined
+    std::string framing{"base64"}; // base64 or binary
+    size_t requests_in_flight{16};
+    size_t server_threads{0}; // 0 ... one per core
+    size_t max_clients{64};
 
     NLOHMANN_DEFINE_TYPE_INTRUSIVE(
         SyncConfig, 
         sync_hidden_files, 
         number_of_workers, 
-        minutes_between
+        minutes_between,
+        strong_hash,
+        tree_hash_threshold,
+        hash_threads,
+        chunking,
+        weak_hash,
+        range_threshold,
+        one_round_trip,
+        refinement_floor,
+        framing,
+        requests_in_flight,
+        server_threads,
+        max_clients
     )
 
     operator std::string() {
@@ -43,7 +67,19 @@ struct SyncConfig {
             << std::boolalpha
             << "{\"sync hidden files\": " << sync_hidden_files << ", "
             << "\"number of workers\": "  << number_of_workers << ", "
-            << "\"minutes between\": "    << minutes_between   << "}";
+            << "\"minutes between\": "    << minutes_between   << ", "
+            << "\"strong hash\": \""      << strong_hash       << "\", "
+            << "\"tree hash threshold\": " << tree_hash_threshold << ", "
+            << "\"hash threads\": "     << hash_threads      << ", "
+            << "\"chunking\": \""        << chunking          << "\", "
+            << "\"weak hash\": \""       << weak_hash         << "\", "
+            << "\"range threshold\": "  << range_threshold   << ", "
+            << "\"one round trip\": "   << one_round_trip    << ", "
+            << "\"refinement floor\": " << refinement_floor  << ", "
+            << "\"framing\": \""        << framing           << "\", "
+            << "\"requests in flight\": " << requests_in_flight << ", "
+            << "\"server threads\": "   << server_threads    << ", "
+            << "\"max clients\": "      << max_clients       << "}";
 
         return output.str();
     }
@@ -22,6 +22,10 @@ namespace db {
     Result<msg::File> get_file(FileName);
     std::vector<msg::File> get_files();
 
+    // the block signatures of a file get deleted together with the file
+    void insert_block_signatures(msg::BlockSignatures);
+    Result<msg::BlockSignatures> get_block_signatures(FileName);
+
     void insert_removed(msg::Removed);
     void insert_removed(std::vector<msg::Removed>);
     void delete_removed(FileName);
@@ -0,0 +1,42 @@
+#pragma once
+
+#include "simd.h"
+#include "type/definitions.h"
+
+#include <cstddef>
+
+
+// The implementations (kernels) of the rolling weak checksum,
+// the fastest one supported by the CPU gets picked at runtime
+namespace checksum {
+    // the two 16 bit sums which make up a weak signature
+    struct Sums {
+        unsigned int r1;
+        unsigned int r2;
+    };
+
+    // returns the weak signature (r1 + 2^16 * r2) of the given sums
+    inline WeakSign to_signature(Sums sums) {
+        return (sums.r1 & 0xffff) | ((sums.r2 & 0xffff) << 16);
+    }
+
+    // returns the sums of the block of given size starting at data
+    Sums block_sums(
+        const unsigned char* data,
+        BlockSize block_size,
+        simd::Kernel = simd::best_kernel()
+    );
+
+    // rolls the sums of the block starting at data forward by count bytes
+    // and writes the signature at each new offset to signatures,
+    // data needs to hold block_size + count bytes,
+    // returns the sums of the block at the last offset
+    Sums roll(
+        const unsigned char* data,
+        BlockSize block_size,
+        size_t count,
+        Sums,
+        WeakSign* signatures,
+        simd::Kernel = simd::best_kernel()
+    );
+}
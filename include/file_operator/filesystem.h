@@ -4,34 +4,133 @@
 #include "messages/basic.h"
 #include "type/result.h"
 
+#include <cstdint>
 #include <filesystem>
+#include <functional>
 #include <string>
 #include <unordered_map>
 #include <utility>
 #include <vector>
 
 namespace fs {
+    // How the strong signatures of whole files get computed
+    struct Hashing {
+        HashAlgorithm algorithm{HASH_MD5};
+        // files of at least this size get tree hashed in chunks 
+        // of TREE_HASH_CHUNK_SIZE on up to threads threads, 0 ... never
+        size_t tree_threshold{0};
+        size_t threads{1};
+    };
+
     std::vector<std::filesystem::path> get_file_paths(bool include_hidden);
 
     bool is_hidden(const std::filesystem::path&);
     bool is_not_hidden(const std::filesystem::path&);
 
-    std::vector<Result<msg::File>> get_files(const std::vector<std::filesystem::path>&);
-    Result<msg::File> get_file(const std::filesystem::path&);
+    // The status of a file, which changes with every change of its content
+    struct Stat {
+        uint64_t inode;
+        uint64_t device;
+        size_t size;
+        int64_t mtime_ns;
+        int64_t ctime_ns;
+    };
+
+    Result<Stat> get_stat(const std::filesystem::path&);
+
+    // checks if the file still has the status with which it was hashed
+    bool is_unchanged(const msg::File&, const Stat&);
+
+    // known files whose status didn't change are taken over without hashing
+    std::vector<Result<msg::File>> get_files(
+        const std::vector<std::filesystem::path>&,
+        const Hashing&,
+        const std::unordered_map<FileName, msg::File>& known = {}
+    );
+    Result<msg::File> get_file(const std::filesystem::path&, const Hashing&);
+
+    // returns the strong signature of the whole file, which gets hashed at once 
+    // with a chunk size of 0 and otherwise as tree hash on up to threads threads
+    Result<StrongSign> get_file_signature(
+        const std::filesystem::path&,
+        HashAlgorithm,
+        size_t chunk_size = 0,
+        size_t threads = 1
+    );
+
+    // returns the weak signatures of the consecutive blocks of the file
+    Result<std::vector<WeakSign>> get_request_signatures(
+        const std::filesystem::path&, 
+        BlockSize = BLOCK_SIZE
+    );
+    Result<std::vector<WeakSign64>> get_request_signatures64(
+        const std::filesystem::path&, 
+        BlockSize = BLOCK_SIZE
+    );
+    Result<std::vector<WeakSign>> get_weak_signatures(
+        const std::filesystem::path&, 
+        BlockSize = BLOCK_SIZE
+    );
+
+    // returns the weak and strong signatures of the consecutive blocks of the file
+    Result<BlockSignatures> get_block_signatures(
+        const std::filesystem::path&, 
+        HashAlgorithm,
+        BlockSize = BLOCK_SIZE
+    );
+
+    // cuts the file into content defined chunks, see ::get_chunks
+    Result<std::vector<Chunk>> get_chunks(const std::filesystem::path&);
+
+    // streams the weak signatures at all offsets of the file in batches,
+    // see ::stream_weak_signatures
+    Result<bool> stream_weak_signatures(
+        const std::filesystem::path&,
+        BlockSize,
+        const std::function<void(Offset, const std::vector<WeakSign>&)>& consume
+    );
+
+    // streams the weak signatures at all offsets of the given range of the file
+    Result<bool> stream_weak_signatures(
+        const std::filesystem::path&,
+        BlockSize,
+        Offset,
+        size_t size,
+        const std::function<void(Offset, const std::vector<WeakSign>&)>& consume
+    );
 
-    Result<std::vector<WeakSign>> get_request_signatures(const std::filesystem::path&);
-    Result<std::vector<WeakSign>> get_weak_signatures(const std::filesystem::path&);
+    Result<bool> stream_weak_signatures64(
+        const std::filesystem::path&,
+        BlockSize,
+        const std::function<void(Offset, const std::vector<WeakSign64>&)>& consume
+    );
 
     Result<WeakSign> get_weak_signature(
         const std::filesystem::path&,
         BlockSize = BLOCK_SIZE,
         Offset = 0
     );
+    Result<WeakSign64> get_weak_signature64(
+        const std::filesystem::path&,
+        BlockSize = BLOCK_SIZE,
+        Offset = 0
+    );
 
     Result<StrongSign> get_strong_signature(
         const std::filesystem::path&,
         BlockSize,
-        Offset
+        Offset,
+        HashAlgorithm
+    );
+
+    // returns the strong signatures of the given (offset, size) ranges 
+    // in the given order, the file is opened once per thread, 
+    // which reads batches of ranges in ascending order
+    Result<std::vector<StrongSign>> get_range_signatures(
+        const std::filesystem::path&,
+        const std::vector<std::pair<Offset, size_t>>& ranges,
+        HashAlgorithm,
+        size_t threads = 1
     );
 
     // read at given offset(s) with given size(s)
@@ -48,12 +147,35 @@ namespace fs {
     // read whole file
     Result<std::string> read(const std::filesystem::path&);
 
+    // reads at most max_size bytes at the given offset, 
+    // fewer at the end of the file
+    Result<std::pair<std::string, bool /* more */>> read_file_chunk(
+        const std::filesystem::path&,
+        Offset,
+        size_t max_size
+    );
+
     // write new file
     Result<bool> write(
         const std::filesystem::path&,
         std::string&& data
     );
 
+    // writes the data at the given offset,
+    // a chunk at offset 0 starts the file anew
+    Result<bool> write_file_chunk(
+        const std::filesystem::path&,
+        Offset,
+        const std::string& data
+    );
+
+    // the temporary file into which the given file is received
+    std::filesystem::path get_receiving_path(const std::filesystem::path&);
+
+    // the received file replaces the local one only if it has the size and
+    // signature of the given file, else it's removed and false is returned
+    Result<bool> move_received_file(const msg::File& received_file);
+
     Result<bool> move_file(
         const std::filesystem::path& old_path, 
         const std::filesystem::path& new_path
@@ -61,8 +183,11 @@ namespace fs {
 
     void remove_file(const std::filesystem::path&);
 
+    // builds the file from the data and its own blocks, the built file 
+    // replaces it only if it has the signature of the given file, else false
     Result<bool> build_file(
         std::vector<std::pair<msg::Data, bool /* has data */>>&&,
-        const std::filesystem::path&
+        const std::filesystem::path&,
+        const msg::File& built_file
     );
 }
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "type/definitions.h"
+
+#include <condition_variable>
+#include <deque>
+#include <filesystem>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+
+// The files which still have to be hashed, they get hashed in batches 
+// by a background thread, unless they are needed earlier
+class HashQueue {
+  private:
+    std::function<void(const std::vector<std::filesystem::path>&)> hash;
+    const size_t batch_size;
+
+    std::deque<std::filesystem::path> waiting{};
+    std::unordered_set<FileName> waiting_names{};
+    std::unordered_set<FileName> hashing{};
+    bool stopped{false};
+
+    std::mutex queue_mtx{};
+    std::condition_variable queue_changed{};
+
+    std::thread worker;
+
+    void run();
+    void hash_now(
+        const std::vector<std::filesystem::path>&, 
+        std::unique_lock<std::mutex>&
+    );
+
+  public:
+    // the given hash function must not throw,
+    // it gets up to batch_size waiting files at once
+    HashQueue(
+        std::function<void(const std::vector<std::filesystem::path>&)> hash,
+        size_t batch_size = 1
+    );
+    ~HashQueue();
+
+    // queues the given files, files which are already queued are skipped
+    void push(const std::vector<std::filesystem::path>&);
+
+    // hashes the file right away, if it is still waiting,
+    // or waits until it is hashed, if that is already happening
+    void prioritise(const FileName&);
+    // the same for many files, the waiting ones get hashed in one batch
+    void prioritise(const std::vector<FileName>&);
+
+    // checks if the file is waiting or being hashed
+    bool is_pending(const FileName&);
+
+    // returns the files which are waiting or being hashed
+    std::vector<FileName> get_pending();
+
+    // waits until all queued files are hashed
+    void wait();
+};
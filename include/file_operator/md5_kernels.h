@@ -0,0 +1,24 @@
+#pragma once
+
+#include "simd.h"
+#include "type/definitions.h"
+
+#include <cstddef>
+
+
+// Multi-buffer MD5, which hashes several blocks of the same size at once,
+// one block per SIMD lane, with the fastest kernel supported by the CPU
+namespace md5 {
+    // returns the number of blocks the given kernel hashes at once
+    size_t lanes(simd::Kernel);
+
+    // hashes count blocks of the given size, block i starts at blocks[i],
+    // and writes their MD5 digests to digests
+    void hash_blocks(
+        const unsigned char* const* blocks,
+        size_t count,
+        size_t block_size,
+        StrongSign* digests,
+        simd::Kernel = simd::best_kernel()
+    );
+}
@@ -1,23 +1,45 @@
 #pragma once
 
 #include "config.h"
+#include "file_operator/filesystem.h"
 #include "messages/basic.h"
 #include "type/definitions.h"
 #include "messages/sync.pb.h"
 
 #include <filesystem>
+#include <unordered_map>
 #include <vector>
 
 
 // gets the paths of all files which are to be synced according to the provided config
 std::vector<std::filesystem::path> get_file_paths(const Config&);
 
+// returns how to hash whole files according to the provided config
+fs::Hashing get_hashing(const Config&);
+
+// returns how to cut files into blocks according to the provided config
+Chunking get_chunking(const Config&);
+
+// returns the rolling hash of the weak signatures according to the provided config
+WeakHash get_weak_hash(const Config&);
+
+// returns the smallest block size to which the gaps between matches get refined
+// according to the provided config, 0 if they aren't refined
+BlockSize get_refinement_floor(const Config&);
+
 // gets tha meta information of all files at the given paths 
-// and returns all successful reads
-std::vector<msg::File> get_files(std::vector<std::filesystem::path>&&);
+// and returns all successful reads,
+// known files whose status didn't change are not hashed again
+std::vector<msg::File> get_files(
+    std::vector<std::filesystem::path>&&, 
+    const fs::Hashing&,
+    const std::unordered_map<FileName, msg::File>& known = {}
+);
 
 // correct the file with the given file name based on the data which is in the database
-void correct(const FileName&);
+// builds the file from the stored corrections, 
+// returns whether it got the signature of the given file
+bool correct(const File& corrected_file);
 
 // remove the file with the given file name from the filesystem and the database
 // and register its removal in the database
@@ -29,3 +51,8 @@ Corrections* get_corrections(
     const FileName&,
     bool final = false
 );
+
+// corrections are read at the server side of a pair and replace its client side,
+// so the pairs of the server which the client is requested to correct get 
+// their sides swapped, the client reads its blocks and the server's get replaced
+std::vector<BlockPair*> swap_sides(std::vector<BlockPair*>&&);
@@ -1,18 +1,88 @@
 #pragma once
 
+#include "file_operator/strong_hash.h"
+#include "type/block_signatures.h"
 #include "type/definitions.h"
 
+#include <functional>
 #include <istream>
 #include <vector>
 #include <string>
 
 
+// the block size of peers which don't choose one per file
 const BlockSize BLOCK_SIZE{6000};
 
+// the bounds of the block size chosen per file
+const BlockSize MIN_BLOCK_SIZE{700};
+const BlockSize MAX_BLOCK_SIZE{1 << 17};
 
-// returns the strong signature (MD5) of the given data
-StrongSign get_strong_signature(const std::string&);
-StrongSign get_strong_signature(std::istream&);
+// the size of the buffer in which streamed data is read at once
+const size_t STREAM_BUFFER_SIZE{1 << 20};
+
+// the size of the chunks in which files are transferred
+const size_t FILE_CHUNK_SIZE{1 << 20};
+
+// the size of the chunks which get hashed independently for a tree hash
+const size_t TREE_HASH_CHUNK_SIZE{1 << 24};
+
+// the bounds of content defined chunks
+const BlockSize MIN_CHUNK_SIZE{2048};
+const BlockSize AVERAGE_CHUNK_SIZE{8192};
+const BlockSize MAX_CHUNK_SIZE{65536};
+
+
+// A block whose end is defined by its content, together with its weak signature
+struct Chunk {
+    Offset offset;
+    BlockSize size;
+    WeakSign signature;
+};
+
+
+// returns the block size for a file of the given size, the square root 
+// of the size rounded up to a multiple of 8 within the bounds (like rsync),
+// so the number of blocks only grows with the square root of the size as well
+BlockSize get_block_size(size_t file_size);
+
+// returns how many bytes of the strong signatures of the blocks of a file 
+// are sent together with their weak signatures, enough that a false match 
+// is unlikely in a file of the given size (like rsync's s2length)
+size_t get_strong_signature_length(size_t file_size, BlockSize);
+
+
+// returns the strong signature of the given data with the given algorithm
+StrongSign get_strong_signature(
+    const std::string&, 
+    HashAlgorithm = HASH_MD5
+);
+StrongSign get_strong_signature(
+    std::istream&, 
+    HashAlgorithm = HASH_MD5
+);
+
+// returns the strong signatures of blocks of the same size, MD5 hashes 
+// as many blocks at once as the CPU has SIMD lanes for
+std::vector<StrongSign> get_strong_signatures(
+    const std::vector<const char*>& blocks,
+    BlockSize,
+    HashAlgorithm = HASH_MD5
+);
+
+// returns the signatures of the consecutive blocks of the given size,
+// MD5 hashes the whole blocks of each buffer at once like get_strong_signatures
+BlockSignatures get_block_signatures(
+    std::istream&, 
+    HashAlgorithm,
+    BlockSize
+);
+
+// returns the root of a tree hash,
+// the strong signature of the concatenated signatures of all chunks
+StrongSign get_tree_signature(
+    const std::vector<StrongSign>& chunk_signatures,
+    HashAlgorithm = HASH_MD5
+);
 
 // returns the weak signature of the specified data
 WeakSign get_weak_signature(
@@ -39,3 +109,54 @@ std::vector<WeakSign> get_weak_signatures(
     Offset initial_offset = 0
 );
 
+// returns the 64 bit weak signature of the specified data, a polynomial 
+// (Rabin-Karp) rolling hash modulo 2^64, which has far fewer false matches 
+// than the 32 bit weak signature in large files
+WeakSign64 get_weak_signature64(const unsigned char* data, BlockSize);
+WeakSign64 get_weak_signature64(
+    const std::string& data,  
+    BlockSize block_size = BLOCK_SIZE,
+    Offset offset = 0
+);
+WeakSign64 get_weak_signature64(
+    std::istream& data,  
+    BlockSize block_size = BLOCK_SIZE,
+    Offset offset = 0
+);
+
+// returns the 64 bit weak signatures at all offsets for the given data 
+std::vector<WeakSign64> get_weak_signatures64(
+    const std::string& data,  
+    BlockSize block_size = BLOCK_SIZE,
+    Offset initial_offset = 0
+);
+
+// returns the size of the content defined chunk at the start of the data,
+// it ends where a gear hash over its bytes matches a mask (FastCDC), 
+// the mask has more bits before and less bits after the average chunk size
+BlockSize get_chunk_size(const unsigned char* data, size_t size);
+
+// cuts the data into content defined chunks, equal content is cut equally
+// regardless of its offset, so insertions only change the chunks around them
+std::vector<Chunk> get_chunks(const std::string& data);
+std::vector<Chunk> get_chunks(std::istream& data, size_t data_size);
+
+// reads the given data once through a sliding buffer and passes 
+// the weak signatures at all offsets in consecutive batches to consume,
+// together with the offset of the first signature in the batch
+void stream_weak_signatures(
+    std::istream& data, 
+    size_t data_size,
+    BlockSize block_size,
+    Offset initial_offset,
+    const std::function<void(Offset, const std::vector<WeakSign>&)>& consume
+);
+
+// like stream_weak_signatures with the 64 bit weak signatures
+void stream_weak_signatures64(
+    std::istream& data, 
+    size_t data_size,
+    BlockSize block_size,
+    Offset initial_offset,
+    const std::function<void(Offset, const std::vector<WeakSign64>&)>& consume
+);
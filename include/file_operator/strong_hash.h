@@ -0,0 +1,45 @@
+#pragma once
+
+#include "type/definitions.h"
+#include "messages/basic.pb.h"
+
+#include <cstddef>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+
+// The hash functions (algorithms) for strong signatures,
+// client and server agree on one of them per session
+namespace strong_hash {
+    // An incremental hash function,
+    // digests longer than a StrongSign get truncated
+    class Hasher {
+      public:
+        virtual ~Hasher() = default;
+
+        virtual void update(const char* data, size_t size) = 0;
+        virtual StrongSign finish() = 0;
+    };
+
+    // returns a new hasher for the given algorithm,
+    // throws std::invalid_argument if it is not supported by this build
+    std::unique_ptr<Hasher> make_hasher(HashAlgorithm);
+
+    // returns all algorithms supported by this build, MD5 is always supported
+    std::vector<HashAlgorithm> supported_algorithms();
+    bool is_supported(HashAlgorithm);
+
+    // the names of the algorithms in the config: md5, xxh3 and blake3
+    std::string algorithm_name(HashAlgorithm);
+    std::optional<HashAlgorithm> from_name(const std::string&);
+
+    // returns the supported algorithms to offer to a peer,
+    // the preferred one first and MD5 as the last resort
+    std::vector<HashAlgorithm> offered_algorithms(HashAlgorithm preferred);
+
+    // picks the first of the offered algorithms which is supported,
+    // MD5 if the peer offers none (as older versions do)
+    HashAlgorithm negotiate(const std::vector<HashAlgorithm>& offered);
+}
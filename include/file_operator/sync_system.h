@@ -1,12 +1,15 @@
 #pragma once
 
 #include "config.h"
+#include "file_operator/filesystem.h"
+#include "file_operator/hash_queue.h"
 #include "messages/basic.h"
 #include "type/definitions.h"
 #include "type/result.h"
 #include "messages/all.pb.h"
 
 #include <filesystem>
+#include <optional>
 #include <vector>
 
 
@@ -14,15 +17,67 @@
 class SyncSystem {
   private:
     const Config& config;
-
-    Result<Message> start_sync(msg::File);
+    const fs::Hashing hashing;
+    HashQueue hash_queue;
+
+    void reconcile();
+    void rehash(const std::vector<std::filesystem::path>&);
+    Result<msg::File> get_verified_file(const FileName&);
+    std::optional<BlockSignatures> get_stored_block_signatures(const FileName&);
+    Result<BlockSignatures> get_block_signatures(
+        const msg::File&, 
+        HashAlgorithm, 
+        BlockSize
+    );
+
+    bool is_equal(const msg::File& local_file, const File& server_file);
+
+    Result<Message> start_sync(msg::File, const FileList& session);
+    Result<Message> start_matching(msg::File, const FileList& session);
+    template<typename Signature>
+    Result<Message> request_matching(msg::File, HashAlgorithm, BlockSize);
+    Result<Message> get_range_signatures(
+        msg::File, 
+        HashAlgorithm, 
+        BlockSize, 
+        size_t range_size, 
+        const std::vector<Offset>&
+    );
     Message notify_already_removed(const File&);
     Message request(const File&);
 
     Result<Message> sync(const SyncRequest&, msg::File);
+    Result<std::vector<BlockPair*>> match_blocks(const SyncRequest&, const msg::File&);
+    template<typename Signature>
+    Result<std::vector<BlockPair*>> match_blocks(
+        const SyncRequest&, 
+        const msg::File&, 
+        std::vector<Signature>&& client_signatures
+    );
+    Result<std::vector<BlockPair*>> match_chunks(const SyncRequest&, const msg::File&);
+    Result<std::vector<BlockPair*>> confirm_matches(
+        const SyncRequest&, 
+        const msg::File&, 
+        std::vector<BlockPair*>&&
+    );
     Message respond_already_removed(const File&);
     Message respond_requesting(const File&);
 
+    bool apply(const Corrections&, const File& corrected_file);
+
+    Result<Message> compare_ranges(const RangeSignatures&, msg::File);
+
+    Message refine_gaps(
+        const File& client_file,
+        msg::File local_file,
+        std::vector<BlockPair*>&& gaps,
+        HashAlgorithm,
+        BlockSize matched_block_size,
+        BlockSize refinement_floor
+    );
+    Result<Message> match_gaps(const GapSignatures&, msg::File);
+    Result<Message> get_gap_signatures(const File&, const GapRequest&);
+
     std::vector<Message> sync(const SyncResponse&);
 
   public:
@@ -42,7 +97,13 @@ class SyncSystem {
 
     Message get_sync_response(const SignatureAddendum&);
 
-    Message get_file(const File&);
+    Message get_sync_response(const RangeSignatures&);
+
+    Message get_range_signatures(const RangeRequest&);
+
+    Message get_sync_response(const GapSignatures&);
+
+    Message get_file(const File&, Offset = 0);
 
     Message create_file(const FileResponse&);
 
@@ -1,9 +1,12 @@
 #pragma once
 
+#include "file_operator/signatures.h"
 #include "messages/basic.h"
 #include "type/definitions.h"
 #include "messages/sync.pb.h"
 
+#include <cstdint>
+#include <optional>
 #include <utility>
 #include <vector>
 
@@ -16,6 +19,13 @@ std::vector<BlockPair*> get_block_pairs_between(
     size_t server_file_size
 );
 
+// returns the block pairs which fill the missing spaces in the given block pairs,
+// which lie within the given gap
+std::vector<BlockPair*> get_block_pairs_between(
+    std::vector<BlockPair*>& matching,
+    const BlockPair& gap
+);
+
 // returns the data blocks which fill the missing spaces in the given blocks
 // and denote if the block has data
 std::vector<std::pair<msg::Data, bool /* has data */>> get_data_spaces(
@@ -24,3 +34,195 @@ std::vector<std::pair<msg::Data, bool /* has data */>> get_data_spaces(
     size_t file_size
 );
 
+
+// A flat, open addressed index of the client's block signatures (like rsync's tag table),
+// a bitmap over a 16 bit tag of the signatures rejects most misses 
+// with a single lookup before the hash table gets probed
+class SignatureIndex {
+  private:
+    // the not yet taken offsets of one signature
+    struct Group {
+        uint32_t first;  // position of the first offset in offsets
+        uint32_t count;
+        uint32_t used;   // number of offsets which have already been taken
+    };
+
+    // marks an empty slot, the signature itself has a separate group
+    static constexpr WeakSign empty_key{0xffffffff};
+
+    std::vector<uint64_t> tags;
+    std::vector<WeakSign> keys{};
+    std::vector<Group> groups{};
+    std::vector<Offset> offsets{};
+    size_t slot_mask{0};
+    unsigned int slot_shift{0};
+
+    static uint16_t tag(WeakSign signature) {
+        return (signature & 0xffff) + (signature >> 16);
+    }
+
+    size_t find_slot(WeakSign) const;
+
+  public:
+    // takes the signatures of the client's consecutive blocks of given size
+    SignatureIndex(const std::vector<WeakSign>&, BlockSize);
+    // takes the signatures of the client's blocks at the given ascending offsets
+    SignatureIndex(const std::vector<WeakSign>&, const std::vector<Offset>&);
+
+    // returns false, when the signature is definitely not in the index
+    bool may_contain(WeakSign signature) const {
+        auto t{tag(signature)};
+        return (tags[t >> 6] >> (t & 63)) & 1;
+    }
+
+    // returns the smallest client offset, which is at least the given offset 
+    // and has the given signature, and marks it as taken,
+    // all offsets with this signature smaller than the given offset are dropped
+    std::optional<Offset> take(WeakSign signature, Offset min_offset) {
+        return take(signature, min_offset, [](Offset){ return true; });
+    }
+
+    // like take, but only returns an offset which accept returns true for,
+    // for signatures which are only keyed by some of their bits,
+    // an offset after rejected ones is only dropped by a larger minimum offset
+    template<typename Accept>
+    std::optional<Offset> take(WeakSign, Offset min_offset, Accept accept);
+};
+
+template<typename Accept>
+std::optional<Offset> SignatureIndex::take(
+    WeakSign signature, 
+    Offset min_offset, 
+    Accept accept
+) {
+    auto slot{find_slot(signature)};
+
+    if (slot < keys.size() && keys[slot] == empty_key) {
+        // unknown signature
+        return std::nullopt;
+    }
+
+    auto& group{groups[slot]};
+
+    while (group.used < group.count 
+           && 
+           offsets[group.first + group.used] < min_offset
+    ) {
+        group.used++;
+    }
+
+    // a rejected offset stays in the index, it might be accepted later on
+    for (auto i{group.used}; i < group.count; i++) {
+        auto offset{offsets[group.first + i]};
+
+        if (accept(offset)) {
+            if (i == group.used) {
+                group.used++;
+            }
+
+            return offset;
+        }
+    }
+
+    return std::nullopt;
+}
+
+
+// Matches the weak signatures at all offsets of a local file, 
+// as they are streamed in, against the block signatures of a client file,
+// only the client's signatures and the found matches are kept in memory,
+// after a match the next local block is compared with the next client block
+// right away, so runs of equal blocks don't need the index,
+// 64 bit signatures are indexed by their folded halves and compared in full
+template<typename Signature>
+class BasicBlockMatcher {
+  private:
+    BlockSize block_size;
+    std::vector<Signature> client_signatures;
+    SignatureIndex index;
+    std::vector<std::pair<Offset /* client */, Offset /* local */>> matches{};
+    Offset next_client_offset{0};
+    Offset next_local_offset{0};
+    size_t extended{0};
+    size_t rejected{0};
+
+  public:
+    // takes the signatures of the client's consecutive blocks of given size
+    BasicBlockMatcher(
+        const std::vector<Signature>& client_signatures, 
+        BlockSize = BLOCK_SIZE
+    );
+
+    // matches the batch of consecutive local signatures 
+    // which starts at the given local offset
+    void consume(Offset, const std::vector<Signature>&);
+
+    const std::vector<std::pair<Offset /* client */, Offset /* local */>>& 
+        get_matches() const;
+
+    // returns how many matches extended a run without the index
+    size_t get_extended_count() const;
+
+    // returns how many blocks the index returned for a local signature,
+    // which differ from it in the bits which aren't part of the key
+    size_t get_rejected_count() const;
+};
+
+using BlockMatcher = BasicBlockMatcher<WeakSign>;
+using BlockMatcher64 = BasicBlockMatcher<WeakSign64>;
+
+
+// returns the pairs of equal client and local content defined chunks,
+// ascending in both files, both files are cut at the same content, 
+// so equal chunks are found without rolling over all offsets
+std::vector<std::pair<Chunk /* client */, Chunk /* local */>> match_chunks(
+    const std::vector<Chunk>& client_chunks,
+    const std::vector<Chunk>& local_chunks
+);
+
+
+// the factor by which the block size shrinks from one refinement of gaps to the next
+const BlockSize REFINEMENT_FACTOR{4};
+
+// the smallest block size to which gaps get refined, whatever the floor is
+const BlockSize MIN_REFINED_BLOCK_SIZE{32};
+
+// returns the block size of the next refinement of the gaps 
+// between blocks of the given size, which is never below the floor
+BlockSize get_refined_block_size(BlockSize, BlockSize refinement_floor);
+
+// the fewest bytes of the strong signatures of refined blocks, the weak 
+// signatures of small blocks have fewer than the 32 bits which 
+// get_strong_signature_length relies on
+const size_t MIN_REFINED_STRONG_SIGNATURE_LENGTH{8};
+
+// returns how many bytes of the strong signatures of refined blocks are sent
+size_t get_refined_strong_signature_length(size_t file_size, BlockSize);
+
+
+// the number of sub ranges into which a differing range gets split
+const size_t RANGE_FAN_OUT{16};
+
+// returns the size of the ranges of the first round of the range signature 
+// exchange, the block size times the smallest power of RANGE_FAN_OUT
+// for which there are at most RANGE_FAN_OUT² ranges
+size_t get_top_range_size(size_t file_size, BlockSize);
+
+// returns the (offset, size) ranges of the file of the given size,
+// which start at the given offsets
+std::vector<std::pair<Offset, size_t>> get_ranges(
+    const std::vector<Offset>&, 
+    size_t range_size, 
+    size_t file_size
+);
+
+// returns the offsets of the sub ranges of the ranges at the given offsets
+std::vector<Offset> get_sub_range_offsets(
+    const std::vector<Offset>&, 
+    size_t range_size, 
+    size_t file_size
+);
+
+// returns the offset from which on ranges of files of different sizes 
+// can't be compared, ranges which end before it are compared at the same offsets
+Offset get_range_tail(size_t client_file_size, size_t server_file_size, BlockSize);
@@ -7,6 +7,7 @@
 #include <chrono>
 #include <optional>
 #include <unordered_map>
+#include <utility>
 #include <variant>
 #include <vector>
 
@@ -21,7 +22,9 @@ File* file(
     const FileName& name,
     Timestamp timestamp,
     size_t size,
-    const StrongSign& signature
+    const StrongSign& signature,
+    HashAlgorithm signature_algorithm,
+    size_t signature_chunk_size
 );
 
 Block* block(
@@ -50,11 +53,13 @@ BlockPairs* block_pairs(const std::vector<BlockPair* /* used */>&);
 
 // creational functions for download message types
 
-FileRequest* file_request(const File&);
+FileRequest* file_request(const File&, Offset = 0);
 
 FileResponse* file_response(
     const File& requested_file, 
-    std::variant<std::string, bool>&& response
+    std::variant<std::string, bool>&& response,
+    Offset = 0,
+    bool more = false
 );
 
 
@@ -70,11 +75,21 @@ QueryOptions* query_options(
     std::optional<Timestamp> changed_after
 );
 
-ShowFiles* show_files(QueryOptions* /* used */);
+ShowFiles* show_files(
+    QueryOptions* /* used */, 
+    const std::vector<HashAlgorithm>& offered_algorithms,
+    Chunking = CHUNKING_FIXED,
+    bool range_signatures = false,
+    WeakHash = WEAK_HASH_CHECKSUM32
+);
 
 FileList* file_list(
     const std::vector<File* /* copied */>&, 
-    QueryOptions* /* used */
+    QueryOptions* /* used */,
+    HashAlgorithm,
+    Chunking = CHUNKING_FIXED,
+    bool range_signatures = false,
+    WeakHash = WEAK_HASH_CHECKSUM32
 );
 
 
@@ -96,14 +111,41 @@ BlockWithSignature* block_with_signature(
 PartialMatch* partial_match(
     File* /* used */, 
     std::optional<BlockPairs* /* used */> signature_requests = std::nullopt,
-    std::optional<Corrections* /* used */> = std::nullopt
+    std::optional<Corrections* /* used */> = std::nullopt,
+    HashAlgorithm = HASH_MD5,
+    std::optional<GapRequest* /* used */> = std::nullopt
 );
 
 SyncRequest* sync_request(
     File* /* used */,
     const std::vector<WeakSign>& weak_signatures,
+    BlockSize,
+    HashAlgorithm,
     bool removed = false
 );
+SyncRequest* sync_request(
+    File* /* used */,
+    const std::vector<WeakSign64>& weak_signatures,
+    BlockSize,
+    HashAlgorithm
+);
+SyncRequest* sync_request(
+    File* /* used */,
+    const std::vector<Chunk>& content_defined_chunks,
+    HashAlgorithm
+);
+
+// adds the strong signatures of the fixed blocks truncated to the given length
+void set_strong_signatures(
+    SyncRequest*,
+    const std::vector<StrongSign>&,
+    size_t strong_signature_length
+);
+void set_strong_signatures(
+    GapSignatures*,
+    const std::vector<StrongSign>&,
+    size_t strong_signature_length
+);
 
 SyncResponse* sync_response(
     const File& requested_file,
@@ -113,9 +155,42 @@ SyncResponse* sync_response(
     bool removed = false
 );
 
+RangeSignatures* range_signatures(
+    File* /* used */,
+    HashAlgorithm,
+    BlockSize,
+    size_t range_size,
+    const std::vector<std::pair<Offset, StrongSign>>& signatures
+);
+
+RangeRequest* range_request(
+    const File& requested_file,
+    HashAlgorithm,
+    BlockSize,
+    size_t range_size,
+    const std::vector<Offset>& offsets
+);
+
+GapRequest* gap_request(
+    HashAlgorithm,
+    BlockSize,
+    BlockSize refinement_floor,
+    const std::vector<BlockPair* /* used */>& gaps
+);
+
+// the strong signatures get truncated to the given length
+GapSignatures* gap_signatures(
+    const File&,
+    const GapRequest&,
+    const std::vector<WeakSign>&,
+    const std::vector<StrongSign>&,
+    size_t strong_signature_length
+);
+
 SignatureAddendum* signature_addendum(
     const File& matched_file, 
-    const std::vector<BlockWithSignature* /* used */>&
+    const std::vector<BlockWithSignature* /* used */>&,
+    HashAlgorithm
 );
 
 
@@ -123,6 +198,9 @@ SignatureAddendum* signature_addendum(
 
 Message received();
 
+// returns the name of the file which the message is about, if there is one
+std::optional<FileName> get_file_name(const Message&);
+
 
 // other utils
 
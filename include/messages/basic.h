@@ -1,10 +1,15 @@
 #pragma once
 
 #include "message_utils.h"
+#include "type/block_signatures.h"
 #include "type/definitions.h"
 #include "messages/basic.pb.h"
 
+#include <cstdint>
+#include <cstring>
 #include <optional>
+#include <string>
+#include <vector>
 
 
 // Messages to represent the same or similar types as with protobuf 
@@ -15,18 +20,105 @@ namespace msg {
         Timestamp timestamp;
         size_t size;
         StrongSign signature;
+        HashAlgorithm signature_algorithm;
+        size_t signature_chunk_size;
+
+        // the status of the local file when it was hashed,
+        // it's not part of the protobuf message
+        uint64_t inode{0};
+        uint64_t device{0};
+        int64_t mtime_ns{0};
+        int64_t ctime_ns{0};
 
         static File from_proto(const ::File& file) {
             return File {
                 file.name(),
                 file.timestamp(),
                 file.size(),
-                file.signature()
+                StrongSign::from_bytes(file.signature()),
+                file.signature_algorithm(),
+                file.signature_chunk_size()
             };
         }
 
         ::File* to_proto() {
-            return ::file(name, timestamp, size, signature);
+            return ::file(
+                name, 
+                timestamp, 
+                size, 
+                signature, 
+                signature_algorithm, 
+                signature_chunk_size
+            );
+        }
+    };
+
+    // The block signatures of a file as they are stored in the database,
+    // together with the status of the file when they were computed
+    struct BlockSignatures {
+        FileName name;
+        size_t size;
+        int64_t mtime_ns;
+        uint64_t inode;
+        BlockSize block_size;
+        HashAlgorithm algorithm;
+        std::vector<char> weak_signatures;
+        std::vector<char> strong_signatures;
+
+        BlockSignatures() {}
+
+        BlockSignatures(
+            const File& file, 
+            const ::BlockSignatures& signatures
+        ): name{file.name},
+           size{file.size},
+           mtime_ns{file.mtime_ns},
+           inode{file.inode},
+           block_size{signatures.block_size},
+           algorithm{signatures.algorithm},
+           weak_signatures(signatures.weak.size() * sizeof(WeakSign)),
+           strong_signatures(signatures.strong.size() * StrongSign::length)
+        {
+            std::memcpy(
+                weak_signatures.data(), 
+                signatures.weak.data(), 
+                weak_signatures.size()
+            );
+
+            for (size_t i{0}; i < signatures.strong.size(); i++) {
+                std::memcpy(
+                    strong_signatures.data() + i * StrongSign::length, 
+                    signatures.strong[i].bytes.data(), 
+                    StrongSign::length
+                );
+            }
+        }
+
+        ::BlockSignatures to_signatures() const {
+            ::BlockSignatures signatures{
+                block_size,
+                algorithm,
+                std::vector<WeakSign>(weak_signatures.size() / sizeof(WeakSign)),
+                std::vector<StrongSign>{}
+            };
+
+            std::memcpy(
+                signatures.weak.data(), 
+                weak_signatures.data(), 
+                signatures.weak.size() * sizeof(WeakSign)
+            );
+
+            for (size_t offset{0}; 
+                offset + StrongSign::length <= strong_signatures.size(); 
+                offset += StrongSign::length
+            ) {
+                signatures.strong.push_back(StrongSign::from_bytes(
+                    (const unsigned char*)strong_signatures.data() + offset, 
+                    StrongSign::length
+                ));
+            }
+
+            return signatures;
         }
     };
 
@@ -1,9 +1,13 @@
 #pragma once
 
+#include <algorithm>
 #include <condition_variable>
+#include <functional>
+#include <memory>
 #include <mutex>
 #include <optional>
 #include <queue>
+#include <vector>
 
 
 // The interface for a closable object (Pipe)
@@ -125,6 +129,146 @@ class Pipe: public SendingPipe<T>, public ReceivingPipe<T> {
 };
 
 
+
+// A Pipe which holds at most capacity messages, sending blocks while it is full,
+// after closing, the remaining messages can still be received
+template<typename T>
+class BoundedPipe: public SendingPipe<T>, public ReceivingPipe<T> {
+  private:
+    std::queue<T> msgs{};
+    const size_t capacity;
+    std::mutex pipe_mtx{};
+    std::condition_variable sending_finishable{};
+    std::condition_variable receiving_finishable{};
+    bool open{true};
+
+  public:
+    BoundedPipe(size_t capacity): capacity{std::max(capacity, (size_t)1)} {}
+
+    void close() override {
+        std::lock_guard pipe_lck{pipe_mtx};
+        open = false;
+        sending_finishable.notify_all();
+        receiving_finishable.notify_all();
+    }
+
+    bool is_open() const override { return open; }
+    bool is_closed() const override { return !open; }
+
+    bool is_empty() const override { return msgs.empty(); }
+    bool is_not_empty() const override { return !is_empty(); }
+
+    bool send(const std::vector<T>& new_msgs) override {
+        for (auto msg: new_msgs) {
+            if (!send(std::move(msg))) {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    bool send(T msg) override {
+        std::unique_lock pipe_lck{pipe_mtx};
+        sending_finishable.wait(
+            pipe_lck, 
+            [this](){ return msgs.size() < capacity || is_closed(); }
+        );
+
+        if (is_open()) {
+            msgs.push(std::move(msg));
+            receiving_finishable.notify_one();
+
+            return true;
+        }
+        else {
+            return false;
+        }
+    }
+
+    std::optional<T> receive() override {
+        std::unique_lock pipe_lck{pipe_mtx};
+        receiving_finishable.wait(
+            pipe_lck, 
+            [this](){ return is_not_empty() || is_closed(); }
+        );
+
+        if (is_not_empty()) {
+            T msg{std::move(msgs.front())};
+            msgs.pop();
+            sending_finishable.notify_one();
+
+            return msg;
+        }
+        else {
+            return std::nullopt;
+        }
+    }
+
+    ~BoundedPipe() {
+        close();
+    }
+};
+
+
+// Pipes (shards) into which the messages get sent by their key, messages 
+// with the same key are received in the order they were sent from the same shard
+template<typename T>
+class ShardedPipe: public SendingPipe<T> {
+  private:
+    std::vector<std::unique_ptr<Pipe<T>>> shards{};
+    std::function<size_t(const T&)> get_key;
+
+    Pipe<T>& get_shard(const T& msg) {
+        return *shards[get_key(msg) % shards.size()];
+    }
+
+  public:
+    ShardedPipe(
+        size_t count, 
+        std::function<size_t(const T&)> get_key
+    ): get_key{get_key} {
+        for (size_t i{0}; i < std::max(count, (size_t)1); i++) {
+            shards.push_back(std::make_unique<Pipe<T>>());
+        }
+    }
+
+    void close() override {
+        for (auto& shard: shards) {
+            shard->close();
+        }
+    }
+
+    bool is_open() const override { return shards.front()->is_open(); }
+    bool is_closed() const override { return !is_open(); }
+
+    bool is_empty() const override {
+        return std::all_of(shards.begin(), shards.end(), [](auto& shard){
+            return shard->is_empty();
+        });
+    }
+    bool is_not_empty() const override { return !is_empty(); }
+
+    bool send(const std::vector<T>& new_msgs) override {
+        for (auto msg: new_msgs) {
+            if (!send(std::move(msg))) {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    bool send(T msg) override {
+        return get_shard(msg).send(std::move(msg));
+    }
+
+    size_t size() const { return shards.size(); }
+
+    ReceivingPipe<T>& shard(size_t i) { return *shards[i]; }
+};
+
+
 // The non-implementation for the Pipe interfaces, it does nothing
 template<typename T>
 class NoPipe: public SendingPipe<T>, public ReceivingPipe<T> {
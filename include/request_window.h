@@ -0,0 +1,66 @@
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+
+
+// Counts the requests which are sent but not answered yet,
+// adding a request blocks while the window is full
+class RequestWindow {
+  private:
+    size_t in_flight{0};
+    bool open{true};
+    std::mutex window_mtx{};
+    std::condition_variable window_changed{};
+
+  public:
+    // waits until fewer than size requests are in flight and adds one,
+    // returns false, when the window is closed
+    bool add(size_t size) {
+        std::unique_lock window_lck{window_mtx};
+        window_changed.wait(
+            window_lck,
+            [&](){ return in_flight < std::max(size, (size_t)1) || !open; }
+        );
+
+        if (open) {
+            in_flight++;
+        }
+
+        return open;
+    }
+
+    void remove() {
+        std::lock_guard window_lck{window_mtx};
+        if (in_flight > 0) {
+            in_flight--;
+        }
+        window_changed.notify_all();
+    }
+
+    // waits until all requests are answered,
+    // returns false, when the window is closed
+    bool wait_for_none() {
+        std::unique_lock window_lck{window_mtx};
+        window_changed.wait(
+            window_lck,
+            [&](){ return in_flight == 0 || !open; }
+        );
+
+        return open;
+    }
+
+    size_t size() {
+        std::lock_guard window_lck{window_mtx};
+        return in_flight;
+    }
+
+    // releases all waiting threads
+    void close() {
+        std::lock_guard window_lck{window_mtx};
+        open = false;
+        window_changed.notify_all();
+    }
+};
@@ -5,5 +5,11 @@
 #include "pipe.h"
 
 
-// runs the synchronization server
-int run_server(const ServerData&, SendingPipe<InternalMsgWithOriginator>&);
+// runs the synchronization server, which handles its clients asynchronously
+// on sync.server_threads threads, accepts at most sync.max_clients at once
+// and allows each at most sync.requests_in_flight requests in flight
+int run_server(
+    const ServerData&, 
+    const SyncConfig& sync, 
+    SendingPipe<InternalMsgWithOriginator>&
+);
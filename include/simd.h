@@ -0,0 +1,23 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+
+// The SIMD instruction sets for which kernels are implemented,
+// the fastest one supported by the CPU gets picked at runtime
+namespace simd {
+    enum class Kernel {
+        Scalar,
+        SSE41,
+        AVX2
+    };
+
+    // returns all kernels supported by this CPU, the scalar one is always supported
+    std::vector<Kernel> supported_kernels();
+
+    // returns the fastest kernel supported by this CPU
+    Kernel best_kernel();
+
+    std::string kernel_name(Kernel);
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <asio/error_code.hpp>
+#include <asio/ip/tcp.hpp>
+#include <unistd.h>
+
+
+// returns a socket on a duplicate of the stream's descriptor,
+// so one thread can write to it while another one reads from the stream,
+// which isn't safe to use from two threads,
+// the connection closes only after both are closed
+inline asio::ip::tcp::socket get_writing_socket(asio::ip::tcp::iostream& stream) {
+    auto& socket{stream.socket()};
+    asio::error_code error{};
+
+    return asio::ip::tcp::socket{
+        socket.get_executor(),
+        socket.local_endpoint(error).protocol(),
+        ::dup(socket.native_handle())
+    };
+}
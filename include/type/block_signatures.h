@@ -0,0 +1,16 @@
+#pragma once
+
+#include "type/definitions.h"
+#include "messages/basic.pb.h"
+
+#include <vector>
+
+
+// The weak and strong signatures of the consecutive blocks of some data,
+// the last block might be smaller
+struct BlockSignatures {
+    BlockSize block_size;
+    HashAlgorithm algorithm;
+    std::vector<WeakSign> weak;
+    std::vector<StrongSign> strong;
+};
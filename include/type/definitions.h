@@ -1,5 +1,7 @@
 #pragma once
 
+#include "type/strong_sign.h"
+
 #include <string>
 
 
@@ -9,4 +11,4 @@ using Timestamp  = unsigned long;
 using Offset     = unsigned long;
 using BlockSize  = unsigned int;
 using WeakSign   = unsigned int;
-using StrongSign = std::string;
+using WeakSign64 = unsigned long;
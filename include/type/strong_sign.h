@@ -0,0 +1,71 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstring>
+#include <functional>
+#include <string>
+
+
+// A strong signature (digest) of fixed size in binary form,
+// it gets converted to hexadecimal only for output
+struct StrongSign {
+    static constexpr size_t length{16};
+
+    std::array<unsigned char, length> bytes{};
+
+    // takes the first length bytes of the given digest,
+    // missing bytes are filled with 0
+    static StrongSign from_bytes(const unsigned char* digest, size_t size) {
+        StrongSign signature{};
+        std::copy_n(digest, std::min(size, length), signature.bytes.begin());
+
+        return signature;
+    }
+
+    static StrongSign from_bytes(const std::string& digest) {
+        return from_bytes((const unsigned char*)digest.data(), digest.size());
+    }
+
+    std::string to_bytes() const {
+        return std::string{(const char*)bytes.data(), length};
+    }
+
+    std::string to_hex() const {
+        static const char hex_digits[]{"0123456789abcdef"};
+
+        std::string hex(2 * length, '0');
+        for (size_t i{0}; i < length; i++) {
+            hex[2 * i]     = hex_digits[bytes[i] >> 4];
+            hex[2 * i + 1] = hex_digits[bytes[i] & 0xf];
+        }
+
+        return hex;
+    }
+
+    bool operator==(const StrongSign& other) const {
+        return bytes == other.bytes;
+    }
+    bool operator!=(const StrongSign& other) const {
+        return bytes != other.bytes;
+    }
+    bool operator<(const StrongSign& other) const {
+        return bytes < other.bytes;
+    }
+};
+
+
+namespace std {
+    // the bytes of a digest are evenly distributed,
+    // so its first bytes make a good hash
+    template<>
+    struct hash<StrongSign> {
+        size_t operator()(const StrongSign& signature) const {
+            size_t value;
+            memcpy(&value, signature.bytes.data(), sizeof(value));
+
+            return value;
+        }
+    };
+}
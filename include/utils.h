@@ -16,7 +16,20 @@
 std::string msg_to_base64(const Message&);
 Message msg_from_base64(std::istream&);
 
+// returns the framing with the given name from the config
+Framing get_framing(const std::string& name);
+
+// the largest size of a binary frame's message, 
+// a larger size prefix makes the frame malformed
+const size_t MAX_FRAME_SIZE{1 << 28};
+
+// returns the message delimited as the given framing demands
+std::string msg_to_frame(const Message&, Framing);
+// sets the failbit of the stream if no complete message could be read
+Message msg_from_frame(std::istream&, Framing);
+
 std::string to_base64(const std::string&);
+// throws std::invalid_argument if the string isn't base 64 encoded
 std::string from_base64(const std::string&);
 
 // converts the given vector to a string with the specified separator
@@ -0,0 +1,505 @@
+#include "base64_kernels.h"
+
+#include <array>
+#include <cstddef>
+#include <optional>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define X86_KERNELS
+#include <immintrin.h>
+#endif
+
+using namespace std;
+using namespace simd;
+
+// The SIMD kernels follow W. Muła and D. Lemire, "Faster Base64 Encoding and
+// Decoding Using AVX2 Instructions" (2018). They only translate whole groups
+// of 3 bytes or 4 chars, stop before the last groups, since they read or
+// write a few bytes more than they translate, and leave the rest and
+// the padding to the scalar code.
+//
+// A decoding kernel also stops before the first group with an invalid char,
+// so the scalar code finds it.
+
+const char alphabet[]{
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/"
+};
+const char pad_char{'='};
+const unsigned char invalid{0xff};
+
+// the value of each char, invalid for chars which aren't in the alphabet
+const array<unsigned char, 256> values{[](){
+    array<unsigned char, 256> values{};
+    values.fill(invalid);
+
+    for (unsigned char value{0}; value < 64; value++) {
+        values[(unsigned char)alphabet[value]] = value;
+    }
+
+    return values;
+}()};
+
+size_t encode_scalar(const unsigned char*, size_t, char*);
+size_t decode_scalar(const char*, size_t, unsigned char*);
+
+#ifdef X86_KERNELS
+size_t encode_sse41(const unsigned char*, size_t, char*);
+size_t encode_avx2(const unsigned char*, size_t, char*);
+size_t decode_sse41(const char*, size_t, unsigned char*);
+size_t decode_avx2(const char*, size_t, unsigned char*);
+#endif
+
+
+void base64::encode(
+    const unsigned char* data,
+    size_t size,
+    char* encoded,
+    Kernel kernel
+) {
+    size_t translated{0};
+
+    switch (kernel) {
+#ifdef X86_KERNELS
+        case Kernel::SSE41:
+            translated = encode_sse41(data, size, encoded);
+            break;
+        case Kernel::AVX2:
+            translated = encode_avx2(data, size, encoded);
+            break;
+#endif
+        default:
+            break;
+    }
+
+    data += translated;
+    size -= translated;
+    encoded += translated / 3 * 4;
+
+    translated = encode_scalar(data, size, encoded);
+    data += translated;
+    size -= translated;
+    encoded += translated / 3 * 4;
+
+    // the last 1 or 2 bytes are padded
+    if (size > 0) {
+        unsigned int bits{(unsigned int)data[0] << 16};
+        if (size == 2) {
+            bits |= (unsigned int)data[1] << 8;
+        }
+
+        encoded[0] = alphabet[bits >> 18];
+        encoded[1] = alphabet[bits >> 12 & 0x3f];
+        encoded[2] = size == 2 ? alphabet[bits >> 6 & 0x3f] : pad_char;
+        encoded[3] = pad_char;
+    }
+}
+
+optional<size_t> base64::decode(
+    const char* encoded,
+    size_t size,
+    unsigned char* decoded,
+    Kernel kernel
+) {
+    if (size % 4 == 0) {
+        // up to 2 padding chars end the last group
+        for (size_t pad{0}; pad < 2 && size > 0; pad++) {
+            if (encoded[size - 1] == pad_char) {
+                size--;
+            }
+        }
+    }
+
+    if (size % 4 == 1) {
+        return nullopt;
+    }
+
+    auto start{decoded};
+    size_t translated{0};
+
+    switch (kernel) {
+#ifdef X86_KERNELS
+        case Kernel::SSE41:
+            translated = decode_sse41(encoded, size, decoded);
+            break;
+        case Kernel::AVX2:
+            translated = decode_avx2(encoded, size, decoded);
+            break;
+#endif
+        default:
+            break;
+    }
+
+    encoded += translated;
+    size -= translated;
+    decoded += translated / 4 * 3;
+
+    translated = decode_scalar(encoded, size, decoded);
+    if (translated < size / 4 * 4) {
+        return nullopt;
+    }
+
+    encoded += translated;
+    size -= translated;
+    decoded += translated / 4 * 3;
+
+    // the last 2 or 3 chars hold 1 or 2 bytes
+    if (size > 0) {
+        unsigned int first{values[(unsigned char)encoded[0]]};
+        unsigned int second{values[(unsigned char)encoded[1]]};
+        unsigned int third{size == 3 ? values[(unsigned char)encoded[2]] : 0u};
+
+        if ((first | second | third) >= 64) {
+            return nullopt;
+        }
+
+        unsigned int bits{first << 18 | second << 12 | third << 6};
+        *decoded++ = (unsigned char)(bits >> 16);
+        if (size == 3) {
+            *decoded++ = (unsigned char)(bits >> 8);
+        }
+    }
+
+    return decoded - start;
+}
+
+
+// translates all whole groups of 3 bytes
+size_t encode_scalar(
+    const unsigned char* data,
+    size_t size,
+    char* encoded
+) {
+    size_t translated{size / 3 * 3};
+
+    for (size_t i{0}; i < translated; i += 3) {
+        unsigned int bits{
+            (unsigned int)data[i] << 16
+            | (unsigned int)data[i + 1] << 8
+            | (unsigned int)data[i + 2]
+        };
+
+        encoded[0] = alphabet[bits >> 18];
+        encoded[1] = alphabet[bits >> 12 & 0x3f];
+        encoded[2] = alphabet[bits >> 6 & 0x3f];
+        encoded[3] = alphabet[bits & 0x3f];
+        encoded += 4;
+    }
+
+    return translated;
+}
+
+// translates all whole groups of 4 chars up to the first invalid char
+size_t decode_scalar(
+    const char* encoded,
+    size_t size,
+    unsigned char* decoded
+) {
+    size_t translated{0};
+
+    for (; translated + 4 <= size; translated += 4) {
+        unsigned int first{values[(unsigned char)encoded[translated]]};
+        unsigned int second{values[(unsigned char)encoded[translated + 1]]};
+        unsigned int third{values[(unsigned char)encoded[translated + 2]]};
+        unsigned int fourth{values[(unsigned char)encoded[translated + 3]]};
+
+        // every valid value is below 64
+        if ((first | second | third | fourth) >= 64) {
+            break;
+        }
+
+        unsigned int bits{first << 18 | second << 12 | third << 6 | fourth};
+        decoded[0] = (unsigned char)(bits >> 16);
+        decoded[1] = (unsigned char)(bits >> 8);
+        decoded[2] = (unsigned char)bits;
+        decoded += 3;
+    }
+
+    return translated;
+}
+
+
+#ifdef X86_KERNELS
+
+// Each 32 bit lane holds the bytes b, a, c, b of 3 input bytes a, b, c,
+// the shifts via multiplication put their 4 values of 6 bits into
+// the 4 bytes of the lane, which are then shifted into the alphabet.
+
+__attribute__((target("sse4.1")))
+inline __m128i encode_lanes(__m128i bytes) {
+    __m128i in{_mm_shuffle_epi8(
+        bytes,
+        _mm_setr_epi8(1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10)
+    )};
+
+    __m128i high{_mm_mulhi_epu16(
+        _mm_and_si128(in, _mm_set1_epi32(0x0fc0fc00)),
+        _mm_set1_epi32(0x04000040)
+    )};
+    __m128i low{_mm_mullo_epi16(
+        _mm_and_si128(in, _mm_set1_epi32(0x003f03f0)),
+        _mm_set1_epi32(0x01000010)
+    )};
+    __m128i indices{_mm_or_si128(high, low)};
+
+    // 0 ... 25 -> 13, 26 ... 51 -> 0, 52 ... 61 -> 1 ... 10, 62 -> 11, 63 -> 12
+    __m128i reduced{_mm_subs_epu8(indices, _mm_set1_epi8(51))};
+    __m128i upper{_mm_cmpgt_epi8(_mm_set1_epi8(26), indices)};
+    reduced = _mm_or_si128(reduced, _mm_and_si128(upper, _mm_set1_epi8(13)));
+
+    __m128i shifts{_mm_setr_epi8(
+        'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+        '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62,
+        '/' - 63, 'A', 0, 0
+    )};
+
+    return _mm_add_epi8(indices, _mm_shuffle_epi8(shifts, reduced));
+}
+
+__attribute__((target("avx2")))
+inline __m256i encode_lanes(__m256i bytes) {
+    __m256i in{_mm256_shuffle_epi8(
+        bytes,
+        _mm256_setr_epi8(
+            1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10,
+            1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10
+        )
+    )};
+
+    __m256i high{_mm256_mulhi_epu16(
+        _mm256_and_si256(in, _mm256_set1_epi32(0x0fc0fc00)),
+        _mm256_set1_epi32(0x04000040)
+    )};
+    __m256i low{_mm256_mullo_epi16(
+        _mm256_and_si256(in, _mm256_set1_epi32(0x003f03f0)),
+        _mm256_set1_epi32(0x01000010)
+    )};
+    __m256i indices{_mm256_or_si256(high, low)};
+
+    __m256i reduced{_mm256_subs_epu8(indices, _mm256_set1_epi8(51))};
+    __m256i upper{_mm256_cmpgt_epi8(_mm256_set1_epi8(26), indices)};
+    reduced = _mm256_or_si256(
+        reduced,
+        _mm256_and_si256(upper, _mm256_set1_epi8(13))
+    );
+
+    __m256i shifts{_mm256_setr_epi8(
+        'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+        '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62,
+        '/' - 63, 'A', 0, 0,
+        'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+        '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62,
+        '/' - 63, 'A', 0, 0
+    )};
+
+    return _mm256_add_epi8(indices, _mm256_shuffle_epi8(shifts, reduced));
+}
+
+// loads 16 bytes for every 12 translated bytes
+__attribute__((target("sse4.1")))
+size_t encode_sse41(
+    const unsigned char* data,
+    size_t size,
+    char* encoded
+) {
+    size_t translated{0};
+
+    for (; translated + 16 <= size; translated += 12) {
+        __m128i bytes{_mm_loadu_si128((const __m128i*)(data + translated))};
+
+        _mm_storeu_si128((__m128i*)encoded, encode_lanes(bytes));
+        encoded += 16;
+    }
+
+    return translated;
+}
+
+// loads 28 bytes for every 24 translated bytes
+__attribute__((target("avx2")))
+size_t encode_avx2(
+    const unsigned char* data,
+    size_t size,
+    char* encoded
+) {
+    size_t translated{0};
+
+    for (; translated + 28 <= size; translated += 24) {
+        __m256i bytes{_mm256_inserti128_si256(
+            _mm256_castsi128_si256(
+                _mm_loadu_si128((const __m128i*)(data + translated))
+            ),
+            _mm_loadu_si128((const __m128i*)(data + translated + 12)),
+            1
+        )};
+
+        _mm256_storeu_si256((__m256i*)encoded, encode_lanes(bytes));
+        encoded += 32;
+    }
+
+    return translated;
+}
+
+
+// The high and low nibble of each char select two bit masks, which only
+// share a bit for chars outside of the alphabet. The high nibble,
+// and for '/' the equality with it, select the shift to the char's value.
+// Multiplication and addition of neighbouring values pack the 4 values
+// of 6 bits of each 32 bit lane into 3 bytes.
+
+// returns if all chars are in the alphabet
+__attribute__((target("sse4.1")))
+inline bool decode_lanes(__m128i chars, __m128i& bytes) {
+    __m128i high_nibbles{_mm_and_si128(
+        _mm_srli_epi32(chars, 4),
+        _mm_set1_epi8(0x0f)
+    )};
+    __m128i low_nibbles{_mm_and_si128(chars, _mm_set1_epi8(0x0f))};
+
+    __m128i low_masks{_mm_shuffle_epi8(
+        _mm_setr_epi8(
+            0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+            0x11, 0x11, 0x13, 0x1a, 0x1b, 0x1b, 0x1b, 0x1a
+        ),
+        low_nibbles
+    )};
+    __m128i high_masks{_mm_shuffle_epi8(
+        _mm_setr_epi8(
+            0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+            0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10
+        ),
+        high_nibbles
+    )};
+
+    if (!_mm_testz_si128(low_masks, high_masks)) {
+        return false;
+    }
+
+    __m128i slashes{_mm_cmpeq_epi8(chars, _mm_set1_epi8('/'))};
+    __m128i shifts{_mm_shuffle_epi8(
+        _mm_setr_epi8(0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0),
+        _mm_add_epi8(slashes, high_nibbles)
+    )};
+    __m128i values{_mm_add_epi8(chars, shifts)};
+
+    __m128i pairs{_mm_maddubs_epi16(values, _mm_set1_epi32(0x01400140))};
+    __m128i lanes{_mm_madd_epi16(pairs, _mm_set1_epi32(0x00011000))};
+
+    bytes = _mm_shuffle_epi8(
+        lanes,
+        _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1)
+    );
+
+    return true;
+}
+
+__attribute__((target("avx2")))
+inline bool decode_lanes(__m256i chars, __m256i& bytes) {
+    __m256i high_nibbles{_mm256_and_si256(
+        _mm256_srli_epi32(chars, 4),
+        _mm256_set1_epi8(0x0f)
+    )};
+    __m256i low_nibbles{_mm256_and_si256(chars, _mm256_set1_epi8(0x0f))};
+
+    __m256i low_masks{_mm256_shuffle_epi8(
+        _mm256_setr_epi8(
+            0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+            0x11, 0x11, 0x13, 0x1a, 0x1b, 0x1b, 0x1b, 0x1a,
+            0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+            0x11, 0x11, 0x13, 0x1a, 0x1b, 0x1b, 0x1b, 0x1a
+        ),
+        low_nibbles
+    )};
+    __m256i high_masks{_mm256_shuffle_epi8(
+        _mm256_setr_epi8(
+            0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+            0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+            0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+            0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10
+        ),
+        high_nibbles
+    )};
+
+    if (!_mm256_testz_si256(low_masks, high_masks)) {
+        return false;
+    }
+
+    __m256i slashes{_mm256_cmpeq_epi8(chars, _mm256_set1_epi8('/'))};
+    __m256i shifts{_mm256_shuffle_epi8(
+        _mm256_setr_epi8(
+            0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0,
+            0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0
+        ),
+        _mm256_add_epi8(slashes, high_nibbles)
+    )};
+    __m256i values{_mm256_add_epi8(chars, shifts)};
+
+    __m256i pairs{_mm256_maddubs_epi16(values, _mm256_set1_epi32(0x01400140))};
+    __m256i lanes{_mm256_madd_epi16(pairs, _mm256_set1_epi32(0x00011000))};
+
+    lanes = _mm256_shuffle_epi8(
+        lanes,
+        _mm256_setr_epi8(
+            2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1,
+            2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1
+        )
+    );
+
+    // the 12 bytes of both halves follow each other
+    bytes = _mm256_permutevar8x32_epi32(
+        lanes,
+        _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 3, 7)
+    );
+
+    return true;
+}
+
+// stores 16 bytes for every 12 translated bytes
+__attribute__((target("sse4.1")))
+size_t decode_sse41(
+    const char* encoded,
+    size_t size,
+    unsigned char* decoded
+) {
+    size_t translated{0};
+
+    for (; translated + 32 <= size; translated += 16) {
+        __m128i chars{_mm_loadu_si128((const __m128i*)(encoded + translated))};
+        __m128i bytes;
+
+        if (!decode_lanes(chars, bytes)) {
+            break;
+        }
+
+        _mm_storeu_si128((__m128i*)decoded, bytes);
+        decoded += 12;
+    }
+
+    return translated;
+}
+
+// stores 32 bytes for every 24 translated bytes
+__attribute__((target("avx2")))
+size_t decode_avx2(
+    const char* encoded,
+    size_t size,
+    unsigned char* decoded
+) {
+    size_t translated{0};
+
+    for (; translated + 64 <= size; translated += 32) {
+        __m256i chars{
+            _mm256_loadu_si256((const __m256i*)(encoded + translated))
+        };
+        __m256i bytes;
+
+        if (!decode_lanes(chars, bytes)) {
+            break;
+        }
+
+        _mm256_storeu_si256((__m256i*)decoded, bytes);
+        decoded += 24;
+    }
+
+    return translated;
+}
+
+#endif
@@ -0,0 +1,77 @@
+#include "benchmarks/bench_utils.h"
+
+#include <fmt/core.h>
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+
+// runs all benchmarks or only those whose names contain the first argument
+int main(int argc, char* argv[]) {
+    string filter{argc > 1 ? argv[1] : ""};
+
+    for (auto benchmark: get_benchmarks()) {
+        if (benchmark->name.find(filter) != string::npos) {
+            fmt::print("{}\n", benchmark->name);
+            benchmark->run();
+            fmt::print("\n");
+        }
+    }
+
+    return 0;
+}
+
+
+Benchmark::Benchmark(
+    string name,
+    function<void()> run
+): name{move(name)},
+   run{move(run)}
+{
+    get_benchmarks().push_back(this);
+}
+
+vector<Benchmark*>& get_benchmarks() {
+    static vector<Benchmark*> benchmarks{};
+    return benchmarks;
+}
+
+
+chrono::nanoseconds measure(
+    const function<void()>& fn,
+    unsigned int repetitions
+) {
+    auto fastest{chrono::nanoseconds::max()};
+
+    for (unsigned int i{0}; i < repetitions; i++) {
+        auto start{chrono::steady_clock::now()};
+        fn();
+        auto duration{chrono::steady_clock::now() - start};
+
+        fastest = min(
+            fastest,
+            chrono::duration_cast<chrono::nanoseconds>(duration)
+        );
+    }
+
+    return fastest;
+}
+
+void report(
+    const string& label,
+    size_t bytes,
+    chrono::nanoseconds duration
+) {
+    double seconds{duration.count() / 1e9};
+
+    fmt::print(
+        "  {:<40} {:>10.3f} ms {:>10.1f} MiB/s\n",
+        label,
+        seconds * 1e3,
+        bytes / seconds / (1024 * 1024)
+    );
+}
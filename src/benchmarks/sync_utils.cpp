@@ -0,0 +1,274 @@
+#include "benchmarks/bench_utils.h"
+#include "file_operator/checksum_kernels.h"
+#include "file_operator/md5_kernels.h"
+#include "file_operator/signatures.h"
+#include "file_operator/sync_utils.h"
+#include "simd.h"
+
+#include <fmt/core.h>
+#include <functional>
+#include <random>
+#include <sstream>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+void match(const vector<WeakSign>& client, const vector<WeakSign>& batch, size_t);
+template<typename Signature>
+void report_false_matches(const string& label, const string& client, const string& local);
+
+
+// all client blocks and all local offsets have the same signature,
+// the time per byte needs to stay the same with growing file sizes
+Benchmark matcher_zero_filled{"BlockMatcher on zero filled files", [](){
+    auto signature{get_weak_signature(string(BLOCK_SIZE, '\0'))};
+    vector<WeakSign> batch(STREAM_BUFFER_SIZE, signature);
+
+    for (size_t mib: {64, 128, 256, 512, 1024}) {
+        size_t file_size{mib * 1024 * 1024};
+        vector<WeakSign> client(file_size / BLOCK_SIZE, signature);
+
+        report(
+            fmt::format("{} MiB", mib),
+            file_size,
+            measure([&](){ match(client, batch, file_size); }, 3)
+        );
+    }
+}};
+
+// nearly all local offsets miss, which is the common case
+Benchmark matcher_random{"BlockMatcher on random files", [](){
+    mt19937 random_signatures{42};
+    vector<WeakSign> batch(STREAM_BUFFER_SIZE);
+    for (auto& signature: batch) {
+        signature = random_signatures();
+    }
+
+    for (size_t mib: {64, 128, 256, 512, 1024}) {
+        size_t file_size{mib * 1024 * 1024};
+        vector<WeakSign> client(file_size / BLOCK_SIZE);
+        for (auto& signature: client) {
+            signature = random_signatures();
+        }
+
+        report(
+            fmt::format("{} MiB", mib),
+            file_size,
+            measure([&](){ match(client, batch, file_size); }, 3)
+        );
+    }
+}};
+
+// the local file equals the client file, so the signatures of all 
+// local blocks follow each other in the client's signatures
+Benchmark matcher_identical{"BlockMatcher on identical files", [](){
+    mt19937 random_signatures{42};
+    size_t file_size{64 * 1024 * 1024};
+
+    vector<WeakSign> client(file_size / BLOCK_SIZE);
+    for (auto& signature: client) {
+        signature = random_signatures();
+    }
+
+    vector<vector<WeakSign>> batches{};
+    for (Offset offset{0}; offset < file_size; offset += STREAM_BUFFER_SIZE) {
+        auto& batch{batches.emplace_back(STREAM_BUFFER_SIZE)};
+
+        for (size_t i{0}; i < batch.size(); i++) {
+            auto local_offset{offset + i};
+
+            batch[i] = 
+                local_offset % BLOCK_SIZE == 0 && local_offset / BLOCK_SIZE < client.size()
+                ? client[local_offset / BLOCK_SIZE]
+                : random_signatures();
+        }
+    }
+
+    size_t matches{0};
+    report(
+        "64 MiB",
+        file_size,
+        measure([&](){ 
+            BlockMatcher matcher{client};
+
+            for (size_t i{0}; i < batches.size(); i++) {
+                matcher.consume(i * STREAM_BUFFER_SIZE, batches[i]);
+            }
+
+            matches = matcher.get_matches().size();
+        }, 5)
+    );
+    fmt::print("  {} of {} blocks matched\n", matches, client.size());
+}};
+
+// the client file and the local file have nothing in common,
+// so every match of the weak signatures is a false positive, 
+// which would cost a strong signature to rule out
+Benchmark weak_false_positives{"weak signature false positives", [](){
+    mt19937 random_bytes{42};
+    size_t file_size{64 * 1024 * 1024};
+
+    // random bytes and text of random words of a few frequent letters
+    auto random_data{[&](){
+        string data(file_size, '\0');
+        for (auto& c: data) {
+            c = (char)random_bytes();
+        }
+
+        return data;
+    }};
+    auto random_text{[&](){
+        const string letters{"etaoinshrdlu    "};
+        string data(file_size, '\0');
+        for (auto& c: data) {
+            c = letters[random_bytes() % letters.size()];
+        }
+
+        return data;
+    }};
+
+    for (auto& [kind, make_data]: 
+        vector<pair<string, function<string()>>>{{"random", random_data}, {"text", random_text}}
+    ) {
+        auto client{make_data()};
+        auto local{make_data()};
+
+        report_false_matches<WeakSign>(kind + ", 32 bit checksum", client, local);
+        report_false_matches<WeakSign64>(kind + ", 64 bit Rabin-Karp", client, local);
+    }
+}};
+
+// cutting a file into content defined chunks reads every byte once
+Benchmark chunking_random{"Content defined chunking of random files", [](){
+    mt19937 random_bytes{42};
+
+    for (size_t mib: {16, 64, 256}) {
+        string data(mib * 1024 * 1024, '\0');
+        for (auto& c: data) {
+            c = (char)random_bytes();
+        }
+
+        istringstream data_stream{data};
+
+        report(
+            fmt::format("{} MiB", mib),
+            data.size(),
+            measure([&](){ get_chunks(data_stream, data.size()); }, 3)
+        );
+    }
+}};
+
+// hashes the blocks of a buffer one by one with OpenSSL
+// and in lanes with each kernel
+Benchmark md5_blocks{"MD5 of blocks", [](){
+    mt19937 random_bytes{42};
+    string data(64 * 1024 * 1024, '\0');
+    for (auto& c: data) {
+        c = (char)random_bytes();
+    }
+
+    vector<const unsigned char*> blocks{};
+    for (size_t offset{0}; offset + BLOCK_SIZE <= data.size(); offset += BLOCK_SIZE) {
+        blocks.push_back((const unsigned char*)data.data() + offset);
+    }
+    vector<StrongSign> digests(blocks.size());
+
+    report(
+        "OpenSSL per block",
+        blocks.size() * BLOCK_SIZE,
+        measure([&](){ 
+            for (size_t i{0}; i < blocks.size(); i++) {
+                auto hasher{strong_hash::make_hasher(HASH_MD5)};
+                hasher->update((const char*)blocks[i], BLOCK_SIZE);
+                digests[i] = hasher->finish();
+            }
+        }, 3)
+    );
+
+    for (auto kernel: simd::supported_kernels()) {
+        report(
+            fmt::format("{} lanes ({})", md5::lanes(kernel), simd::kernel_name(kernel)),
+            blocks.size() * BLOCK_SIZE,
+            measure([&](){ 
+                md5::hash_blocks(
+                    blocks.data(), 
+                    blocks.size(), 
+                    BLOCK_SIZE, 
+                    digests.data(), 
+                    kernel
+                ); 
+            }, 3)
+        );
+    }
+}};
+
+// feeds the same batch of local signatures repeatedly to a new matcher
+void match(
+    const vector<WeakSign>& client,
+    const vector<WeakSign>& batch,
+    size_t file_size
+) {
+    BlockMatcher matcher{client};
+
+    for (Offset offset{0}; offset < file_size; offset += batch.size()) {
+        matcher.consume(offset, batch);
+    }
+}
+
+// matches the signatures at all offsets of the local data against the blocks 
+// of the client data and reports how many matches have different content
+template<typename Signature>
+void report_false_matches(
+    const string& label, 
+    const string& client, 
+    const string& local
+) {
+    vector<Signature> client_signatures{};
+    for (Offset offset{0}; offset + BLOCK_SIZE <= client.size(); offset += BLOCK_SIZE) {
+        if constexpr (is_same_v<Signature, WeakSign64>) {
+            client_signatures.push_back(get_weak_signature64(client, BLOCK_SIZE, offset));
+        }
+        else {
+            client_signatures.push_back(get_weak_signature(client, BLOCK_SIZE, offset));
+        }
+    }
+
+    istringstream local_stream{local};
+    size_t false_matches{0};
+    size_t rejected{0};
+
+    report(
+        label,
+        local.size(),
+        measure([&](){
+            BasicBlockMatcher<Signature> matcher{client_signatures};
+            auto consume{[&](Offset offset, const vector<Signature>& batch){
+                matcher.consume(offset, batch);
+            }};
+
+            if constexpr (is_same_v<Signature, WeakSign64>) {
+                stream_weak_signatures64(local_stream, local.size(), BLOCK_SIZE, 0, consume);
+            }
+            else {
+                stream_weak_signatures(local_stream, local.size(), BLOCK_SIZE, 0, consume);
+            }
+
+            false_matches = 0;
+            for (auto [client_offset, local_offset]: matcher.get_matches()) {
+                false_matches += 
+                    client.compare(client_offset, BLOCK_SIZE, local, local_offset, BLOCK_SIZE) != 0;
+            }
+            rejected = matcher.get_rejected_count();
+        }, 1)
+    );
+
+    fmt::print(
+        "  {} false matches, {:.2e} per offset, {} rejected by the full signature\n", 
+        false_matches, 
+        (double)false_matches / (local.size() - BLOCK_SIZE + 1),
+        rejected
+    );
+}
@@ -0,0 +1,56 @@
+#include "base64_kernels.h"
+#include "benchmarks/bench_utils.h"
+#include "simd.h"
+#include "utils.h"
+
+#include <fmt/core.h>
+#include <random>
+#include <string>
+
+using namespace std;
+using namespace simd;
+
+
+// en- and decodes 64 MiB of random bytes with every kernel supported
+// by this CPU, and with to_base64 and from_base64, which allocate
+// the resulting string as well
+Benchmark base64_codec{"base 64 en- and decoding", [](){
+    mt19937 random_bytes{42};
+    string data(64 * 1024 * 1024, '\0');
+    for (auto& byte: data) {
+        byte = (char)random_bytes();
+    }
+
+    string encoded(base64::encoded_size(data.size()), '\0');
+    string decoded(base64::decoded_size(encoded.size()), '\0');
+
+    for (auto kernel: supported_kernels()) {
+        report(
+            fmt::format("encode {}", kernel_name(kernel)),
+            data.size(),
+            measure([&](){
+                base64::encode(
+                    (const unsigned char*)data.data(), 
+                    data.size(), 
+                    encoded.data(), 
+                    kernel
+                );
+            })
+        );
+        report(
+            fmt::format("decode {}", kernel_name(kernel)),
+            data.size(),
+            measure([&](){
+                base64::decode(
+                    encoded.data(), 
+                    encoded.size(), 
+                    (unsigned char*)decoded.data(), 
+                    kernel
+                );
+            })
+        );
+    }
+
+    report("to_base64", data.size(), measure([&](){ to_base64(data); }));
+    report("from_base64", data.size(), measure([&](){ from_base64(encoded); }));
+}};
@@ -2,6 +2,8 @@
 #include "config.h"
 #include "internal_msg.h"
 #include "pipe.h"
+#include "request_window.h"
+#include "socket_utils.h"
 #include "utils.h"
 #include "exit_code.h"
 #include "presentation/logger.h"
@@ -10,7 +12,9 @@
 #include <asio/io_context.hpp>
 #include <asio/ip/tcp.hpp>
 #include <asio/socket_base.hpp>
+#include <asio/write.hpp>
 #include <chrono>
+#include <thread>
 #include <tuple>
 
 using namespace std;
@@ -18,11 +22,20 @@ using namespace asio::ip;
 using namespace asio;
 
 bool wait_for(SendingPipe<InternalMsgWithOriginator>&, Pipe<InternalMsg>&);
+Handshake shake_hands(tcp::iostream&, Framing, size_t);
 ExitCode handle_server(
     tcp::iostream&, 
+    const Handshake&,
     SendingPipe<InternalMsgWithOriginator>&, 
     Pipe<InternalMsg>&
 );
+void read_responses(
+    tcp::iostream&, 
+    Framing,
+    SendingPipe<InternalMsgWithOriginator>&, 
+    Pipe<InternalMsg>&,
+    RequestWindow&
+);
 bool handle_response(
     const Message&, 
     SendingPipe<InternalMsgWithOriginator>&, 
@@ -32,6 +45,8 @@ bool handle_response(
 
 int run_client(
     const ServerData& config,
+    Framing framing,
+    size_t window,
     SendingPipe<InternalMsgWithOriginator>& file_operator
 ) {
     ExitCode exit_code;
@@ -48,7 +63,12 @@ int run_client(
 
             if (server) {
                 logger->info("Connected to server");
-                exit_code = handle_server(server, file_operator, inbox);
+                exit_code = handle_server(
+                    server, 
+                    shake_hands(server, framing, window), 
+                    file_operator, 
+                    inbox
+                );
                 logger->info("Disconnected from server");
             }
             else {
@@ -94,49 +114,102 @@ bool wait_for(
     }
 }
 
+// servers which don't know the handshake answer with an empty message,
+// then base 64 lines are sent one request at a time
+Handshake shake_hands(tcp::iostream& server, Framing framing, size_t window) {
+    Handshake agreed{};
+    agreed.set_framing(FRAMING_BASE64);
+    agreed.set_window(1);
+
+    if (framing == FRAMING_BASE64 && window <= 1) {
+        return agreed;
+    }
+
+    Message proposal{};
+    proposal.mutable_handshake()->set_framing(framing);
+    proposal.mutable_handshake()->set_window(window);
+    server << msg_to_frame(proposal, FRAMING_BASE64);
+
+    Message answer{msg_from_frame(server, FRAMING_BASE64)};
+    if (answer.has_handshake()) {
+        agreed = answer.handshake();
+    }
+
+    logger->debug(
+        "Using framing " + Framing_Name(agreed.framing()) 
+        + " with " + to_string(agreed.window()) + " requests in flight"
+    );
+    return agreed;
+}
+
+// Requests are sent on this thread as long as fewer than the agreed window
+// are in flight. Another thread reads the responses in the order the server
+// answers them and hands them to the file operator.
 ExitCode handle_server(
     tcp::iostream& server, 
+    const Handshake& agreed,
     SendingPipe<InternalMsgWithOriginator>& file_operator,
     Pipe<InternalMsg>& inbox
 ) {
+    RequestWindow window;
+    thread reader{
+        read_responses, 
+        ref(server), 
+        agreed.framing(), 
+        ref(file_operator), 
+        ref(inbox), 
+        ref(window)
+    };
+
+    auto socket{get_writing_socket(server)};
+    asio::error_code error{};
+    unsigned long request_id{0};
+
     bool finished{false};
-    while (server && !finished) {
+    while (!error && !finished) {
         if (auto optional_msg{inbox.receive()}) {
             auto operator_msg{optional_msg.value()};
             Message msg{};
             
             if (operator_msg.type == InternalMsgType::Exit) {
+                // the server answers the other requests first anyway
+                window.wait_for_none();
                 msg.set_finish(true);
+                finished = true;
             }
             else {
                 msg = operator_msg.msg;
             }
 
-            logger->debug("Sending:\n" + msg.DebugString());
-            server << msg_to_base64(msg) << "\n";
+            if (window.add(agreed.window())) {
+                msg.set_request_id(++request_id);
 
-            if (server) {
-                Message response{msg_from_base64(server)};
-
-                if (server) {
-                    logger->debug("Received:\n" + response.DebugString());
-                
-                    finished = handle_response(response, file_operator, inbox);
-                    if (finished || file_operator.is_closed()) {
-                        server.close();
-                    }
-                }
-            }  
+                logger->debug("Sending:\n" + msg.DebugString());
+                write(socket, buffer(msg_to_frame(msg, agreed.framing())), error);
+            }
+            else {
+                break;
+            }
         }
         else {
+            // the reading thread stopped
             break;
         }
     }
 
-    if (server.error()) {
+    // stops the reading thread, if it still waits for responses
+    if (error) {
+        asio::error_code ignored{};
+        socket.shutdown(tcp::socket::shutdown_both, ignored);
+    }
+
+    reader.join();
+    server.close();
+
+    if (error || server.error()) {
         logger->error(
             "Following connection error occurred: "
-            + server.error().message()
+            + (error ? error : server.error()).message()
         );
         return ConnectionError;
     }
@@ -145,6 +218,32 @@ ExitCode handle_server(
     }
 }
 
+// reads responses until the server answers a finish or the connection fails
+void read_responses(
+    tcp::iostream& server, 
+    Framing framing,
+    SendingPipe<InternalMsgWithOriginator>& file_operator,
+    Pipe<InternalMsg>& inbox,
+    RequestWindow& window
+) {
+    bool finished{false};
+    while (server && !finished) {
+        Message response{msg_from_frame(server, framing)};
+
+        if (server) {
+            logger->debug("Received:\n" + response.DebugString());
+            window.remove();
+
+            finished = 
+                handle_response(response, file_operator, inbox) 
+                || file_operator.is_closed();
+        }
+    }
+
+    window.close();
+    inbox.close();
+}
+
 bool handle_response(
     const Message& response, 
     SendingPipe<InternalMsgWithOriginator>& file_operator,
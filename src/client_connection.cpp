@@ -0,0 +1,332 @@
+#include "client_connection.h"
+#include "utils.h"
+#include "presentation/logger.h"
+
+#include <asio/bind_executor.hpp>
+#include <asio/buffer.hpp>
+#include <asio/post.hpp>
+#include <asio/read.hpp>
+#include <asio/read_until.hpp>
+#include <asio/write.hpp>
+#include <algorithm>
+#include <istream>
+
+using namespace std;
+using namespace asio::ip;
+using namespace asio;
+
+Message get_handshake_response(const Message&, size_t);
+
+
+ClientConnection::ClientConnection(
+    io_context& io_ctx,
+    tcp::socket&& socket,
+    SendingPipe<InternalMsgWithOriginator>& file_operator,
+    atomic<size_t>& connections,
+    size_t max_window
+): socket{move(socket)},
+   strand{io_ctx},
+   file_operator{file_operator},
+   connections{connections},
+   max_window{max_window} {
+    connections++;
+    logger->info("Client connected");
+}
+
+ClientConnection::~ClientConnection() {
+    connections--;
+    logger->info("Client disconnected");
+}
+
+void ClientConnection::start() {
+    post(strand, [connection{shared_from_this()}](){
+        connection->read_request();
+    });
+}
+
+bool ClientConnection::Responses::send(const vector<InternalMsg>& msgs) {
+    post(
+        connection.strand,
+        [connection{connection.shared_from_this()}, msgs{msgs}]() mutable {
+            connection->answer(move(msgs));
+        }
+    );
+
+    return true;
+}
+
+bool ClientConnection::Responses::send(InternalMsg msg) {
+    return send(vector<InternalMsg>{msg});
+}
+
+// returns how many bytes are at least missing for the next request,
+// 0 if it is buffered completely or too large, so it fails as malformed
+size_t ClientConnection::get_missing_bytes() {
+    auto data{input.data()};
+
+    if (framing == FRAMING_BASE64) {
+        auto end{buffers_end(data)};
+        return find(buffers_begin(data), end, '\n') == end ? 1 : 0;
+    }
+
+    unsigned char prefix[4];
+    if (input.size() < sizeof(prefix)) {
+        return sizeof(prefix) - input.size();
+    }
+
+    buffer_copy(buffer(prefix), data);
+    size_t size{
+        (size_t)prefix[0] << 24
+        | (size_t)prefix[1] << 16
+        | (size_t)prefix[2] << 8
+        | (size_t)prefix[3]
+    };
+
+    if (size > MAX_FRAME_SIZE) {
+        return 0;
+    }
+
+    return sizeof(prefix) + size - min(input.size(), sizeof(prefix) + size);
+}
+
+// reads and handles the next request, pauses while the window is full
+// and after the client asked to finish
+void ClientConnection::read_request() {
+    reading = !closed && !finish && in_flight < window;
+    if (!reading) {
+        return;
+    }
+
+    auto missing{get_missing_bytes()};
+
+    if (missing == 0) {
+        istream frame{&input};
+        Message request{msg_from_frame(frame, framing)};
+
+        if (!frame) {
+            logger->error("Received a malformed message");
+            close();
+            return;
+        }
+
+        handle_request(request);
+
+        // continues on the strand, so a buffered burst of requests
+        // doesn't block other handlers
+        post(strand, [connection{shared_from_this()}](){
+            connection->read_request();
+        });
+        return;
+    }
+
+    auto on_read{bind_executor(
+        strand,
+        [connection{shared_from_this()}](const asio::error_code& err, size_t){
+            if (!err) {
+                connection->read_request();
+                return;
+            }
+
+            if (err == error::not_found) {
+                logger->error("Received a message above the maximum size");
+            }
+            else if (err != error::eof && err != error::operation_aborted) {
+                logger->error(
+                    "Following connection error occurred: " + err.message()
+                );
+            }
+            connection->reading = false;
+            connection->close();
+        }
+    )};
+
+    if (framing == FRAMING_BASE64) {
+        async_read_until(socket, input, '\n', on_read);
+    }
+    else {
+        async_read(socket, input, transfer_at_least(missing), on_read);
+    }
+}
+
+void ClientConnection::handle_request(const Message& request) {
+    logger->debug("Received:\n" + request.DebugString());
+
+    if (request.has_finish()) {
+        // answered after all other requests
+        Message response{};
+        response.set_finish(true);
+        response.set_request_id(request.request_id());
+
+        finish = response;
+        finish_if_answered();
+    }
+    else if (request.has_handshake()) {
+        auto response{get_handshake_response(request, max_window)};
+
+        // the response is still framed as the request
+        in_flight++;
+        respond({response});
+
+        framing = response.handshake().framing();
+        window = response.handshake().window();
+    }
+    else {
+        in_flight++;
+        dispatch(request);
+    }
+}
+
+// answers the request or hands it to the file operator,
+// which posts its responses to the strand
+void ClientConnection::dispatch(const Message& request) {
+    Message response{};
+    response.set_request_id(request.request_id());
+
+    switch (request.message_case()) {
+        case Message::kReceived:
+            response.set_received(true);
+            respond({response});
+            break;
+        case Message::MESSAGE_NOT_SET:
+            logger->warn("Received an undefined message");
+            respond({response});
+            break;
+        default:
+            if (file_operator.send(
+                    get_msg_to_file_operator(responses, request))) {
+                if (at_file_operator++ == 0) {
+                    self = shared_from_this();
+                }
+            }
+            else {
+                // the file operator stopped, so the client gets finished
+                in_flight--;
+                response.set_finish(true);
+                finish = response;
+                finish_if_answered();
+            }
+    }
+}
+
+void ClientConnection::answer(vector<InternalMsg>&& msgs) {
+    vector<Message> batch{};
+    for (auto& msg: msgs) {
+        batch.push_back(move(msg.msg));
+    }
+
+    if (batch.empty()) {
+        in_flight--;
+        finish_if_answered();
+        read_request_if_paused();
+    }
+    else {
+        respond(batch);
+    }
+
+    if (--at_file_operator == 0) {
+        self.reset();
+    }
+}
+
+// queues the responses to one request as a single write
+void ClientConnection::respond(const vector<Message>& batch) {
+    string frames{};
+    for (auto& response: batch) {
+        logger->debug("Sending:\n" + response.DebugString());
+        frames += msg_to_frame(response, framing);
+    }
+
+    output.push_back(move(frames));
+    write_response();
+}
+
+void ClientConnection::write_response() {
+    if (writing || output.empty() || closed) {
+        return;
+    }
+
+    writing = true;
+    async_write(socket, buffer(output.front()), bind_executor(
+        strand,
+        [connection{shared_from_this()}](const asio::error_code& err, size_t){
+            connection->writing = false;
+            connection->output.pop_front();
+
+            if (err) {
+                if (err != error::operation_aborted) {
+                    logger->error(
+                        "Following connection error occurred: "
+                        + err.message()
+                    );
+                }
+                connection->close();
+                return;
+            }
+
+            if (connection->finish_sent) {
+                if (connection->output.empty()) {
+                    connection->close();
+                }
+            }
+            else if (connection->in_flight > 0) {
+                connection->in_flight--;
+            }
+
+            connection->write_response();
+            connection->finish_if_answered();
+            connection->read_request_if_paused();
+        }
+    ));
+}
+
+// sends the finish, after every other request is answered
+void ClientConnection::finish_if_answered() {
+    if (finish && !finish_sent && in_flight == 0) {
+        finish_sent = true;
+        respond({finish.value()});
+    }
+}
+
+void ClientConnection::read_request_if_paused() {
+    if (!reading) {
+        read_request();
+    }
+}
+
+void ClientConnection::close() {
+    if (closed) {
+        return;
+    }
+    closed = true;
+
+    // pending handlers get aborted and release the connection
+    asio::error_code ignored{};
+    socket.shutdown(tcp::socket::shutdown_both, ignored);
+    socket.close(ignored);
+}
+
+void ClientConnection::stop() {
+    close();
+
+    at_file_operator = 0;
+    self.reset();
+}
+
+Message get_handshake_response(const Message& request, size_t max_window) {
+    auto& proposal{request.handshake()};
+
+    Message response{};
+    response.set_request_id(request.request_id());
+
+    auto handshake{response.mutable_handshake()};
+    handshake->set_framing(
+        Framing_IsValid(proposal.framing())
+        ? proposal.framing()
+        : FRAMING_BASE64
+    );
+    handshake->set_window(
+        max(min((size_t)proposal.window(), max_window), (size_t)1)
+    );
+
+    return response;
+}
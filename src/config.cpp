@@ -1,4 +1,6 @@
 #include "config.h"
+#include "utils.h"
+#include "file_operator/strong_hash.h"
 #include "presentation/logger_config.h"
 
 #include <CLI11.hpp>
@@ -8,13 +10,20 @@
 #include <fstream>
 #include <iostream>
 #include <optional>
+#include <string>
 #include <variant>
+#include <vector>
 
 using namespace std;
 
 optional<Config> read_config(const std::string&);
 variant<int, Config> override_config(Config&&, int, char*[]);
 string is_ip_address(const std::string& address);
+vector<string> get_strong_hash_names();
+
+const vector<string> chunking_names{"fixed", "content-defined"};
+const vector<string> weak_hash_names{"checksum32", "rabin-karp64"};
+const vector<string> framing_names{"base64", "binary"};
 
 
 variant<int, Config> configure(int argc, char* argv[]) {
@@ -93,6 +102,102 @@ variant<int, Config> configure(int argc, char* argv[]) {
     )
     ->envname("SYNC_MINUTES_BETWEEN")
     ->check(CLI::PositiveNumber);
+    app.add_option(
+        "--strong-hash",
+        sync.strong_hash,
+        "The hash function for strong signatures, client and server agree on one per session\n"
+            "  Supported are " + vector_to_string(get_strong_hash_names()) + "\n"
+            "  Default is md5"
+    )
+    ->envname("SYNC_STRONG_HASH")
+    ->check(CLI::IsMember(get_strong_hash_names()));
+    app.add_option(
+        "--tree-hash-threshold",
+        sync.tree_hash_threshold,
+        "The size in MiB from which on files get hashed in chunks on multiple threads\n"
+            "  0 disables it, default are 256 MiB"
+    )
+    ->envname("SYNC_TREE_HASH_THRESHOLD")
+    ->check(CLI::NonNegativeNumber);
+    app.add_option(
+        "--hash-threads",
+        sync.hash_threads,
+        "The number of threads which hash the files\n"
+            "  0 uses the number of workers for the file operator, default is 0"
+    )
+    ->envname("SYNC_HASH_THREADS")
+    ->check(CLI::NonNegativeNumber);
+    app.add_option(
+        "--chunking",
+        sync.chunking,
+        "How files are cut into blocks for syncing, fixed or content-defined\n"
+            "  Content defined chunks stay the same after insertions, default is fixed"
+    )
+    ->envname("SYNC_CHUNKING")
+    ->check(CLI::IsMember(chunking_names));
+    app.add_option(
+        "--weak-hash",
+        sync.weak_hash,
+        "The rolling hash of the weak signatures of fixed blocks, checksum32 or rabin-karp64\n"
+            "  The 64 bit hash has far fewer false matches in large files, default is checksum32"
+    )
+    ->envname("SYNC_WEAK_HASH")
+    ->check(CLI::IsMember(weak_hash_names));
+    app.add_option(
+        "--range-threshold",
+        sync.range_threshold,
+        "The size in MiB from which on files are compared by ranges, which get split round by round\n"
+            "  where they differ, instead of sending the signatures of all blocks at once\n"
+            "  0 disables it, default is 0"
+    )
+    ->envname("SYNC_RANGE_THRESHOLD")
+    ->check(CLI::NonNegativeNumber);
+    app.add_flag(
+        "--one-round-trip",
+        sync.one_round_trip,
+        "Sends truncated strong signatures together with the weak ones,\n"
+            "  so the server corrects files in its first response"
+    )->envname("SYNC_ONE_ROUND_TRIP");
+    app.add_option(
+        "--refinement-floor",
+        sync.refinement_floor,
+        "The smallest block size in B to which the gaps between matching blocks get refined,\n"
+            "  the blocks get 4 times smaller each round, 0 disables it, default is 0"
+    )
+    ->envname("SYNC_REFINEMENT_FLOOR")
+    ->check(CLI::NonNegativeNumber);
+    app.add_option(
+        "--framing",
+        sync.framing,
+        "How messages are delimited on the connection, base64 or binary\n"
+            "  Binary frames are a third smaller, the client proposes, default is base64"
+    )
+    ->envname("SYNC_FRAMING")
+    ->check(CLI::IsMember(framing_names));
+    app.add_option(
+        "--requests-in-flight",
+        sync.requests_in_flight,
+        "The number of requests the client sends without waiting for their responses,\n"
+            "  a server allows at most its own number, 1 waits for each response, default is 16"
+    )
+    ->envname("SYNC_REQUESTS_IN_FLIGHT")
+    ->check(CLI::PositiveNumber);
+    app.add_option(
+        "--server-threads",
+        sync.server_threads,
+        "The number of threads which handle the connections of the server\n"
+            "  0 uses one thread per CPU core, default is 0"
+    )
+    ->envname("SYNC_SERVER_THREADS")
+    ->check(CLI::NonNegativeNumber);
+    app.add_option(
+        "--max-clients",
+        sync.max_clients,
+        "The number of clients the server accepts at once,\n"
+            "  further clients get disconnected, default is 64"
+    )
+    ->envname("SYNC_MAX_CLIENTS")
+    ->check(CLI::PositiveNumber);
 
     LoggerConfig logger{};
     app.add_flag(
@@ -199,6 +304,34 @@ optional<Config> read_config(const std::string& file_name) {
 
         Config config{j.get<Config>()};
 
+        if (!contains(get_strong_hash_names(), config.sync.strong_hash)) {
+            cerr << "\"sync\".\"strong_hash\" in config file must be one of "
+                 << vector_to_string(get_strong_hash_names()) << endl;
+
+            return nullopt;
+        }
+
+        if (!contains(chunking_names, config.sync.chunking)) {
+            cerr << "\"sync\".\"chunking\" in config file must be one of "
+                 << vector_to_string(chunking_names) << endl;
+
+            return nullopt;
+        }
+
+        if (!contains(weak_hash_names, config.sync.weak_hash)) {
+            cerr << "\"sync\".\"weak_hash\" in config file must be one of "
+                 << vector_to_string(weak_hash_names) << endl;
+
+            return nullopt;
+        }
+
+        if (!contains(framing_names, config.sync.framing)) {
+            cerr << "\"sync\".\"framing\" in config file must be one of "
+                 << vector_to_string(framing_names) << endl;
+
+            return nullopt;
+        }
+
         if (config.act_as_server.has_value()) {
             // bind IP address needs to be checked
 
@@ -308,6 +441,54 @@ variant<int, Config> override_config(Config&& config, int argc, char* argv[]) {
         "-m, --minutes-between-sync",
         sync.minutes_between
     );
+    app.add_option(
+        "--strong-hash",
+        sync.strong_hash
+    )->check(CLI::IsMember(get_strong_hash_names()));
+    app.add_option(
+        "--tree-hash-threshold",
+        sync.tree_hash_threshold
+    )->check(CLI::NonNegativeNumber);
+    app.add_option(
+        "--hash-threads",
+        sync.hash_threads
+    )->check(CLI::NonNegativeNumber);
+    app.add_option(
+        "--chunking",
+        sync.chunking
+    )->check(CLI::IsMember(chunking_names));
+    app.add_option(
+        "--weak-hash",
+        sync.weak_hash
+    )->check(CLI::IsMember(weak_hash_names));
+    app.add_option(
+        "--range-threshold",
+        sync.range_threshold
+    )->check(CLI::NonNegativeNumber);
+    app.add_flag(
+        "--one-round-trip",
+        sync.one_round_trip
+    );
+    app.add_option(
+        "--refinement-floor",
+        sync.refinement_floor
+    )->check(CLI::NonNegativeNumber);
+    app.add_option(
+        "--framing",
+        sync.framing
+    )->check(CLI::IsMember(framing_names));
+    app.add_option(
+        "--requests-in-flight",
+        sync.requests_in_flight
+    )->check(CLI::PositiveNumber);
+    app.add_option(
+        "--server-threads",
+        sync.server_threads
+    )->check(CLI::NonNegativeNumber);
+    app.add_option(
+        "--max-clients",
+        sync.max_clients
+    )->check(CLI::PositiveNumber);
 
     LoggerConfig logger{move(config.logger)};
     app.add_flag(
@@ -381,3 +562,13 @@ string is_ip_address(const std::string& address) {
 
     return err ? err.message() : "";
 }
+
+vector<string> get_strong_hash_names() {
+    vector<string> names{};
+
+    for (auto algorithm: strong_hash::supported_algorithms()) {
+        names.push_back(strong_hash::algorithm_name(algorithm));
+    }
+
+    return names;
+}
@@ -3,15 +3,94 @@
 #include "messages/basic.h"
 #include "type/definitions.h"
 
+#include <cstdlib>
 #include <mutex>
 #include <sqlite_orm/sqlite_orm.h>
 #include <optional>
+#include <stdexcept>
+#include <string>
 #include <vector>
 
 using namespace std;
 using namespace sqlite_orm;
 
 
+// strong signatures are stored as BLOB
+namespace sqlite_orm {
+    template<>
+    struct type_printer<StrongSign>: public blob_printer {};
+
+    template<>
+    struct statement_binder<StrongSign> {
+        int bind(sqlite3_stmt* stmt, int index, const StrongSign& value) {
+            return sqlite3_bind_blob(
+                stmt, 
+                index, 
+                value.bytes.data(), 
+                StrongSign::length, 
+                SQLITE_TRANSIENT
+            );
+        }
+    };
+
+    template<>
+    struct field_printer<StrongSign> {
+        string operator()(const StrongSign& value) const {
+            return value.to_hex();
+        }
+    };
+
+    template<>
+    struct row_extractor<StrongSign> {
+        // a BLOB as text would end at its first zero byte,
+        // only the statement knows its length
+        StrongSign extract(const char*) {
+            throw runtime_error{
+                "Strong signatures can only be extracted from a statement"
+            };
+        }
+
+        StrongSign extract(sqlite3_stmt* stmt, int column_index) {
+            return StrongSign::from_bytes(
+                (const unsigned char*)sqlite3_column_blob(stmt, column_index),
+                sqlite3_column_bytes(stmt, column_index)
+            );
+        }
+    };
+}
+
+// the algorithms of strong signatures are stored as INTEGER
+namespace sqlite_orm {
+    template<>
+    struct type_printer<HashAlgorithm>: public integer_printer {};
+
+    template<>
+    struct statement_binder<HashAlgorithm> {
+        int bind(sqlite3_stmt* stmt, int index, const HashAlgorithm& value) {
+            return sqlite3_bind_int(stmt, index, value);
+        }
+    };
+
+    template<>
+    struct field_printer<HashAlgorithm> {
+        string operator()(const HashAlgorithm& value) const {
+            return to_string(value);
+        }
+    };
+
+    template<>
+    struct row_extractor<HashAlgorithm> {
+        HashAlgorithm extract(const char* row_value) {
+            return (HashAlgorithm)(row_value ? atoi(row_value) : 0);
+        }
+
+        HashAlgorithm extract(sqlite3_stmt* stmt, int column_index) {
+            return (HashAlgorithm)sqlite3_column_int(stmt, column_index);
+        }
+    };
+}
+
+
 struct LastChecked {
     int id;
     Timestamp timestamp;
@@ -28,7 +107,35 @@ auto permanent_db{make_storage(
         make_column("name",      &msg::File::name, primary_key()),
         make_column("timestamp", &msg::File::timestamp),
         make_column("size",      &msg::File::size),
-        make_column("signature", &msg::File::signature)
+        make_column("signature", &msg::File::signature),
+        // rows of older versions have been hashed with MD5 
+        make_column(
+            "signature_algorithm", 
+            &msg::File::signature_algorithm, 
+            default_value((int)HASH_MD5)
+        ),
+        make_column(
+            "signature_chunk_size", 
+            &msg::File::signature_chunk_size, 
+            default_value(0)
+        ),
+        // a file whose status changed gets hashed again
+        make_column("inode",     &msg::File::inode,    default_value(0)),
+        make_column("device",    &msg::File::device,   default_value(0)),
+        make_column("mtime_ns",  &msg::File::mtime_ns, default_value(0)),
+        make_column("ctime_ns",  &msg::File::ctime_ns, default_value(0))
+    ),
+    // the block signatures of a file as it was when it was hashed last
+    make_table(
+        "block_signatures",
+        make_column("name",              &msg::BlockSignatures::name, primary_key()),
+        make_column("size",              &msg::BlockSignatures::size),
+        make_column("mtime_ns",          &msg::BlockSignatures::mtime_ns),
+        make_column("inode",             &msg::BlockSignatures::inode),
+        make_column("block_size",        &msg::BlockSignatures::block_size),
+        make_column("algorithm",         &msg::BlockSignatures::algorithm),
+        make_column("weak_signatures",   &msg::BlockSignatures::weak_signatures),
+        make_column("strong_signatures", &msg::BlockSignatures::strong_signatures)
     ),
     make_table(
         "removed",
@@ -57,12 +164,10 @@ auto in_memory_db{make_storage(
 void db::create(bool exists) {
     scoped_lock db_lck{permanent_db_mtx, in_memory_db_mtx};
 
-    if (!exists) {
-        permanent_db.sync_schema();
-    }
+    // an existing database is migrated to the current schema
+    // the files in it get reconciled with the filesystem
+    permanent_db.sync_schema(exists /* preserve */);
 
-    permanent_db.remove_all<msg::File>();
-    
     in_memory_db.sync_schema();
 }
 
@@ -89,6 +194,7 @@ void db::delete_file(FileName name) {
     lock_guard db_lck{permanent_db_mtx};
 
     permanent_db.remove<msg::File>(name);
+    permanent_db.remove<msg::BlockSignatures>(name);
 }
 
 Result<msg::File> db::get_file(FileName name) {
@@ -111,6 +217,26 @@ vector<msg::File> db::get_files() {
 }
 
 
+void db::insert_block_signatures(msg::BlockSignatures signatures) {
+    lock_guard db_lck{permanent_db_mtx};
+
+    permanent_db.replace(move(signatures));
+}
+
+Result<msg::BlockSignatures> db::get_block_signatures(FileName name) {
+    lock_guard db_lck{permanent_db_mtx};
+
+    if (auto signatures{permanent_db.get_optional<msg::BlockSignatures>(name)}) {
+        return Result<msg::BlockSignatures>::ok(move(signatures.value()));
+    }
+    else {
+        return Result<msg::BlockSignatures>::err(
+            Error{name + " not found in 'block_signatures' table!"}
+        );
+    }
+}
+
+
 void db::insert_removed(msg::Removed file) {
     lock_guard db_lck{permanent_db_mtx};
 
@@ -19,9 +19,12 @@ using namespace std;
 int run_file_operator_worker(
     SyncSystem&, 
     ReceivingPipe<InternalMsgWithOriginator>&,
+    Closable&,
+    SendingPipe<InternalMsg>*&,
     SendingPipe<InternalMsg>*&
 );
-vector<InternalMsg> wrap_messages(const vector<Message>&);
+size_t get_shard_key(const InternalMsgWithOriginator&);
+vector<InternalMsg> wrap_messages(vector<Message>&&, unsigned long);
 vector<Message> handle_msg(const Message&, SyncSystem&);
 
 
@@ -31,28 +34,43 @@ int run_file_operator(
 ) {
     int exit_code;
 
-    try {
-        vector<future<int>> workers{};
-        workers.reserve(config.sync.number_of_workers);
+    NoPipe<InternalMsg> no_pipe;
+    SendingPipe<InternalMsg>* client{&no_pipe};
+    SendingPipe<InternalMsg>* server{&no_pipe};
 
+    try {
         SyncSystem system(config);
 
-        NoPipe<InternalMsg> no_pipe;
-        SendingPipe<InternalMsg>* client{&no_pipe};
+        // each worker handles the requests about the same files
+        ShardedPipe<InternalMsgWithOriginator> shards{
+            config.sync.number_of_workers, 
+            get_shard_key
+        };
+
+        // the workers are waited for before the above gets destroyed
+        vector<future<int>> workers{};
+        workers.reserve(shards.size());
 
-        for (size_t i{0}; i < config.sync.number_of_workers; i++) {
+        for (size_t i{0}; i < shards.size(); i++) {
             workers.push_back(async(
                 launch::async,
                 bind(
                     run_file_operator_worker, 
                     ref(system), 
+                    ref(shards.shard(i)), 
                     ref(inbox), 
-                    ref(client)
+                    ref(client),
+                    ref(server)
             )));
         }
 
         logger->debug("All File Operator workers are started");
 
+        while (auto request{inbox.receive()}) {
+            shards.send(move(request.value()));
+        }
+        shards.close();
+
         exit_code = Success;
 
         for (auto& worker: workers) {
@@ -70,18 +88,23 @@ int run_file_operator(
 
     inbox.close();
 
+    // no worker answers anymore, so the server may stop
+    server->close();
+
     return exit_code;
 }
 
 int run_file_operator_worker(
     SyncSystem& system, 
-    ReceivingPipe<InternalMsgWithOriginator>& inbox,
-    SendingPipe<InternalMsg>*& client
+    ReceivingPipe<InternalMsgWithOriginator>& shard,
+    Closable& inbox,
+    SendingPipe<InternalMsg>*& client,
+    SendingPipe<InternalMsg>*& server
 ) {
     ExitCode exit_code;
 
     try {
-        while (auto optional_msg{inbox.receive()}) {
+        while (auto optional_msg{shard.receive()}) {
             auto request{optional_msg.value()};
 
             switch (request.type) {
@@ -99,14 +122,16 @@ int run_file_operator_worker(
                     });
                     break;
                 case InternalMsgType::ServerWaits:
+                    server = &request.originator;
                     request.originator.send(
                         {InternalMsg(InternalMsgType::FileOperatorStarted)}
                     );
                     break;
                 case InternalMsgType::HandleMessage:
-                    request.originator.send(
-                        wrap_messages(handle_msg(request.msg, system))
-                    );
+                    request.originator.send(wrap_messages(
+                        handle_msg(request.msg, system), 
+                        request.msg.request_id()
+                    ));
                     break;
                 case InternalMsgType::Exit:
                     client->send(InternalMsg(InternalMsgType::Exit));
@@ -134,19 +159,35 @@ int run_file_operator_worker(
         );
 
         exit_code = FileOperatorException;
+
+        // the requests of its shard would never be handled
+        inbox.close();
     }
 
     return exit_code;
 }
 
+// requests about the same file get the same key, so they are handled 
+// in their order, the others are spread by their ID
+size_t get_shard_key(const InternalMsgWithOriginator& request) {
+    if (auto name{get_file_name(request.msg)}) {
+        return hash<FileName>{}(name.value());
+    }
+
+    return request.msg.request_id();
+}
+
+// the responses carry the ID of their request
 vector<InternalMsg> wrap_messages(
-    const vector<Message>& msgs
+    vector<Message>&& msgs,
+    unsigned long request_id
 ) {
     vector<InternalMsg> internal_msgs{};
     internal_msgs.reserve(msgs.size());
 
-    for (auto msg: msgs) {
-        internal_msgs.push_back(get_msg_to_originator(msg));
+    for (auto& msg: msgs) {
+        msg.set_request_id(request_id);
+        internal_msgs.push_back(get_msg_to_originator(move(msg)));
     }
 
     return internal_msgs;
@@ -164,10 +205,19 @@ vector<Message> handle_msg(const Message& request,SyncSystem& system) {
             return system.handle_sync_response(request.sync_response());
         case Message::kSignatureAddendum:
             return {system.get_sync_response(request.signature_addendum())};
+        case Message::kRangeSignatures:
+            return {system.get_sync_response(request.range_signatures())};
+        case Message::kRangeRequest:
+            return {system.get_range_signatures(request.range_request())};
+        case Message::kGapSignatures:
+            return {system.get_sync_response(request.gap_signatures())};
         case Message::kCorrections:
             return {system.correct(request.corrections())};
         case Message::kFileRequest:
-            return {system.get_file(request.file_request().file())};
+            return {system.get_file(
+                request.file_request().file(), 
+                request.file_request().offset()
+            )};
         case Message::kFileResponse:
             return {system.create_file(request.file_response())};
         default: 
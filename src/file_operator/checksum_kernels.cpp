@@ -0,0 +1,347 @@
+#include "file_operator/checksum_kernels.h"
+#include "type/definitions.h"
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define X86_KERNELS
+#include <immintrin.h>
+#endif
+
+using namespace std;
+using namespace checksum;
+using simd::Kernel;
+
+// The sums are calculated modulo 2^32 and only reduced to 16 bits
+// when creating a signature, since 2^16 divides 2^32 the result is the same
+// as when reducing after every step.
+//
+// With a_k = c_0 + ... + c_(k-1) the sums of a block with n bytes are
+//   r1 = a_n
+//   r2 = a_1 + ... + a_n = n * c_0 + (n - 1) * c_1 + ... + 1 * c_(n-1)
+
+Sums block_sums_scalar(const unsigned char*, BlockSize);
+Sums roll_scalar(const unsigned char*, BlockSize, size_t, Sums, WeakSign*);
+
+#ifdef X86_KERNELS
+Sums block_sums_sse41(const unsigned char*, BlockSize);
+Sums roll_sse41(const unsigned char*, BlockSize, size_t, Sums, WeakSign*);
+Sums block_sums_avx2(const unsigned char*, BlockSize);
+Sums roll_avx2(const unsigned char*, BlockSize, size_t, Sums, WeakSign*);
+#endif
+
+
+Sums checksum::block_sums(
+    const unsigned char* data,
+    BlockSize block_size,
+    Kernel kernel
+) {
+    Sums sums{};
+
+    switch (kernel) {
+#ifdef X86_KERNELS
+        case Kernel::SSE41:
+            sums = block_sums_sse41(data, block_size);
+            break;
+        case Kernel::AVX2:
+            sums = block_sums_avx2(data, block_size);
+            break;
+#endif
+        default:
+            sums = block_sums_scalar(data, block_size);
+            break;
+    }
+
+    return {sums.r1 & 0xffff, sums.r2 & 0xffff};
+}
+
+Sums checksum::roll(
+    const unsigned char* data,
+    BlockSize block_size,
+    size_t count,
+    Sums sums,
+    WeakSign* signatures,
+    Kernel kernel
+) {
+    switch (kernel) {
+#ifdef X86_KERNELS
+        case Kernel::SSE41:
+            sums = roll_sse41(data, block_size, count, sums, signatures);
+            break;
+        case Kernel::AVX2:
+            sums = roll_avx2(data, block_size, count, sums, signatures);
+            break;
+#endif
+        default:
+            sums = roll_scalar(data, block_size, count, sums, signatures);
+            break;
+    }
+
+    return {sums.r1 & 0xffff, sums.r2 & 0xffff};
+}
+
+
+Sums block_sums_scalar(const unsigned char* data, BlockSize block_size) {
+    unsigned int a{0};
+    unsigned int b{0};
+
+    for (BlockSize i{0}; i < block_size; i++) {
+        a += data[i];
+        b += a;
+    }
+
+    return {a, b};
+}
+
+Sums roll_scalar(
+    const unsigned char* data,
+    BlockSize block_size,
+    size_t count,
+    Sums sums,
+    WeakSign* signatures
+) {
+    auto [r1, r2]{sums};
+
+    for (size_t i{0}; i < count; i++) {
+        r1 += data[i + block_size];
+        r1 -= data[i];
+        r2 += r1 - block_size * data[i];
+
+        signatures[i] = to_signature({r1, r2});
+    }
+
+    return {r1, r2};
+}
+
+
+#ifdef X86_KERNELS
+
+// The block sums are built chunk by chunk (like in vectorized Adler-32),
+// for a chunk with m bytes c_0 ... c_(m-1) after the already summed a and b:
+//   a' = a + c_0 + ... + c_(m-1)
+//   b' = b + m * a + m * c_0 + (m - 1) * c_1 + ... + 1 * c_(m-1)
+//
+// Rolling takes eight (four) offsets at once, with d_k = c_(k+n) - c_k:
+//   r1_(k+1) = r1_k + d_k                          -> prefix sum over d
+//   r2_(k+1) = r2_k + r1_(k+1) - n * c_k           -> prefix sum over r1 - n * c
+
+__attribute__((target("sse4.1")))
+unsigned int horizontal_sum_sse41(__m128i v) {
+    v = _mm_add_epi32(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 3, 2)));
+    v = _mm_add_epi32(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_extract_epi32(v, 0);
+}
+
+__attribute__((target("sse4.1")))
+__m128i prefix_sum_sse41(__m128i v) {
+    v = _mm_add_epi32(v, _mm_slli_si128(v, 4));
+    return _mm_add_epi32(v, _mm_slli_si128(v, 8));
+}
+
+__attribute__((target("sse4.1")))
+Sums block_sums_sse41(const unsigned char* data, BlockSize block_size) {
+    const __m128i zero{_mm_setzero_si128()};
+    const __m128i ones{_mm_set1_epi16(1)};
+    const __m128i weights{
+        _mm_setr_epi8(16, 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1)
+    };
+
+    __m128i a{zero};
+    __m128i b{zero};
+    __m128i preceding_a{zero};
+
+    BlockSize i{0};
+    for (; i + 16 <= block_size; i += 16) {
+        __m128i chunk{_mm_loadu_si128((const __m128i*)(data + i))};
+
+        preceding_a = _mm_add_epi32(preceding_a, a);
+        a = _mm_add_epi32(a, _mm_sad_epu8(chunk, zero));
+        b = _mm_add_epi32(
+            b,
+            _mm_madd_epi16(_mm_maddubs_epi16(chunk, weights), ones)
+        );
+    }
+    b = _mm_add_epi32(b, _mm_slli_epi32(preceding_a, 4));
+
+    Sums sums{horizontal_sum_sse41(a), horizontal_sum_sse41(b)};
+    for (; i < block_size; i++) {
+        sums.r1 += data[i];
+        sums.r2 += sums.r1;
+    }
+
+    return sums;
+}
+
+__attribute__((target("sse4.1")))
+Sums roll_sse41(
+    const unsigned char* data,
+    BlockSize block_size,
+    size_t count,
+    Sums sums,
+    WeakSign* signatures
+) {
+    const __m128i n{_mm_set1_epi32(block_size)};
+    const __m128i low_mask{_mm_set1_epi32(0xffff)};
+
+    __m128i r1{_mm_set1_epi32(sums.r1)};
+    __m128i r2{_mm_set1_epi32(sums.r2)};
+
+    size_t i{0};
+    for (; i + 4 <= count; i += 4) {
+        int leaving_bytes;
+        int entering_bytes;
+        memcpy(&leaving_bytes, data + i, 4);
+        memcpy(&entering_bytes, data + i + block_size, 4);
+
+        __m128i leaving{_mm_cvtepu8_epi32(_mm_cvtsi32_si128(leaving_bytes))};
+        __m128i entering{_mm_cvtepu8_epi32(_mm_cvtsi32_si128(entering_bytes))};
+
+        r1 = _mm_add_epi32(
+            r1,
+            prefix_sum_sse41(_mm_sub_epi32(entering, leaving))
+        );
+        r2 = _mm_add_epi32(
+            r2,
+            prefix_sum_sse41(_mm_sub_epi32(r1, _mm_mullo_epi32(n, leaving)))
+        );
+
+        _mm_storeu_si128(
+            (__m128i*)(signatures + i),
+            _mm_or_si128(_mm_and_si128(r1, low_mask), _mm_slli_epi32(r2, 16))
+        );
+
+        // carry the sums at the last offset into all lanes
+        r1 = _mm_shuffle_epi32(r1, _MM_SHUFFLE(3, 3, 3, 3));
+        r2 = _mm_shuffle_epi32(r2, _MM_SHUFFLE(3, 3, 3, 3));
+    }
+
+    return roll_scalar(
+        data + i,
+        block_size,
+        count - i,
+        {(unsigned int)_mm_cvtsi128_si32(r1), (unsigned int)_mm_cvtsi128_si32(r2)},
+        signatures + i
+    );
+}
+
+
+__attribute__((target("avx2")))
+unsigned int horizontal_sum_avx2(__m256i v) {
+    return horizontal_sum_sse41(_mm_add_epi32(
+        _mm256_castsi256_si128(v),
+        _mm256_extracti128_si256(v, 1)
+    ));
+}
+
+__attribute__((target("avx2")))
+__m256i prefix_sum_avx2(__m256i v) {
+    // prefix sums within both 128 bit lanes ...
+    v = _mm256_add_epi32(v, _mm256_slli_si256(v, 4));
+    v = _mm256_add_epi32(v, _mm256_slli_si256(v, 8));
+
+    // ... and the last sum of the lower lane added to the upper lane
+    __m256i lower_last{_mm256_shuffle_epi32(v, _MM_SHUFFLE(3, 3, 3, 3))};
+    return _mm256_add_epi32(
+        v,
+        _mm256_permute2x128_si256(lower_last, lower_last, 0x08)
+    );
+}
+
+__attribute__((target("avx2")))
+Sums block_sums_avx2(const unsigned char* data, BlockSize block_size) {
+    const __m256i zero{_mm256_setzero_si256()};
+    const __m256i ones{_mm256_set1_epi16(1)};
+    const __m256i weights{_mm256_setr_epi8(
+        32, 31, 30, 29, 28, 27, 26, 25, 24, 23, 22, 21, 20, 19, 18, 17,
+        16, 15, 14, 13, 12, 11, 10,  9,  8,  7,  6,  5,  4,  3,  2,  1
+    )};
+
+    __m256i a{zero};
+    __m256i b{zero};
+    __m256i preceding_a{zero};
+
+    BlockSize i{0};
+    for (; i + 32 <= block_size; i += 32) {
+        __m256i chunk{_mm256_loadu_si256((const __m256i*)(data + i))};
+
+        preceding_a = _mm256_add_epi32(preceding_a, a);
+        a = _mm256_add_epi32(a, _mm256_sad_epu8(chunk, zero));
+        b = _mm256_add_epi32(
+            b,
+            _mm256_madd_epi16(_mm256_maddubs_epi16(chunk, weights), ones)
+        );
+    }
+    b = _mm256_add_epi32(b, _mm256_slli_epi32(preceding_a, 5));
+
+    Sums sums{horizontal_sum_avx2(a), horizontal_sum_avx2(b)};
+    for (; i < block_size; i++) {
+        sums.r1 += data[i];
+        sums.r2 += sums.r1;
+    }
+
+    return sums;
+}
+
+__attribute__((target("avx2")))
+Sums roll_avx2(
+    const unsigned char* data,
+    BlockSize block_size,
+    size_t count,
+    Sums sums,
+    WeakSign* signatures
+) {
+    const __m256i n{_mm256_set1_epi32(block_size)};
+    const __m256i low_mask{_mm256_set1_epi32(0xffff)};
+    const __m256i last_lane{_mm256_set1_epi32(7)};
+
+    __m256i r1{_mm256_set1_epi32(sums.r1)};
+    __m256i r2{_mm256_set1_epi32(sums.r2)};
+
+    size_t i{0};
+    for (; i + 8 <= count; i += 8) {
+        __m256i leaving{_mm256_cvtepu8_epi32(
+            _mm_loadl_epi64((const __m128i*)(data + i))
+        )};
+        __m256i entering{_mm256_cvtepu8_epi32(
+            _mm_loadl_epi64((const __m128i*)(data + i + block_size))
+        )};
+
+        r1 = _mm256_add_epi32(
+            r1,
+            prefix_sum_avx2(_mm256_sub_epi32(entering, leaving))
+        );
+        r2 = _mm256_add_epi32(
+            r2,
+            prefix_sum_avx2(
+                _mm256_sub_epi32(r1, _mm256_mullo_epi32(n, leaving))
+            )
+        );
+
+        _mm256_storeu_si256(
+            (__m256i*)(signatures + i),
+            _mm256_or_si256(
+                _mm256_and_si256(r1, low_mask),
+                _mm256_slli_epi32(r2, 16)
+            )
+        );
+
+        // carry the sums at the last offset into all lanes
+        r1 = _mm256_permutevar8x32_epi32(r1, last_lane);
+        r2 = _mm256_permutevar8x32_epi32(r2, last_lane);
+    }
+
+    return roll_scalar(
+        data + i,
+        block_size,
+        count - i,
+        {
+            (unsigned int)_mm_cvtsi128_si32(_mm256_castsi256_si128(r1)),
+            (unsigned int)_mm_cvtsi128_si32(_mm256_castsi256_si128(r2))
+        },
+        signatures + i
+    );
+}
+
+#endif
@@ -1,24 +1,50 @@
 #include "file_operator/filesystem.h"
 #include "file_operator/signatures.h"
 #include "messages/basic.h"
+#include "pipe.h"
 #include "type/error.h"
 #include "type/result.h"
 #include "utils.h"
 
 #include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <ctime>
 #include <exception>
 #include <filesystem>
 #include <fstream>
+#include <functional>
+#include <future>
 #include <ios>
+#include <memory>
 #include <mutex>
+#include <numeric>
+#include <optional>
 #include <regex>
+#include <stdexcept>
+#include <string>
 #include <utility>
 #include <vector>
+#include <sys/stat.h>
 
 using namespace std;
 using namespace filesystem;
 
 void remove_empty_dir(const path&);
+bool is_tree_hashed(const fs::Stat&, const fs::Hashing&);
+Result<msg::File> hash_file(const path&, const fs::Stat&, const fs::Hashing&);
+vector<function<void()>> tree_hash_tasks(
+    const path&, 
+    const fs::Stat&, 
+    HashAlgorithm,
+    Result<msg::File>&
+);
+StrongSign hash_chunk(ifstream&, vector<char>&, HashAlgorithm, size_t offset, size_t size);
+void read_chunk(ifstream&, char*, size_t offset, size_t size);
+msg::File to_file(const path&, const fs::Stat&, const StrongSign&, HashAlgorithm, size_t chunk_size);
+bool is_racily_clean(const fs::Stat&);
+int64_t to_nanoseconds(const timespec&);
 
 
 vector<path> fs::get_file_paths(bool include_hidden) {
@@ -54,31 +80,143 @@ bool fs::is_not_hidden(const path& path) {
 }
 
 
-vector<Result<msg::File>> fs::get_files(const vector<path>& paths) {
+// the small files get hashed in batches of this many bytes or files per task
+const size_t HASH_BATCH_SIZE{1 << 22};
+const size_t HASH_BATCH_FILES{64};
+
+vector<Result<msg::File>> fs::get_files(
+    const vector<path>& paths, 
+    const Hashing& hashing,
+    const unordered_map<FileName, msg::File>& known
+) {
     vector<Result<msg::File>> files(paths.size());
-    transform(
-        paths.begin(),
-        paths.end(),
-        files.begin(),
-        [](path file_path){
-            return get_file(file_path);
+
+    // the calling thread stats the files and hands out the hashing as tasks,
+    // the queue is bounded, so the tasks are not created far ahead of the workers
+    size_t workers{max(hashing.threads, (size_t)1)};
+    BoundedPipe<function<void()>> tasks{2 * workers};
+
+    vector<future<void>> worker_threads{};
+    for (size_t i{0}; i < workers; i++) {
+        worker_threads.push_back(async(launch::async, [&](){
+            while (auto task{tasks.receive()}) {
+                (*task)();
+            }
+        }));
+    }
+
+    try {
+        vector<pair<size_t, Stat>> batch{};
+        size_t batch_size{0};
+        auto send_batch{[&](){
+            tasks.send([&files, &paths, &hashing, batch{move(batch)}](){
+                for (auto& [i, stat]: batch) {
+                    files[i] = hash_file(paths[i], stat, hashing);
+                }
+            });
+            batch.clear();
+            batch_size = 0;
+        }};
+
+        for (size_t i{0}; i < paths.size(); i++) {
+            auto stat{get_stat(paths[i])};
+
+            if (stat.is_err()) {
+                files[i] = Result<msg::File>::err(stat.get_err());
+                continue;
+            }
+
+            if (auto known_file{known.find(paths[i])}; 
+                known_file != known.end() && is_unchanged(known_file->second, stat.get_ok())
+            ) {
+                files[i] = Result<msg::File>::ok(known_file->second);
+            }
+            else if (is_tree_hashed(stat.get_ok(), hashing)) {
+                for (auto& task: tree_hash_tasks(paths[i], stat.get_ok(), hashing.algorithm, files[i])) {
+                    tasks.send(move(task));
+                }
+            }
+            else {
+                batch.push_back({i, stat.get_ok()});
+                batch_size += stat.get_ok().size;
+
+                if (batch_size >= HASH_BATCH_SIZE || batch.size() >= HASH_BATCH_FILES) {
+                    send_batch();
+                }
+            }
         }
-    );
+
+        if (!batch.empty()) {
+            send_batch();
+        }
+    }
+    catch (...) {
+        // the workers wait for tasks until the pipe is closed,
+        // so their futures could never be destroyed
+        tasks.close();
+
+        throw;
+    }
+
+    tasks.close();
+    for (auto& worker: worker_threads) {
+        worker.get();
+    }
 
     return files;
 }
 
-Result<msg::File> fs::get_file(const path& path) {
+Result<msg::File> fs::get_file(const path& path, const Hashing& hashing) {
+    return
+        get_stat(path)
+        .flat_map<msg::File>([&](Stat stat){
+            if (!is_tree_hashed(stat, hashing)) {
+                return hash_file(path, stat, hashing);
+            }
+
+            try {
+                return
+                    get_file_signature(
+                        path, 
+                        hashing.algorithm, 
+                        TREE_HASH_CHUNK_SIZE, 
+                        hashing.threads
+                    )
+                    .map<msg::File>([&](StrongSign signature){
+                        return to_file(
+                            path, 
+                            stat, 
+                            signature, 
+                            hashing.algorithm, 
+                            TREE_HASH_CHUNK_SIZE
+                        );
+                    });
+            }
+            catch (const exception& err) {
+                return Result<msg::File>::err(
+                    Error{path.string() + ": " + err.what()}
+                );
+            }
+        });
+}
+
+bool is_tree_hashed(const fs::Stat& stat, const fs::Hashing& hashing) {
+    return hashing.tree_threshold > 0 && stat.size >= hashing.tree_threshold;
+}
+
+// hashes the file at once
+Result<msg::File> hash_file(
+    const path& path, 
+    const fs::Stat& stat, 
+    const fs::Hashing& hashing
+) {
     try {
         ifstream file_stream{path, ios::binary};
+        auto signature{::get_strong_signature(file_stream, hashing.algorithm)};
 
         return Result<msg::File>::ok(
-            msg::File {
-                path, 
-                get_timestamp(last_write_time(path)), 
-                file_size(path),
-                ::get_strong_signature(file_stream)
-            });
+            to_file(path, stat, signature, hashing.algorithm, 0)
+        );
     }
     catch (const exception& err) {
         return Result<msg::File>::err(
@@ -87,20 +225,265 @@ Result<msg::File> fs::get_file(const path& path) {
     }
 }
 
+// returns one task per chunk of the file, 
+// the task which hashes the last remaining chunk sets the result
+vector<function<void()>> tree_hash_tasks(
+    const path& path, 
+    const fs::Stat& stat, 
+    HashAlgorithm algorithm,
+    Result<msg::File>& result
+) {
+    struct TreeHash {
+        vector<StrongSign> chunk_signatures;
+        atomic<size_t> remaining;
+        mutex error_mtx{};
+        optional<string> error{};
+    };
+
+    size_t chunks{max((stat.size + TREE_HASH_CHUNK_SIZE - 1) / TREE_HASH_CHUNK_SIZE, (size_t)1)};
+    auto tree_hash{make_shared<TreeHash>()};
+    tree_hash->chunk_signatures.resize(chunks);
+    tree_hash->remaining = chunks;
+
+    vector<function<void()>> tasks{};
+    for (size_t chunk{0}; chunk < chunks; chunk++) {
+        tasks.push_back([=, &result](){
+            try {
+                ifstream file_stream{path, ios::binary};
+                vector<char> buffer(STREAM_BUFFER_SIZE);
+
+                tree_hash->chunk_signatures[chunk] = hash_chunk(
+                    file_stream, 
+                    buffer, 
+                    algorithm, 
+                    chunk * TREE_HASH_CHUNK_SIZE,
+                    min(TREE_HASH_CHUNK_SIZE, stat.size - chunk * TREE_HASH_CHUNK_SIZE)
+                );
+            }
+            catch (const exception& err) {
+                lock_guard error_lck{tree_hash->error_mtx};
+                tree_hash->error = err.what();
+            }
 
-Result<vector<WeakSign>> fs::get_request_signatures(const path& file) {
+            if (--tree_hash->remaining > 0) {
+                return;
+            }
+
+            try {
+                if (tree_hash->error) {
+                    throw runtime_error{*tree_hash->error};
+                }
+
+                result = Result<msg::File>::ok(
+                    to_file(
+                        path, 
+                        stat,
+                        ::get_tree_signature(tree_hash->chunk_signatures, algorithm),
+                        algorithm,
+                        TREE_HASH_CHUNK_SIZE
+                    ));
+            }
+            catch (const exception& err) {
+                result = Result<msg::File>::err(
+                    Error{path.string() + ": " + err.what()}
+                );
+            }
+        });
+    }
+
+    return tasks;
+}
+
+// hashes size bytes at the offset, throws if the file got shorter in the meantime
+StrongSign hash_chunk(
+    ifstream& file_stream,
+    vector<char>& buffer,
+    HashAlgorithm algorithm,
+    size_t offset,
+    size_t size
+) {
+    auto hasher{strong_hash::make_hasher(algorithm)};
+
+    // seeking discards what the stream has buffered already
+    if (file_stream.tellg() != (streampos)offset) {
+        file_stream.seekg(offset, ios::beg);
+    }
+
+    while (size > 0) {
+        file_stream.read(buffer.data(), min(buffer.size(), size));
+        size_t read{(size_t)max(file_stream.gcount(), (streamsize)0)};
+
+        if (read == 0) {
+            throw runtime_error{"file changed while hashing"};
+        }
+
+        hasher->update(buffer.data(), read);
+        size -= read;
+    }
+
+    return hasher->finish();
+}
+
+// reads size bytes at the offset, throws if the file got shorter in the meantime
+void read_chunk(
+    ifstream& file_stream,
+    char* data,
+    size_t offset,
+    size_t size
+) {
+    if (file_stream.tellg() != (streampos)offset) {
+        file_stream.seekg(offset, ios::beg);
+    }
+
+    file_stream.read(data, size);
+
+    if ((size_t)max(file_stream.gcount(), (streamsize)0) != size) {
+        throw runtime_error{"file changed while hashing"};
+    }
+}
+
+msg::File to_file(
+    const path& path, 
+    const fs::Stat& stat, 
+    const StrongSign& signature,
+    HashAlgorithm algorithm,
+    size_t chunk_size
+) {
+    return msg::File {
+        path, 
+        get_timestamp(last_write_time(path)), 
+        stat.size,
+        signature,
+        algorithm,
+        chunk_size,
+        stat.inode,
+        stat.device,
+        is_racily_clean(stat) ? 0 : stat.mtime_ns,
+        stat.ctime_ns
+    };
+}
+
+Result<fs::Stat> fs::get_stat(const path& file) {
+    struct stat status{};
+
+    if (::stat(file.c_str(), &status) != 0) {
+        return Result<Stat>::err(
+            Error{file.string() + ": " + strerror(errno)}
+        );
+    }
+
+    return Result<Stat>::ok(
+        Stat{
+            (uint64_t)status.st_ino,
+            (uint64_t)status.st_dev,
+            (size_t)status.st_size,
+            to_nanoseconds(status.st_mtim),
+            to_nanoseconds(status.st_ctim)
+        });
+}
+
+bool fs::is_unchanged(const msg::File& file, const Stat& stat) {
+    return 
+        file.inode == stat.inode 
+        && file.device == stat.device
+        && file.size == stat.size
+        && file.mtime_ns == stat.mtime_ns
+        && file.ctime_ns == stat.ctime_ns;
+}
+
+// a file which has been modified right before it got hashed might be modified 
+// again within the resolution of the timestamps without changing its status,
+// so its status isn't trusted for the next scan
+bool is_racily_clean(const fs::Stat& stat) {
+    timespec now{};
+    clock_gettime(CLOCK_REALTIME, &now);
+
+    return to_nanoseconds(now) - stat.mtime_ns < 2'000'000'000;
+}
+
+int64_t to_nanoseconds(const timespec& time) {
+    return (int64_t)time.tv_sec * 1'000'000'000 + time.tv_nsec;
+}
+
+Result<StrongSign> fs::get_file_signature(
+    const path& file,
+    HashAlgorithm algorithm,
+    size_t chunk_size,
+    size_t threads
+) {
+    try {
+        if (chunk_size == 0) {
+            ifstream file_stream{file, ios::binary};
+
+            return Result<StrongSign>::ok(
+                ::get_strong_signature(file_stream, algorithm)
+            );
+        }
+
+        auto size{file_size(file)};
+        size_t chunks{(size + chunk_size - 1) / chunk_size};
+        vector<StrongSign> chunk_signatures(chunks);
+        atomic<size_t> next_chunk{0};
+
+        // every thread takes the next chunk which is not hashed yet
+        // and reads it through its own stream
+        auto hash_chunks{[&](){
+            ifstream file_stream{file, ios::binary};
+            vector<char> buffer(STREAM_BUFFER_SIZE);
+
+            for (size_t chunk{next_chunk++}; chunk < chunks; chunk = next_chunk++) {
+                chunk_signatures[chunk] = hash_chunk(
+                    file_stream, 
+                    buffer, 
+                    algorithm, 
+                    chunk * chunk_size,
+                    min(chunk_size, size - chunk * chunk_size)
+                );
+            }
+        }};
+
+        vector<future<void>> helpers{};
+        for (size_t i{1}; i < min(threads, chunks); i++) {
+            helpers.push_back(async(launch::async, hash_chunks));
+        }
+
+        hash_chunks();
+
+        for (auto& helper: helpers) {
+            helper.get();
+        }
+
+        return Result<StrongSign>::ok(
+            ::get_tree_signature(chunk_signatures, algorithm)
+        );
+    }
+    catch (const exception& err) {
+        return Result<StrongSign>::err(
+            Error{file.string() + ": " + err.what()}
+        );
+    }
+}
+
+
+Result<vector<WeakSign>> fs::get_request_signatures(
+    const path& file, 
+    BlockSize block_size
+) {
     try {
         ifstream file_stream{file, ios::binary};
         auto size{file_size(file)};
         vector<WeakSign> signatures{};
+        signatures.reserve(size / block_size + 1);
+
+        // the blocks are read one after another, so no seeking is needed
+        string block(block_size, '\0');
+        for (Offset offset{0}; offset < size; offset += block_size) {
+            auto size_read{min((unsigned long)block_size, size - offset)};
+            file_stream.read(block.data(), size_read);
 
-        for (Offset offset{0}; offset < size; offset += BLOCK_SIZE) {
             signatures.push_back(
-                ::get_weak_signature(
-                    file_stream,
-                    min((unsigned long)BLOCK_SIZE, size - offset),
-                    offset
-            ));
+                ::get_weak_signature(block, size_read)
+            );
         }
 
         return Result<vector<WeakSign>>::ok(move(signatures));
@@ -112,7 +495,58 @@ Result<vector<WeakSign>> fs::get_request_signatures(const path& file) {
     }
 }
 
-Result<vector<WeakSign>> fs::get_weak_signatures(const path& file) {
+Result<vector<WeakSign64>> fs::get_request_signatures64(
+    const path& file, 
+    BlockSize block_size
+) {
+    try {
+        ifstream file_stream{file, ios::binary};
+        auto size{file_size(file)};
+        vector<WeakSign64> signatures{};
+        signatures.reserve(size / block_size + 1);
+
+        string block(block_size, '\0');
+        for (Offset offset{0}; offset < size; offset += block_size) {
+            auto size_read{min((unsigned long)block_size, size - offset)};
+            file_stream.read(block.data(), size_read);
+
+            signatures.push_back(
+                ::get_weak_signature64(block, size_read)
+            );
+        }
+
+        return Result<vector<WeakSign64>>::ok(move(signatures));
+    }
+    catch (const exception& err) {
+        return Result<vector<WeakSign64>>::err(
+            Error{file.string() + ": " + err.what()}
+        );
+    }
+}
+
+Result<BlockSignatures> fs::get_block_signatures(
+    const path& file, 
+    HashAlgorithm algorithm,
+    BlockSize block_size
+) {
+    try {
+        ifstream file_stream{file, ios::binary};
+
+        return Result<BlockSignatures>::ok(
+            ::get_block_signatures(file_stream, algorithm, block_size)
+        );
+    }
+    catch (const exception& err) {
+        return Result<BlockSignatures>::err(
+            Error{file.string() + ": " + err.what()}
+        );
+    }
+}
+
+Result<vector<WeakSign>> fs::get_weak_signatures(
+    const path& file, 
+    BlockSize block_size
+) {
     try {
         ifstream file_stream{file, ios::binary};
         auto size{file_size(file)};
@@ -121,7 +555,7 @@ Result<vector<WeakSign>> fs::get_weak_signatures(const path& file) {
             ::get_weak_signatures(
                 file_stream, 
                 size, 
-                min(size, (unsigned long)BLOCK_SIZE)
+                min(size, (unsigned long)block_size)
             ));
     }
     catch (const exception& err) {
@@ -131,6 +565,97 @@ Result<vector<WeakSign>> fs::get_weak_signatures(const path& file) {
     }
 }
 
+Result<vector<Chunk>> fs::get_chunks(const path& file) {
+    try {
+        ifstream file_stream{file, ios::binary};
+
+        return Result<vector<Chunk>>::ok(
+            ::get_chunks(file_stream, file_size(file))
+        );
+    }
+    catch (const exception& err) {
+        return Result<vector<Chunk>>::err(
+            Error{file.string() + ": " + err.what()}
+        );
+    }
+}
+
+Result<bool> fs::stream_weak_signatures(
+    const path& file,
+    BlockSize block_size,
+    const function<void(Offset, const vector<WeakSign>&)>& consume
+) {
+    try {
+        ifstream file_stream{file, ios::binary};
+        auto size{file_size(file)};
+
+        ::stream_weak_signatures(
+            file_stream, 
+            size, 
+            min(size, (unsigned long)block_size),
+            0,
+            consume
+        );
+
+        return Result<bool>::ok(true);
+    }
+    catch (const exception& err) {
+        return Result<bool>::err(
+            Error{file.string() + ": " + err.what()}
+        );
+    }
+}
+
+Result<bool> fs::stream_weak_signatures(
+    const path& file,
+    BlockSize block_size,
+    Offset offset,
+    size_t size,
+    const function<void(Offset, const vector<WeakSign>&)>& consume
+) {
+    try {
+        ifstream file_stream{file, ios::binary};
+        auto end{min(offset + size, (size_t)file_size(file))};
+
+        if (offset < end) {
+            ::stream_weak_signatures(file_stream, end, block_size, offset, consume);
+        }
+
+        return Result<bool>::ok(true);
+    }
+    catch (const exception& err) {
+        return Result<bool>::err(
+            Error{file.string() + ": " + err.what()}
+        );
+    }
+}
+
+Result<bool> fs::stream_weak_signatures64(
+    const path& file,
+    BlockSize block_size,
+    const function<void(Offset, const vector<WeakSign64>&)>& consume
+) {
+    try {
+        ifstream file_stream{file, ios::binary};
+        auto size{file_size(file)};
+
+        ::stream_weak_signatures64(
+            file_stream, 
+            size, 
+            min(size, (unsigned long)block_size),
+            0,
+            consume
+        );
+
+        return Result<bool>::ok(true);
+    }
+    catch (const exception& err) {
+        return Result<bool>::err(
+            Error{file.string() + ": " + err.what()}
+        );
+    }
+}
+
 Result<WeakSign> fs::get_weak_signature(
     const std::filesystem::path& file,
     BlockSize block_size,
@@ -149,26 +674,134 @@ Result<WeakSign> fs::get_weak_signature(
     }
 }
 
+Result<WeakSign64> fs::get_weak_signature64(
+    const std::filesystem::path& file,
+    BlockSize block_size,
+    Offset offset
+) {
+    try {
+        ifstream file_stream{file, ios::binary};
+        return Result<WeakSign64>::ok(
+            ::get_weak_signature64(file_stream, block_size, offset)
+        );
+    }
+    catch (const exception& err) {
+        return Result<WeakSign64>::err(
+            Error{file.string() + ": " + err.what()}
+        );
+    }
+}
+
 
 Result<StrongSign> fs::get_strong_signature(
     const std::filesystem::path& file,
     BlockSize size,
-    Offset offset
+    Offset offset,
+    HashAlgorithm algorithm
+) {
+    return
+        get_range_signatures(file, {{offset, size}}, algorithm)
+        .map<StrongSign>([](vector<StrongSign> signatures){
+            return signatures.front();
+        });
+}
+
+
+// the ranges get hashed in batches of this many ranges per thread
+const size_t RANGE_BATCH_SIZE{64};
+
+Result<vector<StrongSign>> fs::get_range_signatures(
+    const path& file,
+    const vector<pair<Offset, size_t>>& ranges,
+    HashAlgorithm algorithm,
+    size_t threads
 ) {
     try {
-        ifstream file_stream{file, ios::binary};
-        vector<char> block(size);
+        // the ranges are read in ascending order, so consecutive ranges
+        // are read without seeking
+        vector<size_t> order(ranges.size());
+        iota(order.begin(), order.end(), 0);
+        sort(order.begin(), order.end(), [&](size_t a, size_t b){
+            return ranges[a].first < ranges[b].first;
+        });
+
+        size_t batches{(ranges.size() + RANGE_BATCH_SIZE - 1) / RANGE_BATCH_SIZE};
+        vector<StrongSign> signatures(ranges.size());
+        atomic<size_t> next_batch{0};
+
+        // every thread takes the next batch of ranges which is not hashed yet
+        // and reads it through its own stream
+        auto hash_batches{[&](){
+            ifstream file_stream{file, ios::binary};
+            vector<char> buffer(STREAM_BUFFER_SIZE);
+            vector<char> blocks_buffer{};
+
+            for (size_t batch{next_batch++}; batch < batches; batch = next_batch++) {
+                auto end{min((batch + 1) * RANGE_BATCH_SIZE, ranges.size())};
+
+                for (size_t i{batch * RANGE_BATCH_SIZE}; i < end;) {
+                    auto size{ranges[order[i]].second};
+
+                    if (size > MAX_BLOCK_SIZE) {
+                        signatures[order[i]] = hash_chunk(
+                            file_stream, 
+                            buffer, 
+                            algorithm, 
+                            ranges[order[i]].first, 
+                            size
+                        );
+                        i++;
+
+                        continue;
+                    }
+
+                    // the following blocks of the same size get hashed at once
+                    size_t j{i};
+                    while (j < end && ranges[order[j]].second == size) {
+                        j++;
+                    }
+
+                    blocks_buffer.resize((j - i) * size);
+                    vector<const char*> blocks{};
+
+                    for (size_t k{i}; k < j; k++) {
+                        blocks.push_back(blocks_buffer.data() + (k - i) * size);
+                        read_chunk(
+                            file_stream, 
+                            blocks_buffer.data() + (k - i) * size, 
+                            ranges[order[k]].first, 
+                            size
+                        );
+                    }
+
+                    auto block_signatures{
+                        ::get_strong_signatures(blocks, size, algorithm)
+                    };
+
+                    for (size_t k{i}; k < j; k++) {
+                        signatures[order[k]] = block_signatures[k - i];
+                    }
+
+                    i = j;
+                }
+            }
+        }};
 
-        file_stream.seekg(offset, ios::beg);
-        file_stream.read(block.data(), size);
+        vector<future<void>> helpers{};
+        for (size_t i{1}; i < min(threads, batches); i++) {
+            helpers.push_back(async(launch::async, hash_batches));
+        }
 
+        hash_batches();
 
-        return Result<StrongSign>::ok(
-            ::get_strong_signature(string{block.begin(), block.end()})
-        );
+        for (auto& helper: helpers) {
+            helper.get();
+        }
+
+        return Result<vector<StrongSign>>::ok(move(signatures));
     }
     catch (const exception& err) {
-        return Result<StrongSign>::err(
+        return Result<vector<StrongSign>>::err(
             Error{file.string() + ": " + err.what()}
         );
     }
@@ -263,6 +896,120 @@ Result<bool> fs::write(const path& file, string&& data) {
 }
 
 
+Result<pair<string, bool>> fs::read_file_chunk(
+    const path& file,
+    Offset offset,
+    size_t max_size
+) {
+    try {
+        ifstream file_stream{file, ios::binary | ios::ate};
+        if (!file_stream) {
+            throw runtime_error{"can't be opened"};
+        }
+
+        Offset size{(Offset)file_stream.tellg()};
+        auto chunk_size{(size_t)(offset < size ? min(max_size, size - offset) : 0)};
+        string chunk(chunk_size, '\0');
+
+        file_stream.seekg(offset, ios::beg);
+        file_stream.read(chunk.data(), chunk_size);
+
+        // a file, which shrank meanwhile, ends with the bytes read
+        auto read_size{(size_t)file_stream.gcount()};
+        chunk.resize(read_size);
+
+        return Result<pair<string, bool>>::ok({
+            move(chunk), 
+            read_size == chunk_size && offset + chunk_size < size
+        });
+    }
+    catch (const exception& err) {
+        return Result<pair<string, bool>>::err(
+            Error{file.string() + ": " + err.what()}
+        );
+    }
+}
+
+Result<bool> fs::write_file_chunk(
+    const path& file, 
+    Offset offset, 
+    const string& data
+) {
+    try {
+        if (file.has_parent_path() && !exists(file.parent_path())) {
+            create_directories(file.parent_path());
+        }
+
+        fstream file_stream{
+            file, 
+            offset == 0 
+            ? ios::binary | ios::out | ios::trunc
+            : ios::binary | ios::in | ios::out
+        };
+        if (!file_stream) {
+            throw runtime_error{"can't be opened"};
+        }
+
+        file_stream.seekp(offset, ios::beg);
+        file_stream.write(data.data(), data.size());
+
+        if (!file_stream) {
+            throw runtime_error{"couldn't be written"};
+        }
+
+        return Result<bool>::ok(true);
+    }
+    catch (const exception& err) {
+        return Result<bool>::err(
+            Error{"Writing " + file.string() + ": " + err.what()}
+        );
+    }
+}
+
+path fs::get_receiving_path(const path& file) {
+    // the hash of the whole path keeps files of the same name apart
+    return 
+        path{".sync"} / path{"tmp"} 
+        / (to_string(hash<string>{}(file.string())) + "_" 
+           + file.filename().string());
+}
+
+Result<bool> fs::move_received_file(const msg::File& received_file) {
+    auto receiving_path{get_receiving_path(received_file.name)};
+
+    try {
+        // a file, which changed at the peer during the transfer, 
+        // consists of chunks of different versions
+        auto received{file_size(receiving_path) == received_file.size};
+
+        if (received) {
+            auto signature{get_file_signature(
+                receiving_path,
+                received_file.signature_algorithm,
+                received_file.signature_chunk_size
+            )};
+
+            received = 
+                signature.is_ok() 
+                && signature.get_ok() == received_file.signature;
+        }
+
+        if (!received) {
+            remove_file(receiving_path);
+
+            return Result<bool>::ok(false);
+        }
+
+        return move_file(receiving_path, received_file.name);
+    }
+    catch (const exception& err) {
+        return Result<bool>::err(
+            Error{"Receiving " + received_file.name + ": " + err.what()}
+        );
+    }
+}
+
+
 Result<bool> fs::move_file(const path& old_path, const path& new_path) {
     try {
         if (new_path.has_parent_path() && !exists(new_path.parent_path())) {
@@ -290,7 +1037,7 @@ void fs::remove_file(const path& path) {
 }
 
 void remove_empty_dir(const path& directory) {
-    if (filesystem::is_empty(directory)) {
+    if (exists(directory) && filesystem::is_empty(directory)) {
         remove(directory);
     }
 }
@@ -301,27 +1048,46 @@ mutex build_mtx{};
 
 Result<bool> fs::build_file(
     vector<pair<msg::Data, bool /* has data */>>&& data,
-    const path& path
+    const path& path,
+    const msg::File& built_file
 ) {
     lock_guard build_lck{build_mtx};
 
     try {
         ::path temp_path{::path{".sync"} /= ::path{"tmp"} / path.filename()};
 
-        ofstream file{temp_path, ios::binary};
-
-        for (auto [block, has_data]: data) {
-            if (has_data) {
-                file.write(block.data.c_str(), block.data.size());
-            }
-            else {
-                file.write(
-                    read(path, block.offset, block.size).get_ok().c_str(), 
-                    block.size
-                );
+        // moving a file out of it removes the directory, once it is empty
+        create_directories(temp_path.parent_path());
+
+        {
+            ofstream file{temp_path, ios::binary};
+
+            for (auto [block, has_data]: data) {
+                if (has_data) {
+                    file.write(block.data.c_str(), block.data.size());
+                }
+                else {
+                    file.write(
+                        read(path, block.offset, block.size).get_ok().c_str(), 
+                        block.size
+                    );
+                }
             }
         }
 
+        // blocks matched by colliding signatures would corrupt the file
+        auto signature{get_file_signature(
+            temp_path, 
+            built_file.signature_algorithm, 
+            built_file.signature_chunk_size
+        )};
+
+        if (signature.is_err() || signature.get_ok() != built_file.signature) {
+            remove_file(temp_path);
+
+            return Result<bool>::ok(false);
+        }
+
         return move_file(temp_path, path);
     }
     catch (const exception& err) {
@@ -335,6 +1101,8 @@ Result<bool> fs::build_file(
 #ifdef UNIT_TESTS
 #include "unit_tests/doctest_utils.h"
 #include <doctest.h>
+#include <random>
+#include <string>
 
 using namespace fs;
 
@@ -357,6 +1125,326 @@ TEST_SUITE("file operations utils") {
         CHECK(is_not_hidden(not_hidden_path));
         CHECK(!is_hidden(not_hidden_path));
     }
+    TEST_CASE("file signature") {
+        auto file{temp_directory_path() / "sync_file_signature_test"};
+        string data(1000003, '\0');
+        mt19937 random_bytes{3};
+        generate(data.begin(), data.end(), [&](){ return (char)random_bytes(); });
+        REQUIRE(write(file, string{data}).is_ok());
+
+        SUBCASE("hashed at once") {
+            CHECK(
+                get_file_signature(file, HASH_MD5).get_ok() 
+                == 
+                ::get_strong_signature(data)
+            );
+        }
+        SUBCASE("tree hash") {
+            vector<size_t> chunk_sizes{4096, 100000, 1 << 20, 1 << 24};
+            size_t chunk_size{};
+            DOCTEST_VALUE_PARAMETERIZED_DATA(chunk_size, chunk_sizes);
+
+            vector<StrongSign> chunk_signatures{};
+            for (size_t offset{0}; offset < data.size(); offset += chunk_size) {
+                chunk_signatures.push_back(
+                    ::get_strong_signature(data.substr(offset, chunk_size))
+                );
+            }
+            auto expected{::get_tree_signature(chunk_signatures)};
+
+            for (size_t threads: {1, 2, 5}) {
+                CHECK(
+                    get_file_signature(file, HASH_MD5, chunk_size, threads).get_ok() 
+                    == 
+                    expected
+                );
+            }
+        }
+        SUBCASE("request signatures of blocks of the given size") {
+            auto block_size{get_block_size(data.size())};
+            auto signatures{get_request_signatures(file, block_size).get_ok()};
+
+            REQUIRE(signatures.size() == (data.size() + block_size - 1) / block_size);
+            CHECK(signatures.front() == ::get_weak_signature(data, block_size));
+            CHECK(
+                signatures.back() 
+                == 
+                ::get_weak_signature(
+                    data, 
+                    data.size() % block_size, 
+                    data.size() - data.size() % block_size
+                )
+            );
+        }
+        SUBCASE("range signatures in the given order") {
+            vector<pair<Offset, size_t>> ranges{};
+            for (size_t i{0}; i < 500; i++) {
+                auto offset{(Offset)(random_bytes() % data.size())};
+                ranges.push_back({offset, min((size_t)6000, data.size() - offset)});
+            }
+
+            for (size_t threads: {1, 3}) {
+                auto signatures{
+                    get_range_signatures(file, ranges, HASH_MD5, threads).get_ok()
+                };
+
+                REQUIRE(signatures.size() == ranges.size());
+                for (size_t i{0}; i < ranges.size(); i++) {
+                    CHECK(
+                        signatures[i] 
+                        == 
+                        ::get_strong_signature(
+                            data.substr(ranges[i].first, ranges[i].second)
+                        )
+                    );
+                }
+            }
+
+            CHECK(
+                get_strong_signature(file, 6000, 12345, HASH_MD5).get_ok()
+                ==
+                ::get_strong_signature(data.substr(12345, 6000))
+            );
+            CHECK(get_range_signatures(file, {{data.size() - 10, 20}}, HASH_MD5).is_err());
+        }
+        SUBCASE("weak signatures within a range") {
+            vector<WeakSign> streamed{};
+            stream_weak_signatures(
+                file, 
+                700, 
+                5000, 
+                3000, 
+                [&](Offset offset, const vector<WeakSign>& batch){
+                    REQUIRE(offset == 5000 + streamed.size());
+                    streamed.insert(streamed.end(), batch.begin(), batch.end());
+                }
+            );
+
+            CHECK(streamed == ::get_weak_signatures(data.substr(5000, 3000), 700));
+        }
+        SUBCASE("block signatures") {
+            auto block_size{get_block_size(data.size())};
+            auto signatures{get_block_signatures(file, HASH_MD5, block_size).get_ok()};
+
+            CHECK(signatures.block_size == block_size);
+            CHECK(signatures.weak == get_request_signatures(file, block_size).get_ok());
+            REQUIRE(signatures.strong.size() == signatures.weak.size());
+            CHECK(signatures.strong.back() == ::get_strong_signature(
+                data.substr((signatures.strong.size() - 1) * block_size)
+            ));
+        }
+        SUBCASE("tree hash above the threshold") {
+            auto small{get_file(file, Hashing{HASH_MD5, data.size() + 1, 4})};
+            auto large{get_file(file, Hashing{HASH_MD5, data.size(), 4})};
+
+            CHECK(small.get_ok().signature_chunk_size == 0);
+            CHECK(small.get_ok().signature == ::get_strong_signature(data));
+            CHECK(large.get_ok().signature_chunk_size == TREE_HASH_CHUNK_SIZE);
+            CHECK(
+                large.get_ok().signature 
+                == 
+                ::get_tree_signature({::get_strong_signature(data)})
+            );
+        }
+
+        remove(file);
+    }
+    TEST_CASE("files hashed in parallel") {
+        auto directory{temp_directory_path() / "sync_parallel_hashing_test"};
+        vector<path> files{};
+        vector<string> data{};
+        mt19937 random_bytes{5};
+
+        for (size_t size: {0, 10, 1000, 100000, 3000000, 20000000}) {
+            files.push_back(directory / to_string(size));
+            data.push_back(string(size, '\0'));
+            generate(data.back().begin(), data.back().end(), [&](){ return (char)random_bytes(); });
+            REQUIRE(write(files.back(), string{data.back()}).is_ok());
+        }
+        files.push_back(directory / "missing");
+
+        auto hashed{get_files(files, Hashing{HASH_MD5, 1000000, 3})};
+        REQUIRE(hashed.size() == files.size());
+
+        for (size_t i{0}; i < data.size(); i++) {
+            auto expected{get_file(files[i], Hashing{HASH_MD5, 1000000, 1}).get_ok()};
+            auto file{hashed[i].get_ok()};
+
+            CHECK(file.name == files[i]);
+            CHECK(file.size == data[i].size());
+            CHECK(file.signature == expected.signature);
+            CHECK(file.signature_chunk_size == expected.signature_chunk_size);
+        }
+        CHECK(hashed.back().is_err());
+
+        remove_all(directory);
+    }
+    TEST_CASE("changed file") {
+        auto file{temp_directory_path() / "sync_changed_file_test"};
+        REQUIRE(write(file, "data").is_ok());
+
+        auto stat{get_stat(file).get_ok()};
+        msg::File known{
+            file, 0, stat.size, StrongSign{}, HASH_MD5, 0,
+            stat.inode, stat.device, stat.mtime_ns, stat.ctime_ns
+        };
+        CHECK(is_unchanged(known, stat));
+
+        SUBCASE("unchanged file is not hashed again") {
+            auto files{get_files({file}, Hashing{}, {{file, known}})};
+
+            CHECK(files.at(0).get_ok().signature == StrongSign{});
+        }
+        SUBCASE("changed file is hashed again") {
+            REQUIRE(write(file, "other data").is_ok());
+            auto files{get_files({file}, Hashing{}, {{file, known}})};
+
+            CHECK(!is_unchanged(known, get_stat(file).get_ok()));
+            CHECK(files.at(0).get_ok().signature == ::get_strong_signature("other data"));
+            CHECK(files.at(0).get_ok().size == 10);
+        }
+        SUBCASE("status of a just modified file is not trusted") {
+            auto hashed{get_file(file, Hashing{}).get_ok()};
+
+            CHECK(hashed.inode == stat.inode);
+            CHECK(!is_unchanged(hashed, stat));
+        }
+
+        remove(file);
+    }
+    TEST_CASE("file in chunks") {
+        auto file{temp_directory_path() / "sync_file_chunks_test"};
+        auto copy{temp_directory_path() / "sync_file_chunks_test_copy"};
+        string data(100003, '\0');
+        mt19937 random_bytes{7};
+        generate(data.begin(), data.end(), [&](){ return (char)random_bytes(); });
+        REQUIRE(write(file, string{data}).is_ok());
+
+        SUBCASE("copied chunk by chunk") {
+            for (size_t chunk_size: {1000, 4096, 100003, 1 << 20}) {
+                // a longer file is overwritten by the first chunk
+                REQUIRE(write(copy, string(200000, 'x')).is_ok());
+
+                Offset offset{0};
+                bool more{true};
+                while (more) {
+                    auto chunk{read_file_chunk(file, offset, chunk_size).get_ok()};
+                    CHECK(chunk.first == data.substr(offset, chunk_size));
+
+                    REQUIRE(write_file_chunk(copy, offset, chunk.first).is_ok());
+                    offset += chunk.first.size();
+                    more = chunk.second;
+                }
+
+                CHECK(offset == data.size());
+                CHECK(read(copy).get_ok() == data);
+            }
+        }
+        SUBCASE("beyond the end") {
+            auto chunk{read_file_chunk(file, data.size() + 1, 4096).get_ok()};
+
+            CHECK(chunk.first.empty());
+            CHECK(!chunk.second);
+        }
+        SUBCASE("empty file") {
+            REQUIRE(write(file, "").is_ok());
+            auto chunk{read_file_chunk(file, 0, 4096).get_ok()};
+
+            CHECK(chunk.first.empty());
+            CHECK(!chunk.second);
+        }
+        SUBCASE("missing file") {
+            CHECK(read_file_chunk(temp_directory_path() / "sync_missing", 0, 1).is_err());
+        }
+
+        remove(file);
+        remove(copy);
+    }
+    TEST_CASE("built file") {
+        // files are built in .sync/tmp of the working directory
+        auto working_directory{current_path()};
+        auto directory{temp_directory_path() / "sync_build_file_test"};
+        create_directories(directory);
+        current_path(directory);
+
+        path file{"file"};
+        string local(3000, 'a');
+        string peers{local};
+        peers.replace(1000, 1000, string(1000, 'b'));
+        REQUIRE(write(file, string{local}).is_ok());
+
+        msg::File peers_file{"file", 0, peers.size(), ::get_strong_signature(peers), HASH_MD5, 0};
+
+        SUBCASE("with the signature of the peer's file") {
+            vector<pair<msg::Data, bool>> data{
+                {msg::Data{"file", 0, 1000, ""}, false},
+                {msg::Data{"file", 1000, 1000, string(1000, 'b')}, true},
+                {msg::Data{"file", 2000, 1000, ""}, false}
+            };
+
+            CHECK(build_file(move(data), file, peers_file).get_ok());
+            CHECK(read(file).get_ok() == peers);
+        }
+        SUBCASE("a block matched by colliding signatures") {
+            // the local block took the place of the peer's one, 
+            // as if their weak and truncated strong signatures were equal
+            vector<pair<msg::Data, bool>> data{
+                {msg::Data{"file", 0, 1000, ""}, false},
+                {msg::Data{"file", 1000, 1000, ""}, false},
+                {msg::Data{"file", 2000, 1000, ""}, false}
+            };
+
+            CHECK_FALSE(build_file(move(data), file, peers_file).get_ok());
+            CHECK(read(file).get_ok() == local);
+            CHECK_FALSE(exists(path{".sync"} / "tmp"));
+        }
+
+        current_path(working_directory);
+        remove_all(directory);
+    }
+    TEST_CASE("received file") {
+        // files are received in .sync/tmp of the working directory
+        auto working_directory{current_path()};
+        auto directory{temp_directory_path() / "sync_received_file_test"};
+        create_directories(directory);
+        current_path(directory);
+
+        string local(3000, 'a');
+        string peers(3000, 'b');
+        REQUIRE(write("file", string{local}).is_ok());
+
+        msg::File peers_file{"file", 0, peers.size(), ::get_strong_signature(peers), HASH_MD5, 0};
+        auto receiving_path{get_receiving_path("file")};
+
+        SUBCASE("with the signature of the peer's file") {
+            REQUIRE(write_file_chunk(receiving_path, 0, peers).is_ok());
+
+            CHECK(move_received_file(peers_file).get_ok());
+            CHECK(read("file").get_ok() == peers);
+        }
+        SUBCASE("changed at the peer during the transfer") {
+            REQUIRE(write_file_chunk(receiving_path, 0, peers.substr(0, 1000)).is_ok());
+            REQUIRE(write_file_chunk(receiving_path, 1000, string(2000, 'c')).is_ok());
+
+            CHECK_FALSE(move_received_file(peers_file).get_ok());
+            CHECK(read("file").get_ok() == local);
+            CHECK_FALSE(exists(receiving_path));
+        }
+        SUBCASE("shrunk at the peer during the transfer") {
+            REQUIRE(write_file_chunk(receiving_path, 0, peers.substr(0, 1000)).is_ok());
+
+            CHECK_FALSE(move_received_file(peers_file).get_ok());
+            CHECK(read("file").get_ok() == local);
+            CHECK_FALSE(exists(receiving_path));
+        }
+        SUBCASE("not received") {
+            CHECK(move_received_file(peers_file).is_err());
+            CHECK(read("file").get_ok() == local);
+        }
+
+        current_path(working_directory);
+        remove_all(directory);
+    }
 }
 
 #endif
@@ -0,0 +1,156 @@
+#include "file_operator/hash_queue.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <functional>
+#include <iterator>
+#include <mutex>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+using namespace std;
+
+
+HashQueue::HashQueue(
+    function<void(const vector<filesystem::path>&)> hash,
+    size_t batch_size
+): hash{move(hash)},
+   batch_size{max(batch_size, (size_t)1)},
+   worker{&HashQueue::run, this}
+{}
+
+HashQueue::~HashQueue() {
+    {
+        lock_guard queue_lck{queue_mtx};
+        stopped = true;
+        queue_changed.notify_all();
+    }
+
+    worker.join();
+}
+
+
+void HashQueue::push(const vector<filesystem::path>& files) {
+    lock_guard queue_lck{queue_mtx};
+
+    for (auto& file: files) {
+        if (!waiting_names.count(file) && !hashing.count(file)) {
+            waiting.push_back(file);
+            waiting_names.insert(file);
+        }
+    }
+
+    queue_changed.notify_all();
+}
+
+void HashQueue::prioritise(const FileName& name) {
+    prioritise(vector<FileName>{name});
+}
+
+void HashQueue::prioritise(const vector<FileName>& names) {
+    unique_lock queue_lck{queue_mtx};
+
+    unordered_set<FileName> prioritised{};
+    for (auto& name: names) {
+        if (waiting_names.count(name)) {
+            prioritised.insert(name);
+        }
+    }
+
+    if (!prioritised.empty()) {
+        // the requesting thread takes the files out of the queue at once
+        auto is_prioritised{[&](const filesystem::path& file){
+            return prioritised.count(file.string()) > 0;
+        }};
+
+        vector<filesystem::path> files{};
+        copy_if(
+            waiting.begin(), 
+            waiting.end(), 
+            back_inserter(files), 
+            is_prioritised
+        );
+        waiting.erase(
+            remove_if(waiting.begin(), waiting.end(), is_prioritised),
+            waiting.end()
+        );
+
+        for (auto& name: prioritised) {
+            waiting_names.erase(name);
+        }
+
+        hash_now(files, queue_lck);
+    }
+
+    // the others may be hashed by the background thread right now
+    queue_changed.wait(queue_lck, [&](){
+        return none_of(names.begin(), names.end(), [&](const FileName& name){
+            return hashing.count(name) > 0;
+        });
+    });
+}
+
+bool HashQueue::is_pending(const FileName& name) {
+    lock_guard queue_lck{queue_mtx};
+
+    return waiting_names.count(name) || hashing.count(name);
+}
+
+vector<FileName> HashQueue::get_pending() {
+    lock_guard queue_lck{queue_mtx};
+
+    vector<FileName> pending{waiting.begin(), waiting.end()};
+    pending.insert(pending.end(), hashing.begin(), hashing.end());
+
+    return pending;
+}
+
+void HashQueue::wait() {
+    unique_lock queue_lck{queue_mtx};
+
+    queue_changed.wait(queue_lck, [&](){
+        return waiting.empty() && hashing.empty();
+    });
+}
+
+
+void HashQueue::run() {
+    unique_lock queue_lck{queue_mtx};
+
+    while (true) {
+        queue_changed.wait(queue_lck, [&](){
+            return stopped || !waiting.empty();
+        });
+
+        if (stopped) {
+            return;
+        }
+
+        vector<filesystem::path> files{};
+        while (!waiting.empty() && files.size() < batch_size) {
+            files.push_back(waiting.front());
+            waiting.pop_front();
+            waiting_names.erase(files.back());
+        }
+
+        hash_now(files, queue_lck);
+    }
+}
+
+// hashes the files without holding the lock
+void HashQueue::hash_now(
+    const vector<filesystem::path>& files,
+    unique_lock<mutex>& queue_lck
+) {
+    hashing.insert(files.begin(), files.end());
+    queue_lck.unlock();
+
+    hash(files);
+
+    queue_lck.lock();
+    for (auto& file: files) {
+        hashing.erase(file);
+    }
+    queue_changed.notify_all();
+}
@@ -0,0 +1,275 @@
+#include "file_operator/md5_kernels.h"
+#include "type/definitions.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define X86_KERNELS
+#endif
+
+using namespace std;
+using namespace simd;
+
+// Every lane runs the plain MD5 (RFC 1321) on its own block. The lanes
+// are GCC vector types, so the same code compiles to SSE or AVX2 instructions
+// when it gets inlined into a function with the respective target.
+
+void hash_scalar(const unsigned char* const*, size_t, StrongSign*);
+
+#ifdef X86_KERNELS
+typedef uint32_t Lanes4 __attribute__((vector_size(16)));
+typedef uint32_t Lanes8 __attribute__((vector_size(32)));
+
+void hash_sse41(const unsigned char* const*, size_t, StrongSign*);
+void hash_avx2(const unsigned char* const*, size_t, StrongSign*);
+#endif
+
+
+size_t md5::lanes(Kernel kernel) {
+    switch (kernel) {
+#ifdef X86_KERNELS
+        case Kernel::SSE41:
+            return 4;
+        case Kernel::AVX2:
+            return 8;
+#endif
+        default:
+            return 1;
+    }
+}
+
+void md5::hash_blocks(
+    const unsigned char* const* blocks,
+    size_t count,
+    size_t block_size,
+    StrongSign* digests,
+    Kernel kernel
+) {
+    auto lane_count{lanes(kernel)};
+
+    for (size_t first{0}; first < count; first += lane_count) {
+        // missing blocks of the last group are filled up with its last block
+        const unsigned char* group[8];
+        StrongSign group_digests[8];
+        for (size_t lane{0}; lane < lane_count; lane++) {
+            group[lane] = blocks[min(first + lane, count - 1)];
+        }
+
+        switch (kernel) {
+#ifdef X86_KERNELS
+            case Kernel::SSE41:
+                hash_sse41(group, block_size, group_digests);
+                break;
+            case Kernel::AVX2:
+                hash_avx2(group, block_size, group_digests);
+                break;
+#endif
+            default:
+                hash_scalar(group, block_size, group_digests);
+                break;
+        }
+
+        copy_n(group_digests, min(lane_count, count - first), digests + first);
+    }
+}
+
+
+const uint32_t ROUND_CONSTANTS[64]{
+    0xd76aa478, 0xe8c7b756, 0x242070db, 0xc1bdceee, 0xf57c0faf, 0x4787c62a, 0xa8304613, 0xfd469501,
+    0x698098d8, 0x8b44f7af, 0xffff5bb1, 0x895cd7be, 0x6b901122, 0xfd987193, 0xa679438e, 0x49b40821,
+    0xf61e2562, 0xc040b340, 0x265e5a51, 0xe9b6c7aa, 0xd62f105d, 0x02441453, 0xd8a1e681, 0xe7d3fbc8,
+    0x21e1cde6, 0xc33707d6, 0xf4d50d87, 0x455a14ed, 0xa9e3e905, 0xfcefa3f8, 0x676f02d9, 0x8d2a4c8a,
+    0xfffa3942, 0x8771f681, 0x6d9d6122, 0xfde5380c, 0xa4beea44, 0x4bdecfa9, 0xf6bb4b60, 0xbebfbc70,
+    0x289b7ec6, 0xeaa127fa, 0xd4ef3085, 0x04881d05, 0xd9d4d039, 0xe6db99e5, 0x1fa27cf8, 0xc4ac5665,
+    0xf4292244, 0x432aff97, 0xab9423a7, 0xfc93a039, 0x655b59c3, 0x8f0ccc92, 0xffeff47d, 0x85845dd1,
+    0x6fa87e4f, 0xfe2ce6e0, 0xa3014314, 0x4e0811a1, 0xf7537e82, 0xbd3af235, 0x2ad7d2bb, 0xeb86d391
+};
+
+const unsigned int SHIFTS[64]{
+    7, 12, 17, 22, 7, 12, 17, 22, 7, 12, 17, 22, 7, 12, 17, 22,
+    5,  9, 14, 20, 5,  9, 14, 20, 5,  9, 14, 20, 5,  9, 14, 20,
+    4, 11, 16, 23, 4, 11, 16, 23, 4, 11, 16, 23, 4, 11, 16, 23,
+    6, 10, 15, 21, 6, 10, 15, 21, 6, 10, 15, 21, 6, 10, 15, 21
+};
+
+inline uint32_t load_le32(const unsigned char* bytes) {
+    return
+        (uint32_t)bytes[0]
+        | (uint32_t)bytes[1] << 8
+        | (uint32_t)bytes[2] << 16
+        | (uint32_t)bytes[3] << 24;
+}
+
+// the vectors are only passed by pointer and everything gets inlined,
+// so no vector crosses a function boundary of another target
+template<typename V, size_t LANES>
+__attribute__((always_inline)) inline void set_lane(V* v, size_t lane, uint32_t value) {
+    if constexpr (LANES == 1) {
+        *v = value;
+    }
+    else {
+        (*v)[lane] = value;
+    }
+}
+
+template<typename V, size_t LANES>
+__attribute__((always_inline)) inline uint32_t get_lane(const V* v, size_t lane) {
+    if constexpr (LANES == 1) {
+        return *v;
+    }
+    else {
+        return (*v)[lane];
+    }
+}
+
+// processes one 64 byte chunk of every lane
+template<typename V, size_t LANES>
+__attribute__((always_inline)) inline void compress(
+    V* state,
+    const unsigned char* const* chunks
+) {
+    V words[16];
+    for (size_t word{0}; word < 16; word++) {
+        for (size_t lane{0}; lane < LANES; lane++) {
+            set_lane<V, LANES>(&words[word], lane, load_le32(chunks[lane] + 4 * word));
+        }
+    }
+
+    V a{state[0]};
+    V b{state[1]};
+    V c{state[2]};
+    V d{state[3]};
+
+#pragma GCC unroll 64
+    for (unsigned int i{0}; i < 64; i++) {
+        V f;
+        unsigned int word;
+
+        if (i < 16) {
+            f = (b & c) | (~b & d);
+            word = i;
+        }
+        else if (i < 32) {
+            f = (d & b) | (~d & c);
+            word = (5 * i + 1) % 16;
+        }
+        else if (i < 48) {
+            f = b ^ c ^ d;
+            word = (3 * i + 5) % 16;
+        }
+        else {
+            f = c ^ (b | ~d);
+            word = (7 * i) % 16;
+        }
+
+        f = f + a + ROUND_CONSTANTS[i] + words[word];
+        a = d;
+        d = c;
+        c = b;
+        b = b + ((f << SHIFTS[i]) | (f >> (32 - SHIFTS[i])));
+    }
+
+    state[0] += a;
+    state[1] += b;
+    state[2] += c;
+    state[3] += d;
+}
+
+template<typename V, size_t LANES>
+__attribute__((always_inline)) inline void hash_lanes(
+    const unsigned char* const* blocks,
+    size_t block_size,
+    StrongSign* digests
+) {
+    V state[4];
+    for (size_t lane{0}; lane < LANES; lane++) {
+        set_lane<V, LANES>(&state[0], lane, 0x67452301);
+        set_lane<V, LANES>(&state[1], lane, 0xefcdab89);
+        set_lane<V, LANES>(&state[2], lane, 0x98badcfe);
+        set_lane<V, LANES>(&state[3], lane, 0x10325476);
+    }
+
+    const unsigned char* chunks[LANES];
+    size_t full_chunks{block_size / 64};
+
+    for (size_t chunk{0}; chunk < full_chunks; chunk++) {
+        for (size_t lane{0}; lane < LANES; lane++) {
+            chunks[lane] = blocks[lane] + 64 * chunk;
+        }
+
+        compress<V, LANES>(state, chunks);
+    }
+
+    // the rest of each block is padded with 0x80, zeros and the size in bits
+    size_t rest{block_size % 64};
+    size_t tail_size{rest < 56 ? (size_t)64 : (size_t)128};
+    uint64_t bits{(uint64_t)block_size * 8};
+
+    unsigned char tails[LANES][128];
+    for (size_t lane{0}; lane < LANES; lane++) {
+        memset(tails[lane], 0, sizeof(tails[lane]));
+        if (rest > 0) {
+            memcpy(tails[lane], blocks[lane] + 64 * full_chunks, rest);
+        }
+        tails[lane][rest] = 0x80;
+
+        for (size_t byte{0}; byte < 8; byte++) {
+            tails[lane][tail_size - 8 + byte] = (unsigned char)(bits >> (8 * byte));
+        }
+    }
+
+    for (size_t offset{0}; offset < tail_size; offset += 64) {
+        for (size_t lane{0}; lane < LANES; lane++) {
+            chunks[lane] = tails[lane] + offset;
+        }
+
+        compress<V, LANES>(state, chunks);
+    }
+
+    for (size_t lane{0}; lane < LANES; lane++) {
+        unsigned char digest[16];
+
+        for (size_t word{0}; word < 4; word++) {
+            auto value{get_lane<V, LANES>(&state[word], lane)};
+
+            for (size_t byte{0}; byte < 4; byte++) {
+                digest[4 * word + byte] = (unsigned char)(value >> (8 * byte));
+            }
+        }
+
+        digests[lane] = StrongSign::from_bytes(digest, sizeof(digest));
+    }
+}
+
+
+void hash_scalar(
+    const unsigned char* const* blocks,
+    size_t block_size,
+    StrongSign* digests
+) {
+    hash_lanes<uint32_t, 1>(blocks, block_size, digests);
+}
+
+#ifdef X86_KERNELS
+
+__attribute__((target("sse4.1")))
+void hash_sse41(
+    const unsigned char* const* blocks,
+    size_t block_size,
+    StrongSign* digests
+) {
+    hash_lanes<Lanes4, 4>(blocks, block_size, digests);
+}
+
+__attribute__((target("avx2")))
+void hash_avx2(
+    const unsigned char* const* blocks,
+    size_t block_size,
+    StrongSign* digests
+) {
+    hash_lanes<Lanes8, 8>(blocks, block_size, digests);
+}
+
+#endif
@@ -1,5 +1,6 @@
 #include "file_operator/operator_utils.h"
 #include "file_operator/filesystem.h"
+#include "file_operator/strong_hash.h"
 #include "file_operator/sync_utils.h"
 #include "database.h"
 #include "messages/basic.h"
@@ -10,8 +11,10 @@
 #include "type/sequence.h"
 #include "messages/sync.pb.h"
 
+#include <algorithm>
 #include <filesystem>
 #include <regex>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 
@@ -32,9 +35,41 @@ vector<filesystem::path> get_file_paths(const Config& config) {
         .to_vector();
 }
 
-vector<msg::File> get_files(vector<filesystem::path>&& paths) {
+fs::Hashing get_hashing(const Config& config) {
+    return fs::Hashing{
+        strong_hash::from_name(config.sync.strong_hash).value_or(HASH_MD5),
+        config.sync.tree_hash_threshold * 1024 * 1024, // convert from MiB to B
+        config.sync.hash_threads > 0 
+            ? config.sync.hash_threads 
+            : config.sync.number_of_workers
+    };
+}
+
+Chunking get_chunking(const Config& config) {
+    return 
+        config.sync.chunking == "content-defined"
+        ? CHUNKING_CONTENT_DEFINED
+        : CHUNKING_FIXED;
+}
+
+WeakHash get_weak_hash(const Config& config) {
     return 
-        Sequence(fs::get_files(move(paths)))
+        config.sync.weak_hash == "rabin-karp64"
+        ? WEAK_HASH_RABIN_KARP64
+        : WEAK_HASH_CHECKSUM32;
+}
+
+BlockSize get_refinement_floor(const Config& config) {
+    return (BlockSize)min(config.sync.refinement_floor, (size_t)MAX_BLOCK_SIZE);
+}
+
+vector<msg::File> get_files(
+    vector<filesystem::path>&& paths, 
+    const fs::Hashing& hashing,
+    const unordered_map<FileName, msg::File>& known
+) {
+    return 
+        Sequence(fs::get_files(move(paths), hashing, known))
         .peek([](Result<msg::File> file){
             file.peek(
                 [](auto){},
@@ -52,11 +87,12 @@ vector<msg::File> get_files(vector<filesystem::path>&& paths) {
         .to_vector();
 }
 
-void correct(const FileName& file) {
-    logger->info("Correcting " + colored(file));
+bool correct(const File& corrected_file) {
+    logger->info("Correcting " + colored(corrected_file.name()));
 
-    db::get_file(file)
-    .flat_map<bool>([](msg::File file){
+    return
+    db::get_file(corrected_file.name())
+    .flat_map<bool>([&](msg::File file){
         return
             fs::build_file(
                 get_data_spaces(
@@ -64,13 +100,22 @@ void correct(const FileName& file) {
                     file.name,
                     file.size
                 ),
-                file.name
+                file.name,
+                msg::File::from_proto(corrected_file)
             );
     })
-    .apply(
-        [](auto){},
+    .peek(
+        [&](bool built){
+            if (!built) {
+                logger->warn(
+                    "The corrected " + colored(corrected_file.name()) 
+                    + " doesn't match the peer's file"
+                );
+            }
+        },
         [&](Error err){ logger->error( err.msg ); }
-    );
+    )
+    .or_else(false);
 }
 
 void remove(const FileName& file) {
@@ -130,3 +175,16 @@ Corrections* get_corrections(
     );
 }
 
+vector<BlockPair*> swap_sides(vector<BlockPair*>&& pairs) {
+    for (auto pair: pairs) {
+        auto offset_client{pair->offset_client()};
+        auto size_client{pair->size_client()};
+
+        pair->set_offset_client(pair->offset_server());
+        pair->set_size_client(pair->size_server());
+        pair->set_offset_server(offset_client);
+        pair->set_size_server(size_client);
+    }
+
+    return move(pairs);
+}
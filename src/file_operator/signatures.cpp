@@ -1,65 +1,191 @@
 #include "file_operator/signatures.h"
+#include "file_operator/checksum_kernels.h"
+#include "file_operator/md5_kernels.h"
 
-#include <fmt/core.h>
-#include <openssl/md5.h>
 #include <algorithm>
+#include <array>
 #include <cmath>
+#include <cstdint>
+#include <cstring>
 #include <iterator>
-#include <tuple>
 
 using namespace std;
 
-string unsigned_char_to_hexadecimal_string(unsigned char*, unsigned int);
-tuple<unsigned int, unsigned int, WeakSign> calc_weak_signature(
-    const string&, 
-    BlockSize, 
-    Offset
-);
-tuple<unsigned int, unsigned int, WeakSign> increment_weak_signature(
-    const string&, 
+size_t read_into(istream&, char*, size_t);
+WeakSign64 roll64(const unsigned char*, BlockSize, size_t, WeakSign64, WeakSign64*);
+template<typename Signature, typename First, typename Roll>
+void stream_signatures(
+    istream&, 
+    size_t, 
     BlockSize, 
     Offset, 
-    unsigned int,
-    unsigned int
+    First, 
+    Roll, 
+    const function<void(Offset, const vector<Signature>&)>&
 );
 
-const size_t buffer_size{10000};
-const unsigned int signature_modulus{(unsigned int)(pow(2, 16))};
+const size_t buffer_size{1 << 16};
+
+// the masks for chunks of 8 KiB on average with normalisation level 2,
+// 15 bits before and 11 bits after the average chunk size
+const uint64_t small_chunk_mask{0x0003590703530000};
+const uint64_t large_chunk_mask{0x0000d90003530000};
+
+// the random values of the gear hash for each byte, 
+// generated by splitmix64, so every build cuts the same chunks
+constexpr array<uint64_t, 256> get_gear_table() {
+    array<uint64_t, 256> table{};
+    uint64_t state{0};
+
+    for (auto& value: table) {
+        state += 0x9e3779b97f4a7c15;
+        uint64_t z{state};
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+        value = z ^ (z >> 31);
+    }
+
+    return table;
+}
+
+constexpr array<uint64_t, 256> gear_table{get_gear_table()};
+
+// the odd base of the polynomial hash of the 64 bit weak signatures,
+// whose bytes are first mapped to the random values of the gear table
+const uint64_t polynomial_base{0x100000001b3};
+
 
+BlockSize get_block_size(size_t file_size) {
+    auto root{(size_t)ceil(sqrt((double)file_size))};
+
+    return clamp(
+        (BlockSize)min((root + 7) / 8 * 8, (size_t)MAX_BLOCK_SIZE), 
+        MIN_BLOCK_SIZE, 
+        MAX_BLOCK_SIZE
+    );
+}
+
+size_t get_strong_signature_length(size_t file_size, BlockSize block_size) {
+    // bits which are needed besides those of the weak signature,
+    // 10 plus twice the bits of the file size minus the bits of the block size
+    int bits{10};
+
+    for (auto size{file_size}; size >>= 1;) {
+        bits += 2;
+    }
+    for (auto size{block_size}; (size >>= 1) && bits > 0;) {
+        bits--;
+    }
+
+    return clamp((bits + 1 - 32 + 7) / 8, 2, (int)StrongSign::length);
+}
+
+
+StrongSign get_strong_signature(
+    const string& bytes, 
+    HashAlgorithm algorithm
+) {
+    auto hasher{strong_hash::make_hasher(algorithm)};
+    hasher->update(bytes.data(), bytes.size());
 
-StrongSign get_strong_signature(const string& bytes) {
-    unsigned char digest[MD5_DIGEST_LENGTH];
-    MD5((unsigned char*)bytes.c_str(), bytes.length(), digest);
-    return unsigned_char_to_hexadecimal_string(digest, MD5_DIGEST_LENGTH);
+    return hasher->finish();
 }
 
-StrongSign get_strong_signature(istream& bytes) {
-    MD5_CTX ctx{};
-    MD5_Init(&ctx);
+StrongSign get_strong_signature(
+    istream& bytes, 
+    HashAlgorithm algorithm
+) {
+    auto hasher{strong_hash::make_hasher(algorithm)};
 
-    char buffer[buffer_size]{};
-    streamsize read{};
+    vector<char> buffer(buffer_size);
+    size_t read{};
     do {
-        bytes.read(buffer, buffer_size);
-        read = bytes.gcount();
-        MD5_Update(&ctx, buffer, read);
+        read = read_into(bytes, buffer.data(), buffer_size);
+        hasher->update(buffer.data(), read);
     } while (read == buffer_size);
 
-    unsigned char digest[MD5_DIGEST_LENGTH];
-    MD5_Final(digest, &ctx);
+    return hasher->finish();
+}
+
+vector<StrongSign> get_strong_signatures(
+    const vector<const char*>& blocks,
+    BlockSize block_size,
+    HashAlgorithm algorithm
+) {
+    vector<StrongSign> signatures(blocks.size());
 
-    return unsigned_char_to_hexadecimal_string(digest, MD5_DIGEST_LENGTH);
+    if (algorithm == HASH_MD5) {
+        md5::hash_blocks(
+            (const unsigned char* const*)blocks.data(), 
+            blocks.size(), 
+            block_size, 
+            signatures.data()
+        );
+    }
+    else {
+        for (size_t i{0}; i < blocks.size(); i++) {
+            auto hasher{strong_hash::make_hasher(algorithm)};
+            hasher->update(blocks[i], block_size);
+            signatures[i] = hasher->finish();
+        }
+    }
+
+    return signatures;
 }
 
-string unsigned_char_to_hexadecimal_string(
-    unsigned char* arr, 
-    unsigned int n
+BlockSignatures get_block_signatures(
+    istream& bytes, 
+    HashAlgorithm algorithm,
+    BlockSize block_size
 ) {
-    string result{};
-    for (unsigned int i{0}; i < n; i++) {
-        result += fmt::format("{:02x}", (unsigned int)arr[i]);
+    BlockSignatures blocks{block_size, algorithm, {}, {}};
+
+    // whole blocks, at least one
+    vector<char> buffer(max(buffer_size / block_size, (size_t)1) * block_size);
+
+    size_t read{};
+    do {
+        read = read_into(bytes, buffer.data(), buffer.size());
+
+        vector<const char*> whole_blocks{};
+        for (size_t start{0}; start < read; start += block_size) {
+            auto size{min((size_t)block_size, read - start)};
+
+            blocks.weak.push_back(checksum::to_signature(
+                checksum::block_sums((const unsigned char*)buffer.data() + start, size)
+            ));
+
+            if (size == block_size) {
+                whole_blocks.push_back(buffer.data() + start);
+            }
+        }
+
+        auto strong{get_strong_signatures(whole_blocks, block_size, algorithm)};
+        blocks.strong.insert(blocks.strong.end(), strong.begin(), strong.end());
+
+        // only the last block might be smaller
+        if (auto rest{read % block_size}; rest > 0) {
+            blocks.strong.push_back(get_strong_signature(
+                string(buffer.data() + read - rest, rest), 
+                algorithm
+            ));
+        }
+    } while (read == buffer.size());
+
+    return blocks;
+}
+
+StrongSign get_tree_signature(
+    const vector<StrongSign>& chunk_signatures,
+    HashAlgorithm algorithm
+) {
+    auto hasher{strong_hash::make_hasher(algorithm)};
+
+    for (auto& signature: chunk_signatures) {
+        hasher->update((const char*)signature.bytes.data(), StrongSign::length);
     }
-    return result;
+
+    return hasher->finish();
 }
 
 
@@ -73,7 +199,9 @@ WeakSign get_weak_signature(
     data.seekg(offset, ios::beg);
     data.read(block.data(), block_size);
 
-    return get_weak_signature(string{block.begin(), block.end()}, block_size);
+    return checksum::to_signature(
+        checksum::block_sums((const unsigned char*)block.data(), block_size)
+    );
 }
 
 WeakSign get_weak_signature(
@@ -81,7 +209,11 @@ WeakSign get_weak_signature(
     BlockSize block_size, 
     Offset offset
 ) {
-    return get<2>(calc_weak_signature(data, block_size, offset));
+    return checksum::to_signature(
+        checksum::block_sums(
+            (const unsigned char*)data.data() + offset, 
+            block_size
+    ));
 }
 
 vector<WeakSign> get_weak_signatures(
@@ -92,30 +224,19 @@ vector<WeakSign> get_weak_signatures(
     size_t number_of_signatures{
         data.length() - block_size + 1 - initial_offset
     };
-    vector<WeakSign> signatures{};
-    signatures.reserve(number_of_signatures);
+    vector<WeakSign> signatures(number_of_signatures);
 
-    auto [r1, r2, signature]{
-        calc_weak_signature(
-            data, 
-            block_size, 
-            initial_offset
-    )};
-    signatures.push_back(signature);
-    
-    for (size_t i{0}; i < number_of_signatures - 1; i++) {
-        auto [new_r1, new_r2, signature]{
-            increment_weak_signature(
-                data, 
-                block_size,
-                initial_offset + i, 
-                r1,
-                r2
-        )};
-        signatures.push_back(signature);
-        r1 = new_r1;
-        r2 = new_r2;
-    }
+    auto bytes{(const unsigned char*)data.data() + initial_offset};
+    auto sums{checksum::block_sums(bytes, block_size)};
+    signatures[0] = checksum::to_signature(sums);
+
+    checksum::roll(
+        bytes, 
+        block_size, 
+        number_of_signatures - 1, 
+        sums, 
+        signatures.data() + 1
+    );
 
     return signatures;
 }
@@ -126,95 +247,323 @@ vector<WeakSign> get_weak_signatures(
     BlockSize block_size, 
     Offset initial_offset
 ) {
-    size_t number_of_signatures{
-        data_size - block_size + 1 - initial_offset
-    };
     vector<WeakSign> signatures{};
-    signatures.reserve(number_of_signatures);
-
-    vector<char> block(block_size + 1);
-    data.seekg(initial_offset, ios::beg);
-    data.read(block.data(), block_size);
+    if (data_size >= initial_offset + block_size) {
+        signatures.reserve(data_size - block_size + 1 - initial_offset);
+    }
 
-    auto [r1, r2, signature]{
-        calc_weak_signature(
-            string{block.begin(), block.end()},
-            block_size,
-            0
-    )};
-    signatures.push_back(signature);
-    
-    for (size_t i{0}; i < number_of_signatures - 1; i++) {
-        data.seekg(initial_offset + i, ios::beg);
-        data.read(block.data(), block_size + 1);
-
-        if (!(data.gcount() < 0) 
-            && 
-            ((size_t)data.gcount() == block_size + 1)
-        ) {
-            auto [new_r1, new_r2, signature]{
-                increment_weak_signature(
-                    string{block.begin(), block.end()},
-                    block_size,
-                    0,
-                    r1,
-                    r2
-            )};
-            signatures.push_back(signature);
-            r1 = new_r1;
-            r2 = new_r2;
+    stream_weak_signatures(
+        data, 
+        data_size, 
+        block_size, 
+        initial_offset,
+        [&](Offset, const vector<WeakSign>& batch){
+            signatures.insert(signatures.end(), batch.begin(), batch.end());
         }
-        else {
-            break;
-        }
-    }
+    );
 
     return signatures;
 }
 
-tuple<unsigned int, unsigned int, WeakSign> calc_weak_signature(
-    const string& data, 
+WeakSign64 get_weak_signature64(const unsigned char* data, BlockSize block_size) {
+    uint64_t hash{0};
+
+    for (size_t i{0}; i < block_size; i++) {
+        hash = hash * polynomial_base + gear_table[data[i]];
+    }
+
+    return hash;
+}
+
+WeakSign64 get_weak_signature64(
+    istream& data, 
     BlockSize block_size, 
     Offset offset
 ) {
-    unsigned int r1{0};
-    for_each(data.begin() + offset, data.begin() + offset + block_size, 
-        [&](unsigned char c){
-            r1 += c;
-            r1 %= signature_modulus;
-    });
+    vector<char> block(block_size);
 
-    unsigned int r2{0};
-    unsigned int i{0};
-    for_each(data.begin() + offset, data.begin() + offset + block_size, 
-        [&](unsigned char c){
-            r2 += (block_size - i) * c;
-            r2 %= signature_modulus;
-            i++;
-    });
+    data.seekg(offset, ios::beg);
+    data.read(block.data(), block_size);
 
-    return {r1, r2 , r1 + signature_modulus * r2};
+    return get_weak_signature64((const unsigned char*)block.data(), block_size);
 }
 
-tuple<unsigned int, unsigned int, WeakSign> increment_weak_signature(
+WeakSign64 get_weak_signature64(
     const string& data, 
     BlockSize block_size, 
-    Offset preceding_offset, 
-    unsigned int preceding_r1,
-    unsigned int preceding_r2
-) {
-    unsigned int r1 = (
-            preceding_r1 
-            - (unsigned char)data[preceding_offset] 
-            + (unsigned char)data[preceding_offset + block_size]
-        ) % signature_modulus
-    ;
-    unsigned int r2 = (
-            preceding_r2
-            - block_size * (unsigned char)data[preceding_offset]
-            + r1
-        ) % signature_modulus
-    ;
-
-    return {r1, r2, r1 + signature_modulus * r2};
+    Offset offset
+) {
+    return get_weak_signature64((const unsigned char*)data.data() + offset, block_size);
+}
+
+vector<WeakSign64> get_weak_signatures64(
+    const string& data, 
+    BlockSize block_size, 
+    Offset initial_offset
+) {
+    size_t number_of_signatures{
+        data.length() - block_size + 1 - initial_offset
+    };
+    vector<WeakSign64> signatures(number_of_signatures);
+
+    auto bytes{(const unsigned char*)data.data() + initial_offset};
+    signatures[0] = get_weak_signature64(bytes, block_size);
+
+    roll64(
+        bytes, 
+        block_size, 
+        number_of_signatures - 1, 
+        signatures[0], 
+        signatures.data() + 1
+    );
+
+    return signatures;
+}
+
+// rolls the hash of the block starting at data forward by count bytes
+// and writes the hash after each step to signatures
+WeakSign64 roll64(
+    const unsigned char* data,
+    BlockSize block_size,
+    size_t count,
+    WeakSign64 hash,
+    WeakSign64* signatures
+) {
+    // the factor of the byte which leaves the block, base^block_size
+    uint64_t leaving_factor{1};
+    for (size_t i{0}; i < block_size; i++) {
+        leaving_factor *= polynomial_base;
+    }
+
+    for (size_t i{0}; i < count; i++) {
+        hash = 
+            hash * polynomial_base 
+            + gear_table[data[i + block_size]] 
+            - gear_table[data[i]] * leaving_factor;
+        signatures[i] = hash;
+    }
+
+    return hash;
+}
+
+BlockSize get_chunk_size(const unsigned char* data, size_t size) {
+    if (size <= MIN_CHUNK_SIZE) {
+        return size;
+    }
+
+    size_t end{min(size, (size_t)MAX_CHUNK_SIZE)};
+    size_t normal_end{min(end, (size_t)AVERAGE_CHUNK_SIZE)};
+    uint64_t hash{0};
+    size_t i{MIN_CHUNK_SIZE};
+
+    for (; i < normal_end; i++) {
+        hash = (hash << 1) + gear_table[data[i]];
+
+        if (!(hash & small_chunk_mask)) {
+            return i;
+        }
+    }
+
+    for (; i < end; i++) {
+        hash = (hash << 1) + gear_table[data[i]];
+
+        if (!(hash & large_chunk_mask)) {
+            return i;
+        }
+    }
+
+    return end;
+}
+
+vector<Chunk> get_chunks(const string& data) {
+    vector<Chunk> chunks{};
+    auto bytes{(const unsigned char*)data.data()};
+
+    for (Offset offset{0}; offset < data.size();) {
+        auto size{get_chunk_size(bytes + offset, data.size() - offset)};
+
+        chunks.push_back(Chunk{
+            offset, 
+            size, 
+            checksum::to_signature(checksum::block_sums(bytes + offset, size))
+        });
+        offset += size;
+    }
+
+    return chunks;
+}
+
+vector<Chunk> get_chunks(istream& data, size_t data_size) {
+    vector<Chunk> chunks{};
+    chunks.reserve(data_size / AVERAGE_CHUNK_SIZE + 1);
+
+    vector<char> buffer(max(STREAM_BUFFER_SIZE, 2 * (size_t)MAX_CHUNK_SIZE));
+    auto bytes{(const unsigned char*)buffer.data()};
+    size_t remaining{data_size};
+    size_t filled{0};
+    Offset buffer_offset{0};
+
+    data.seekg(0, ios::beg);
+
+    while (true) {
+        size_t read{read_into(
+            data, 
+            buffer.data() + filled, 
+            min(buffer.size() - filled, remaining)
+        )};
+        remaining -= read;
+        filled += read;
+
+        bool last_fill{remaining == 0 || read == 0};
+
+        // a chunk is only cut when it can't be cut off by the end of the buffer
+        size_t position{0};
+        while (position < filled 
+               && 
+               (last_fill || filled - position >= MAX_CHUNK_SIZE)
+        ) {
+            auto size{get_chunk_size(bytes + position, filled - position)};
+
+            chunks.push_back(Chunk{
+                buffer_offset + position, 
+                size, 
+                checksum::to_signature(checksum::block_sums(bytes + position, size))
+            });
+            position += size;
+        }
+
+        if (last_fill) {
+            return chunks;
+        }
+
+        // the rest of the buffer is moved to its start
+        memmove(buffer.data(), buffer.data() + position, filled - position);
+        buffer_offset += position;
+        filled -= position;
+    }
+}
+
+void stream_weak_signatures(
+    istream& data, 
+    size_t data_size,
+    BlockSize block_size,
+    Offset initial_offset,
+    const function<void(Offset, const vector<WeakSign>&)>& consume
+) {
+    checksum::Sums sums{};
+
+    stream_signatures<WeakSign>(
+        data,
+        data_size,
+        block_size,
+        initial_offset,
+        [&](const unsigned char* bytes){
+            sums = checksum::block_sums(bytes, block_size);
+            return checksum::to_signature(sums);
+        },
+        [&](const unsigned char* bytes, size_t count, WeakSign* signatures){
+            sums = checksum::roll(bytes, block_size, count, sums, signatures);
+        },
+        consume
+    );
+}
+
+void stream_weak_signatures64(
+    istream& data, 
+    size_t data_size,
+    BlockSize block_size,
+    Offset initial_offset,
+    const function<void(Offset, const vector<WeakSign64>&)>& consume
+) {
+    WeakSign64 hash{0};
+
+    stream_signatures<WeakSign64>(
+        data,
+        data_size,
+        block_size,
+        initial_offset,
+        [&](const unsigned char* bytes){
+            hash = get_weak_signature64(bytes, block_size);
+            return hash;
+        },
+        [&](const unsigned char* bytes, size_t count, WeakSign64* signatures){
+            hash = roll64(bytes, block_size, count, hash, signatures);
+        },
+        consume
+    );
+}
+
+// reads the data once through a sliding buffer, first returns the signature
+// of the block at the given bytes and roll writes the signatures 
+// of the count blocks after it
+template<typename Signature, typename First, typename Roll>
+void stream_signatures(
+    istream& data, 
+    size_t data_size,
+    BlockSize block_size,
+    Offset initial_offset,
+    First first,
+    Roll roll,
+    const function<void(Offset, const vector<Signature>&)>& consume
+) {
+    if (block_size == 0 || data_size < initial_offset + block_size) {
+        return;
+    }
+
+    vector<char> buffer(max(STREAM_BUFFER_SIZE, 2 * (size_t)block_size));
+    auto bytes{(const unsigned char*)buffer.data()};
+    size_t remaining{data_size - initial_offset};
+
+    data.seekg(initial_offset, ios::beg);
+    size_t filled{read_into(data, buffer.data(), min(buffer.size(), remaining))};
+    remaining -= filled;
+
+    if (filled < block_size) {
+        return;
+    }
+
+    vector<Signature> signatures{};
+    signatures.reserve(buffer.size() - block_size + 1);
+
+    signatures.push_back(first(bytes));
+    Offset batch_offset{initial_offset};
+
+    while (true) {
+        // the block at the start of the buffer gets rolled to its end
+        size_t count{filled - block_size};
+        size_t rolled{signatures.size()};
+
+        signatures.resize(rolled + count);
+        roll(bytes, count, signatures.data() + rolled);
+
+        consume(batch_offset, signatures);
+        batch_offset += signatures.size();
+        signatures.clear();
+
+        if (remaining == 0) {
+            break;
+        }
+
+        // the current block is moved to the start of the buffer
+        // and the rest of the buffer is refilled
+        memmove(buffer.data(), buffer.data() + count, block_size);
+        size_t read{read_into(
+            data, 
+            buffer.data() + block_size, 
+            min(buffer.size() - block_size, remaining)
+        )};
+
+        if (read == 0) {
+            break;
+        }
+
+        remaining -= read;
+        filled = block_size + read;
+    }
+}
+
+size_t read_into(istream& data, char* buffer, size_t size) {
+    data.read(buffer, size);
+
+    return data.gcount() > 0 ? data.gcount() : 0;
 }
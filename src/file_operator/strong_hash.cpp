@@ -0,0 +1,186 @@
+#include "file_operator/strong_hash.h"
+
+#include <openssl/evp.h>
+#ifdef SYNC_XXHASH
+#include <xxhash.h>
+#endif
+#ifdef SYNC_BLAKE3
+#include <blake3.h>
+#endif
+#include <algorithm>
+#include <memory>
+#include <stdexcept>
+
+using namespace std;
+
+
+namespace strong_hash {
+    // MD5 over the EVP interface of OpenSSL,
+    // kept for compatibility with older versions
+    class Md5Hasher: public Hasher {
+      private:
+        unique_ptr<EVP_MD_CTX, decltype(&EVP_MD_CTX_free)> ctx{
+            EVP_MD_CTX_new(),
+            &EVP_MD_CTX_free
+        };
+
+      public:
+        Md5Hasher() {
+            if (!ctx || EVP_DigestInit_ex(ctx.get(), EVP_md5(), nullptr) != 1) {
+                throw runtime_error{"MD5 couldn't be initialised"};
+            }
+        }
+
+        void update(const char* data, size_t size) override {
+            EVP_DigestUpdate(ctx.get(), data, size);
+        }
+
+        StrongSign finish() override {
+            unsigned char digest[EVP_MAX_MD_SIZE];
+            unsigned int length{0};
+            EVP_DigestFinal_ex(ctx.get(), digest, &length);
+
+            return StrongSign::from_bytes(digest, length);
+        }
+    };
+
+#ifdef SYNC_XXHASH
+    // the 128 bit variant of XXH3, not cryptographic but by far the fastest
+    class Xxh3Hasher: public Hasher {
+      private:
+        unique_ptr<XXH3_state_t, decltype(&XXH3_freeState)> state{
+            XXH3_createState(),
+            &XXH3_freeState
+        };
+
+      public:
+        Xxh3Hasher() {
+            if (!state || XXH3_128bits_reset(state.get()) == XXH_ERROR) {
+                throw runtime_error{"XXH3 couldn't be initialised"};
+            }
+        }
+
+        void update(const char* data, size_t size) override {
+            XXH3_128bits_update(state.get(), data, size);
+        }
+
+        StrongSign finish() override {
+            XXH128_canonical_t digest;
+            XXH128_canonicalFromHash(&digest, XXH3_128bits_digest(state.get()));
+
+            return StrongSign::from_bytes(digest.digest, sizeof(digest.digest));
+        }
+    };
+#endif
+
+#ifdef SYNC_BLAKE3
+    // BLAKE3 with its output truncated to the length of a StrongSign
+    class Blake3Hasher: public Hasher {
+      private:
+        blake3_hasher hasher;
+
+      public:
+        Blake3Hasher() {
+            blake3_hasher_init(&hasher);
+        }
+
+        void update(const char* data, size_t size) override {
+            blake3_hasher_update(&hasher, data, size);
+        }
+
+        StrongSign finish() override {
+            unsigned char digest[StrongSign::length];
+            blake3_hasher_finalize(&hasher, digest, StrongSign::length);
+
+            return StrongSign::from_bytes(digest, StrongSign::length);
+        }
+    };
+#endif
+
+
+    unique_ptr<Hasher> make_hasher(HashAlgorithm algorithm) {
+        switch (algorithm) {
+            case HASH_MD5:
+                return make_unique<Md5Hasher>();
+#ifdef SYNC_XXHASH
+            case HASH_XXH3_128:
+                return make_unique<Xxh3Hasher>();
+#endif
+#ifdef SYNC_BLAKE3
+            case HASH_BLAKE3:
+                return make_unique<Blake3Hasher>();
+#endif
+            default:
+                throw invalid_argument{
+                    "Unsupported strong hash " + algorithm_name(algorithm)
+                };
+        }
+    }
+
+    vector<HashAlgorithm> supported_algorithms() {
+        return {
+            HASH_MD5,
+#ifdef SYNC_XXHASH
+            HASH_XXH3_128,
+#endif
+#ifdef SYNC_BLAKE3
+            HASH_BLAKE3,
+#endif
+        };
+    }
+
+    bool is_supported(HashAlgorithm algorithm) {
+        auto supported{supported_algorithms()};
+
+        return find(supported.begin(), supported.end(), algorithm) != supported.end();
+    }
+
+    string algorithm_name(HashAlgorithm algorithm) {
+        switch (algorithm) {
+            case HASH_MD5:      return "md5";
+            case HASH_XXH3_128: return "xxh3";
+            case HASH_BLAKE3:   return "blake3";
+            default:            return to_string((int)algorithm);
+        }
+    }
+
+    optional<HashAlgorithm> from_name(const string& name) {
+        for (auto algorithm: {HASH_MD5, HASH_XXH3_128, HASH_BLAKE3}) {
+            if (algorithm_name(algorithm) == name) {
+                return algorithm;
+            }
+        }
+
+        return nullopt;
+    }
+
+    vector<HashAlgorithm> offered_algorithms(HashAlgorithm preferred) {
+        vector<HashAlgorithm> offered{};
+
+        if (is_supported(preferred)) {
+            offered.push_back(preferred);
+        }
+
+        for (auto algorithm: supported_algorithms()) {
+            if (algorithm != preferred && algorithm != HASH_MD5) {
+                offered.push_back(algorithm);
+            }
+        }
+
+        if (preferred != HASH_MD5) {
+            offered.push_back(HASH_MD5);
+        }
+
+        return offered;
+    }
+
+    HashAlgorithm negotiate(const vector<HashAlgorithm>& offered) {
+        for (auto algorithm: offered) {
+            if (is_supported(algorithm)) {
+                return algorithm;
+            }
+        }
+
+        return HASH_MD5;
+    }
+}
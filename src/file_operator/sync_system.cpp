@@ -2,6 +2,7 @@
 #include "file_operator/filesystem.h"
 #include "file_operator/operator_utils.h"
 #include "file_operator/signatures.h"
+#include "file_operator/strong_hash.h"
 #include "file_operator/sync_utils.h"
 #include "config.h"
 #include "database.h"
@@ -18,37 +19,64 @@
 #include <algorithm>
 #include <chrono>
 #include <filesystem>
+#include <limits>
 #include <optional>
+#include <type_traits>
 #include <unordered_map>
+#include <unordered_set>
 #include <utility>
 #include <vector>
 
 using namespace std;
 
-
-SyncSystem::SyncSystem(const Config& config): config{config} {
-    auto file_paths{get_file_paths(config)};
-
-    logger->debug("Files to sync:\n" + vector_to_string(file_paths, "\n"));
-
+optional<StrongSign> get_block_signature(
+    const optional<BlockSignatures>&, 
+    const BlockPair&, 
+    size_t file_size
+);
+
+// the background thread hands this many files per hash thread at once 
+// to the parallel hashing
+const size_t HASH_QUEUE_BATCH_SIZE_PER_THREAD{16};
+
+
+SyncSystem::SyncSystem(
+    const Config& config
+): config{config},
+   hashing{get_hashing(config)},
+   hash_queue{
+       [this](const vector<filesystem::path>& files){ rehash(files); },
+       HASH_QUEUE_BATCH_SIZE_PER_THREAD * hashing.threads
+   }
+{
     if (!filesystem::exists(".sync")) {
         filesystem::create_directory(".sync");
     }
 
     auto tmp_file{filesystem::path{".sync"} / filesystem::path{"tmp"}};
 
-    if (!filesystem::exists(tmp_file)) {
-        // create directory for temporary builds
-        filesystem::create_directory(tmp_file);
-    }
+    // interrupted builds and transfers leave their temporary files behind
+    filesystem::remove_all(tmp_file);
+
+    // create directory for temporary builds
+    filesystem::create_directory(tmp_file);
 
     db::create(filesystem::exists(".sync/" + db::name));
-    db::insert_files(get_files(move(file_paths)));
+    reconcile();
 }
 
 
 void SyncSystem::check_filesystem() {
-    auto new_files{get_files(get_file_paths(config))};
+    reconcile();
+}
+
+// compares the files in the database with the filesystem by their status only,
+// new and changed files get hashed in the background
+void SyncSystem::reconcile() {
+    auto file_paths{get_file_paths(config)};
+
+    logger->debug("Files to sync:\n" + vector_to_string(file_paths, "\n"));
+
     auto old_files{db::get_files()};
 
     unordered_map<FileName, msg::File> old_files_by_name;
@@ -58,26 +86,122 @@ void SyncSystem::check_filesystem() {
         old_files_by_name.insert({file.name, move(file)});
     }
 
-    for (auto file: new_files) {
-        if (contains(old_files_by_name, file.name)) {
-            logger->debug(file.name + " still exists");
+    vector<filesystem::path> to_hash{};
+
+    for (auto& path: file_paths) {
+        auto old_file{old_files_by_name.find(path)};
 
-            old_files_by_name.erase(file.name);
-            db::update_file(move(file));
+        if (old_file == old_files_by_name.end()) {
+            logger->debug(path.string() + " is new");
+
+            to_hash.push_back(path);
         }
         else {
-            logger->debug(file.name + " is new");
+            auto stat{fs::get_stat(path)};
+
+            if (stat.is_ok() && fs::is_unchanged(old_file->second, stat.get_ok())) {
+                logger->debug(path.string() + " is unchanged");
+            }
+            else {
+                logger->debug(path.string() + " changed");
+
+                to_hash.push_back(path);
+            }
 
-            db::insert_file(move(file));
+            old_files_by_name.erase(old_file);
         }
     }
 
     for (auto [name, remaining_file]: old_files_by_name) {
-        logger->debug(name + " was removed");
+        if (!hash_queue.is_pending(name)) {
+            logger->debug(name + " was removed");
+
+            db::insert_removed(remaining_file);
+            db::delete_file(name);
+        }
+    }
+
+    if (to_hash.size() > 0) {
+        logger->info(
+            to_string(to_hash.size()) + " files get hashed in the background"
+        );
+
+        hash_queue.push(to_hash);
+    }
+}
+
+void SyncSystem::rehash(const vector<filesystem::path>& files) {
+    try {
+        for (auto& file: fs::get_files(files, hashing)) {
+            file.apply(
+                [](msg::File file){ db::insert_file(move(file)); },
+                [](Error err){ logger->error(err.msg); }
+            );
+        }
+    }
+    catch (const exception& err) {
+        logger->error("Hashing " + vector_to_string(files) + ": " + err.what());
+    }
+}
+
+// returns the file from the database once it is verified,
+// a file which still has to be hashed gets hashed first
+Result<msg::File> SyncSystem::get_verified_file(const FileName& name) {
+    hash_queue.prioritise(name);
+
+    return db::get_file(name);
+}
+
+
+// returns the stored block signatures of the file, 
+// if the file didn't change since they were computed
+optional<BlockSignatures> SyncSystem::get_stored_block_signatures(
+    const FileName& name
+) {
+    auto signatures{db::get_block_signatures(name)};
+    auto stat{fs::get_stat(name)};
+
+    if (signatures.is_err() || stat.is_err()) {
+        return nullopt;
+    }
+
+    auto stored{signatures.get_ok()};
+    auto current{stat.get_ok()};
+
+    if (stored.mtime_ns == 0 /* wasn't trusted when hashed */
+        ||
+        stored.size != current.size
+        ||
+        stored.mtime_ns != current.mtime_ns
+        ||
+        stored.inode != current.inode
+    ) {
+        return nullopt;
+    }
+
+    return stored.to_signatures();
+}
 
-        db::insert_removed(remaining_file);
-        db::delete_file(name);
+// returns the block signatures of the file, they get computed 
+// only if no stored ones fit and are stored for the next sync then
+Result<BlockSignatures> SyncSystem::get_block_signatures(
+    const msg::File& file,
+    HashAlgorithm algorithm,
+    BlockSize block_size
+) {
+    auto stored{get_stored_block_signatures(file.name)};
+
+    if (stored && stored->block_size == block_size && stored->algorithm == algorithm) {
+        return Result<BlockSignatures>::ok(stored.value());
     }
+
+    return
+        fs::get_block_signatures(file.name, algorithm, block_size)
+        .map<BlockSignatures>([&](BlockSignatures signatures){
+            db::insert_block_signatures(msg::BlockSignatures{file, signatures});
+
+            return signatures;
+        });
 }
 
 
@@ -88,7 +212,12 @@ Message SyncSystem::get_show_files() {
             query_options(
                 config.sync.sync_hidden_files,
                 db::get_last_checked()
-    )));
+            ),
+            strong_hash::offered_algorithms(hashing.algorithm),
+            get_chunking(config),
+            config.sync.range_threshold > 0,
+            get_weak_hash(config)
+    ));
 
     db::insert_or_update_last_checked(
         get_timestamp(
@@ -110,6 +239,33 @@ Message SyncSystem::get_file_list(const ShowFiles& request) {
         : nullopt
     };
 
+    vector<HashAlgorithm> offered_algorithms{};
+    for (auto algorithm: request.hash_algorithms()) {
+        offered_algorithms.push_back((HashAlgorithm)algorithm);
+    }
+
+    auto session_algorithm{strong_hash::negotiate(offered_algorithms)};
+    logger->debug(
+        "Using " + strong_hash::algorithm_name(session_algorithm) 
+        + " for strong signatures with client"
+    );
+
+    // both kinds of chunking are supported, the client chooses
+    Chunking session_chunking{
+        request.chunking() == CHUNKING_CONTENT_DEFINED
+        ? CHUNKING_CONTENT_DEFINED
+        : CHUNKING_FIXED
+    };
+
+    // both weak hashes are supported as well
+    WeakHash session_weak_hash{
+        request.weak_hash() == WEAK_HASH_RABIN_KARP64
+        ? WEAK_HASH_RABIN_KARP64
+        : WEAK_HASH_CHECKSUM32
+    };
+
+    // files which aren't hashed yet are not listed, so the client doesn't 
+    // have to wait for them, it asks for those it knows with a sync request
     auto listed_files{
         Sequence(db::get_files())
         .where([&](const msg::File& file){
@@ -121,7 +277,8 @@ Message SyncSystem::get_file_list(const ShowFiles& request) {
                 !min_timestamp.has_value() 
                     ||
                 min_timestamp.value() <= file.timestamp
-            );
+            ) && 
+                !hash_queue.is_pending(file.name);
         })
         .map<File*>([](msg::File file){
             return file.to_proto();
@@ -131,8 +288,14 @@ Message SyncSystem::get_file_list(const ShowFiles& request) {
 
     Message response{};
     response.set_allocated_file_list(
-        file_list(listed_files, query_options(list_hidden, min_timestamp))
-    );
+        file_list(
+            listed_files, 
+            query_options(list_hidden, min_timestamp),
+            session_algorithm,
+            session_chunking,
+            request.range_signatures(), // supported, the client decides when
+            session_weak_hash
+    ));
 
     return response;
 }
@@ -140,24 +303,27 @@ Message SyncSystem::get_file_list(const ShowFiles& request) {
 
 vector<Message> SyncSystem::get_sync_requests(const FileList& server_list) {
     vector<Message> msgs{};
-    vector<FileName> checked_files{};
+    unordered_set<FileName> checked_files{};
+
+    // files which aren't hashed yet get hashed in one batch, instead of
+    // one by one when they are looked up
+    vector<FileName> server_files{};
+    for (auto& server_file: server_list.files()) {
+        server_files.push_back(server_file.name());
+    }
+    hash_queue.prioritise(server_files);
 
     for (auto& server_file: server_list.files()) {
-        if (auto file_result{db::get_file(server_file.name())}) {
+        if (auto file_result{get_verified_file(server_file.name())}) {
             // locally there is a file with the same name/relative path
 
             auto local_file{file_result.get_ok()};
-            checked_files.push_back(local_file.name);
+            checked_files.insert(local_file.name);
 
-            if (!(local_file.timestamp == server_file.timestamp() 
-                    && 
-                  local_file.size == server_file.size()
-                    &&
-                  local_file.signature == server_file.signature()
-            )) {
+            if (!is_equal(local_file, server_file)) {
                 // local file and server file are not equal
                 
-                start_sync(move(local_file))
+                start_sync(move(local_file), server_list)
                 .apply(
                     [&](Message msg){ msgs.push_back(msg); },
                     [&](Error err){ logger->error(err.msg); }
@@ -193,8 +359,17 @@ vector<Message> SyncSystem::get_sync_requests(const FileList& server_list) {
         }
     }
 
+    // files which aren't hashed yet get hashed now, so they are offered too
+    vector<FileName> pending{};
+    for (auto& name: hash_queue.get_pending()) {
+        if (!checked_files.count(name)) {
+            pending.push_back(name);
+        }
+    }
+    hash_queue.prioritise(pending);
+
     for (auto file: db::get_files()) {
-        if (!contains(checked_files, file.name)
+        if (!checked_files.count(file.name)
             && (
                 server_list.options().include_hidden() 
                 || 
@@ -207,7 +382,10 @@ vector<Message> SyncSystem::get_sync_requests(const FileList& server_list) {
         ) {
             // server doesn't seem to know of this file
 
-            start_sync(move(file))
+            get_verified_file(file.name)
+            .flat_map<Message>([&](msg::File file){
+                return start_sync(move(file), server_list);
+            })
             .apply(
                 [&](Message msg){ msgs.push_back(msg); },
                 [&](Error err){ logger->error(err.msg); }
@@ -218,17 +396,185 @@ vector<Message> SyncSystem::get_sync_requests(const FileList& server_list) {
     return msgs;
 }
 
-Result<Message> SyncSystem::start_sync(msg::File file) {
+bool SyncSystem::is_equal(const msg::File& local_file, const File& server_file) {
+    if (local_file.timestamp != server_file.timestamp() 
+            || 
+        local_file.size != server_file.size()
+    ) {
+        return false;
+    }
+
+    auto server_signature{StrongSign::from_bytes(server_file.signature())};
+
+    if (local_file.signature_algorithm == server_file.signature_algorithm()
+            &&
+        local_file.signature_chunk_size == server_file.signature_chunk_size()
+    ) {
+        return local_file.signature == server_signature;
+    }
+    else {
+        // the signatures were computed differently, so the local one 
+        // has to be computed again the same way as the one of the server
+        return
+            fs::get_file_signature(
+                local_file.name, 
+                server_file.signature_algorithm(),
+                server_file.signature_chunk_size(),
+                hashing.threads
+            )
+            .map<bool>([&](StrongSign signature){
+                return signature == server_signature;
+            })
+            .or_else(false);
+    }
+}
+
+Result<Message> SyncSystem::start_sync(
+    msg::File file, 
+    const FileList& session
+) {
     logger->info("Starting syncing process for " + colored(file));
 
     return
-        fs::get_request_signatures(file.name)
-        .map<Message>([&](vector<WeakSign> signatures){
+        start_matching(move(file), session)
+        .map<Message>([&](Message msg){
+            if (msg.has_sync_request()) {
+                msg.mutable_sync_request()->set_refinement_floor(
+                    get_refinement_floor(config)
+                );
+            }
+
+            return msg;
+        });
+}
+
+// returns the sync request or the first range signatures of the file
+Result<Message> SyncSystem::start_matching(
+    msg::File file, 
+    const FileList& session
+) {
+    auto algorithm{session.hash_algorithm()};
+
+    if (session.chunking() == CHUNKING_CONTENT_DEFINED) {
+        return
+            fs::get_chunks(file.name)
+            .map<Message>([&](vector<Chunk> chunks){
+                Message msg{};
+                msg.set_allocated_sync_request(
+                    sync_request(file.to_proto(), chunks, algorithm) 
+                );
+                
+                return msg;
+            });
+    }
+
+    auto block_size{get_block_size(file.size)};
+
+    if (session.range_signatures() 
+        && 
+        config.sync.range_threshold > 0
+        &&
+        file.size >= config.sync.range_threshold * 1024 * 1024 // convert from MiB to B
+    ) {
+        // the first round compares the whole file by a few large ranges
+        auto range_size{get_top_range_size(file.size, block_size)};
+
+        vector<Offset> offsets{};
+        for (Offset offset{0}; offset < file.size; offset += range_size) {
+            offsets.push_back(offset);
+        }
+
+        return get_range_signatures(
+            move(file), 
+            algorithm, 
+            block_size, 
+            range_size, 
+            offsets
+        );
+    }
+
+    return
+        session.weak_hash() == WEAK_HASH_RABIN_KARP64
+        ? request_matching<WeakSign64>(file, algorithm, block_size)
+        : request_matching<WeakSign>(file, algorithm, block_size);
+}
+
+// returns the sync request with the weak signatures of the consecutive blocks, 
+// with one round trip also with their truncated strong signatures, so the 
+// server confirms matching blocks right away and corrects the rest in its response,
+// the block signatures get stored by the first sync of the file, so the
+// strong signatures which the server requests don't need to be read either
+template<typename Signature>
+Result<Message> SyncSystem::request_matching(
+    msg::File file,
+    HashAlgorithm algorithm,
+    BlockSize block_size
+) {
+    return
+    get_block_signatures(file, algorithm, block_size)
+    .flat_map<Message>([&](BlockSignatures signatures){
+        // only the 32 bit weak signatures are part of the block signatures
+        Result<vector<Signature>> weak_signatures{[&](){
+            if constexpr (is_same_v<Signature, WeakSign64>) {
+                return fs::get_request_signatures64(file.name, block_size);
+            }
+            else {
+                return Result<vector<WeakSign>>::ok(signatures.weak);
+            }
+        }()};
+
+        return
+        weak_signatures
+        .template map<Message>([&](vector<Signature> weak_signatures){
+            auto request{
+                sync_request(file.to_proto(), weak_signatures, block_size, algorithm)
+            };
+
+            if (config.sync.one_round_trip) {
+                set_strong_signatures(
+                    request, 
+                    signatures.strong, 
+                    get_strong_signature_length(file.size, block_size)
+                );
+            }
+
             Message msg{};
-            msg.set_allocated_sync_request(
-                sync_request(file.to_proto(), signatures) 
-            );
-            
+            msg.set_allocated_sync_request(request);
+
+            return msg;
+        });
+    });
+}
+
+Result<Message> SyncSystem::get_range_signatures(
+    msg::File file,
+    HashAlgorithm algorithm,
+    BlockSize block_size,
+    size_t range_size,
+    const vector<Offset>& offsets
+) {
+    auto ranges{get_ranges(offsets, range_size, file.size)};
+
+    return
+        fs::get_range_signatures(file.name, ranges, algorithm, hashing.threads)
+        .map<Message>([&](vector<StrongSign> signatures){
+            vector<pair<Offset, StrongSign>> signatures_by_offset{};
+            signatures_by_offset.reserve(ranges.size());
+
+            for (size_t i{0}; i < ranges.size(); i++) {
+                signatures_by_offset.push_back({ranges[i].first, signatures[i]});
+            }
+
+            Message msg{};
+            msg.set_allocated_range_signatures(
+                range_signatures(
+                    file.to_proto(), 
+                    algorithm, 
+                    block_size, 
+                    range_size, 
+                    signatures_by_offset
+            ));
+
             return msg;
         });
 }
@@ -239,7 +585,9 @@ Message SyncSystem::notify_already_removed(const File& file) {
     );
 
     Message msg{};
-    msg.set_allocated_sync_request(sync_request(new File(file), {}, true));
+    msg.set_allocated_sync_request(
+        sync_request(new File(file), {}, BLOCK_SIZE, hashing.algorithm, true)
+    );
 
     return msg;
 }
@@ -258,13 +606,13 @@ Message SyncSystem::get_sync_response(const SyncRequest& request) {
     auto client_file{request.file()};
 
     if (request.removed()) {
-        if (auto file{db::get_file(client_file.name())}) {
+        if (auto file{get_verified_file(client_file.name())}) {
             remove(file.get_ok().name);
         }
 
         return received();
     }
-    else if (auto file{db::get_file(client_file.name())}) {
+    else if (auto file{get_verified_file(client_file.name())}) {
         return sync(request, file.get_ok()).or_else(received());
     }
     else if (auto removed{db::get_removed(client_file.name())}) {
@@ -280,107 +628,23 @@ Result<Message> SyncSystem::sync(
     msg::File local_file
 ) {
     auto client_file{request.file()};
-    BlockSize last_block_size{(BlockSize)(client_file.size() % BLOCK_SIZE)};
-    bool last_block_smaller{last_block_size < BLOCK_SIZE};
 
     logger->info("Syncing " + colored(local_file) + " with client");
 
-    int full_signatures_count{
-        request.weak_signatures_size() + (
-            last_block_smaller
-            ? -1 // the last signature in the request is not from a full block
-            :  0 
-    )};
-
-    unordered_map<unsigned int, vector<Offset>> signature_offsets{};
-    for (int i{0}; i <  full_signatures_count; i++) {
-        auto signature{request.weak_signatures().at(i)};
-
-        if (contains(signature_offsets, signature)) {
-            signature_offsets[signature].push_back(i * BLOCK_SIZE);
-        }
-        else {
-            signature_offsets.insert({signature, {i * BLOCK_SIZE}});
-        }
-    }
+    // matches confirmed by strong signatures of the request need no addendum
+    bool confirmed{request.strong_signature_length() > 0};
 
     return
-    fs::get_weak_signatures(local_file.name)
-    .flat_map<vector<BlockPair*>>([&](vector<WeakSign> signatures){
-        vector<pair<Offset /* client */, Offset /* local */>> matching_offsets{};
-        Offset client_offset{0};
-        for (unsigned long i{0}; i < signatures.size();) {
-
-            if (contains(signature_offsets, signatures[i])) {
-                while (
-                    signature_offsets[signatures[i]].size() > 0
-                        &&
-                    client_offset > signature_offsets[signatures[i]][0]
-                ) {
-                    signature_offsets[signatures[i]].erase(
-                        signature_offsets[signatures[i]].begin()
-                    );
-                }
-
-                if (signature_offsets[signatures[i]].size() > 0) {
-                    client_offset = signature_offsets[signatures[i]][0];
-                    signature_offsets[signatures[i]].erase(
-                        signature_offsets[signatures[i]].begin()
-                    );
-
-                    matching_offsets.push_back({client_offset, i});
-                    i += BLOCK_SIZE;
-                }
-                else {
-                    i++;
-                }
-            }
-            else {
-                i++;
-            }
-        }
-
-        vector<BlockPair*> matching_blocks{};
-        matching_blocks.reserve(matching_offsets.size());
-
-        for (auto [client_offset, local_offset]: matching_offsets) {
-            matching_blocks.push_back(
-                block_pair(client_file.name(), client_offset, local_offset)
-            );
-        }
-
-        if (last_block_smaller && request.weak_signatures_size() >= 1) {
-            auto last_offset{local_file.size - last_block_size};
-
-            return
-                fs::get_weak_signature(
-                    local_file.name, 
-                    last_block_size, 
-                    last_offset
-                )
-                .map<vector<BlockPair*>>([&](WeakSign last_signature){
-                    if (last_signature 
-                        == 
-                        request.weak_signatures()
-                            .at(request.weak_signatures_size() - 1)
-                    ) {
-                        auto last_client_offset{client_file.size() - last_block_size};
-
-                        matching_blocks.push_back(
-                            block_pair(
-                                client_file.name(), 
-                                last_client_offset, 
-                                last_offset,
-                                last_block_size
-                        ));
-                    }
-
-                    return matching_blocks;
-                });
-        }
-        else {
-            return Result<vector<BlockPair*>>::ok(matching_blocks);
-        }
+    (
+        request.chunking() == CHUNKING_CONTENT_DEFINED
+        ? match_chunks(request, local_file)
+        : match_blocks(request, local_file)
+    )
+    .flat_map<vector<BlockPair*>>([&](vector<BlockPair*> matching){
+        return 
+            confirmed
+            ? confirm_matches(request, local_file, move(matching))
+            : Result<vector<BlockPair*>>::ok(move(matching));
     })
     .map<pair<vector<BlockPair*> /* matching */, vector<BlockPair*> /* not matching */>>(
     [&](vector<BlockPair*> matching){
@@ -396,8 +660,46 @@ Result<Message> SyncSystem::sync(
     })
     .map<Message>([&](pair<vector<BlockPair*>, vector<BlockPair*>> pairs){
         auto [matching, non_matching]{pairs};
+
+        if (request.refinement_floor() > 0) {
+            if (confirmed || matching.size() == 0) {
+                for (auto pair: matching) {
+                    delete pair;
+                }
+
+                return refine_gaps(
+                    client_file, 
+                    local_file, 
+                    move(non_matching), 
+                    request.hash_algorithm(), 
+                    request.chunking() == CHUNKING_CONTENT_DEFINED
+                        ? AVERAGE_CHUNK_SIZE
+                        : request.block_size() > 0 ? request.block_size() : BLOCK_SIZE,
+                    request.refinement_floor()
+                );
+            }
+
+            // the gaps get refined once the matches are verified
+            for (auto pair: non_matching) {
+                delete pair;
+            }
+            non_matching.clear();
+        }
+
         Message msg{};
 
+        bool final{confirmed || matching.size() == 0};
+        optional<BlockPairs*> signature_requests{};
+
+        if (confirmed) {
+            for (auto pair: matching) {
+                delete pair;
+            }
+        }
+        else {
+            signature_requests = block_pairs(matching);
+        }
+
         if (client_file.timestamp() > local_file.timestamp) {
             // client file is newer
 
@@ -405,9 +707,11 @@ Result<Message> SyncSystem::sync(
                 client_file,
                 partial_match(
                     local_file.to_proto(),
-                    block_pairs(move(matching))
+                    signature_requests,
+                    nullopt,
+                    request.hash_algorithm()
                 ),
-                block_pairs(non_matching)
+                block_pairs(swap_sides(move(non_matching)))
             ));
         }
         else {
@@ -417,12 +721,13 @@ Result<Message> SyncSystem::sync(
                 client_file,
                 partial_match(
                     local_file.to_proto(),
-                    block_pairs(matching),
+                    signature_requests,
                     get_corrections(
                         move(non_matching), 
                         client_file.name(),
-                        matching.size() == 0
-                    )
+                        final
+                    ),
+                    request.hash_algorithm()
                 ),
                 nullopt
             ));
@@ -432,59 +737,772 @@ Result<Message> SyncSystem::sync(
     });
 }
 
-Message SyncSystem::respond_already_removed(const File& requested_file) {
-    logger->info(
-        "Requested " + 
-        colored(msg::File::from_proto(requested_file)) + 
-        " has already been removed"
-    );
-
-    Message msg{};
-    msg.set_allocated_sync_response(
-        sync_response(requested_file, nullopt, nullopt, false, true)
-    );
+// matches the client's blocks of fixed size at all offsets of the local file
+Result<vector<BlockPair*>> SyncSystem::match_blocks(
+    const SyncRequest& request, 
+    const msg::File& local_file
+) {
+    if (request.weak_hash() == WEAK_HASH_RABIN_KARP64) {
+        return match_blocks(
+            request,
+            local_file,
+            vector<WeakSign64>(
+                request.weak_signatures64().begin(),
+                request.weak_signatures64().end()
+        ));
+    }
 
-    return msg;
+    return match_blocks(
+        request,
+        local_file,
+        vector<WeakSign>(
+            request.weak_signatures().begin(),
+            request.weak_signatures().end()
+    ));
 }
 
-Message SyncSystem::respond_requesting(const File& requested_file) {
-    logger->info(
-        "Getting " + 
-        colored(msg::File::from_proto(requested_file)) + 
-        " from client"
-    );
-
-    Message msg{};
-    msg.set_allocated_sync_response(
-        sync_response(requested_file, nullopt, nullopt, true)
-    );
-
-    return msg;
-}
+template<typename Signature>
+Result<vector<BlockPair*>> SyncSystem::match_blocks(
+    const SyncRequest& request, 
+    const msg::File& local_file,
+    vector<Signature>&& client_signatures
+) {
+    auto client_file{request.file()};
+    BlockSize block_size{request.block_size() > 0 ? request.block_size() : BLOCK_SIZE};
 
+    if (block_size > MAX_BLOCK_SIZE) {
+        return Result<vector<BlockPair*>>::err(
+            Error{"Block size of " + client_file.name() + " is too large"}
+        );
+    }
 
-vector<Message> SyncSystem::handle_sync_response(const SyncResponse& response) {
-    auto file{response.requested_file()};
+    BlockSize last_block_size{(BlockSize)(client_file.size() % block_size)};
+    bool last_block_smaller{last_block_size < block_size};
 
-    if (response.requsting_file()) {
-        return {get_file(response.requested_file())};
+    optional<Signature> last_client_signature{};
+    if (last_block_smaller && client_signatures.size() >= 1) {
+        // the last signature in the request is not from a full block
+        last_client_signature = client_signatures.back();
+        client_signatures.pop_back();
     }
-    else if (response.removed()) {
-        remove(file.name());
 
-        return {received()};
-    }
-    else if (response.has_partial_match()) {
-        return sync(response);
-    }
-    else {
-        return {received()};
-    }
-}
+    BasicBlockMatcher<Signature> matcher{client_signatures, block_size};
+    auto consume{[&](Offset offset, const vector<Signature>& signatures){
+        matcher.consume(offset, signatures);
+    }};
 
-vector<Message> SyncSystem::sync(const SyncResponse& response) {
-    auto file{response.requested_file()};
-    auto match{response.partial_match()};
+    Result<bool> streamed{[&](){
+        if constexpr (is_same_v<Signature, WeakSign64>) {
+            return fs::stream_weak_signatures64(local_file.name, block_size, consume);
+        }
+        else {
+            return fs::stream_weak_signatures(local_file.name, block_size, consume);
+        }
+    }()};
+
+    return
+    streamed
+    .flat_map<vector<BlockPair*>>([&](bool){
+        auto& matching_offsets{matcher.get_matches()};
+
+        if (matcher.get_rejected_count() > 0) {
+            logger->debug(
+                to_string(matcher.get_rejected_count()) 
+                + " blocks of the client only shared the index key with blocks of " 
+                + colored(local_file)
+            );
+        }
+
+        vector<BlockPair*> matching_blocks{};
+        matching_blocks.reserve(matching_offsets.size());
+
+        for (auto [client_offset, local_offset]: matching_offsets) {
+            matching_blocks.push_back(
+                block_pair(client_file.name(), client_offset, local_offset, block_size)
+            );
+        }
+
+        if (last_client_signature) {
+            auto last_offset{local_file.size - last_block_size};
+
+            Result<Signature> last_signature{[&](){
+                if constexpr (is_same_v<Signature, WeakSign64>) {
+                    return fs::get_weak_signature64(local_file.name, last_block_size, last_offset);
+                }
+                else {
+                    return fs::get_weak_signature(local_file.name, last_block_size, last_offset);
+                }
+            }()};
+
+            return
+                last_signature
+                .template map<vector<BlockPair*>>([&](Signature last_signature){
+                    if (last_signature == last_client_signature.value()) {
+                        auto last_client_offset{client_file.size() - last_block_size};
+
+                        matching_blocks.push_back(
+                            block_pair(
+                                client_file.name(), 
+                                last_client_offset, 
+                                last_offset,
+                                last_block_size
+                        ));
+                    }
+
+                    return matching_blocks;
+                });
+        }
+        else {
+            return Result<vector<BlockPair*>>::ok(matching_blocks);
+        }
+    });
+}
+
+// matches the client's content defined chunks with those of the local file
+Result<vector<BlockPair*>> SyncSystem::match_chunks(
+    const SyncRequest& request, 
+    const msg::File& local_file
+) {
+    auto client_file{request.file()};
+
+    if (request.chunk_sizes_size() != request.weak_signatures_size()) {
+        return Result<vector<BlockPair*>>::err(
+            Error{"Chunks of " + client_file.name() + " without sizes"}
+        );
+    }
+
+    vector<Chunk> client_chunks{};
+    client_chunks.reserve(request.chunk_sizes_size());
+
+    Offset offset{0};
+    for (int i{0}; i < request.chunk_sizes_size(); i++) {
+        client_chunks.push_back(Chunk{
+            offset, 
+            request.chunk_sizes(i), 
+            request.weak_signatures(i)
+        });
+        offset += request.chunk_sizes(i);
+    }
+
+    return
+        fs::get_chunks(local_file.name)
+        .map<vector<BlockPair*>>([&](vector<Chunk> local_chunks){
+            vector<BlockPair*> matching_blocks{};
+
+            for (auto [client_chunk, local_chunk]: 
+                ::match_chunks(client_chunks, local_chunks)
+            ) {
+                matching_blocks.push_back(
+                    block_pair(
+                        client_file.name(), 
+                        client_chunk.offset, 
+                        local_chunk.offset, 
+                        local_chunk.size
+                ));
+            }
+
+            return matching_blocks;
+        });
+}
+
+// keeps the matching blocks whose strong signature is the truncated one 
+// of the request, the others are deleted
+Result<vector<BlockPair*>> SyncSystem::confirm_matches(
+    const SyncRequest& request,
+    const msg::File& local_file,
+    vector<BlockPair*>&& matching
+) {
+    auto client_file{request.file()};
+    BlockSize block_size{request.block_size() > 0 ? request.block_size() : BLOCK_SIZE};
+    size_t length{request.strong_signature_length()};
+    size_t block_count{(size_t)(
+        request.weak_hash() == WEAK_HASH_RABIN_KARP64
+        ? request.weak_signatures64_size()
+        : request.weak_signatures_size()
+    )};
+
+    if (request.chunking() == CHUNKING_CONTENT_DEFINED
+        ||
+        length > StrongSign::length
+        ||
+        request.strong_signatures().size() != length * block_count
+    ) {
+        for (auto pair: matching) {
+            delete pair;
+        }
+
+        return Result<vector<BlockPair*>>::err(
+            Error{"Invalid strong signatures of " + client_file.name()}
+        );
+    }
+
+    vector<pair<Offset, size_t>> local_blocks{};
+    local_blocks.reserve(matching.size());
+
+    for (auto pair: matching) {
+        local_blocks.push_back({pair->offset_server(), pair->size_server()});
+    }
+
+    return
+    fs::get_range_signatures(
+        local_file.name, 
+        local_blocks, 
+        request.hash_algorithm(),
+        hashing.threads
+    )
+    .map<vector<BlockPair*>>([&](vector<StrongSign> local_signatures){
+        vector<BlockPair*> confirmed{};
+        confirmed.reserve(matching.size());
+
+        for (size_t i{0}; i < matching.size(); i++) {
+            auto client_signature{
+                request.strong_signatures().data() 
+                + 
+                matching[i]->offset_client() / block_size * length
+            };
+
+            if (equal(
+                    local_signatures[i].bytes.begin(), 
+                    local_signatures[i].bytes.begin() + length, 
+                    (const unsigned char*)client_signature
+            )) {
+                confirmed.push_back(matching[i]);
+            }
+            else {
+                delete matching[i];
+            }
+        }
+
+        logger->debug(
+            to_string(confirmed.size()) + " of " + to_string(matching.size()) 
+            + " matching blocks of " + colored(local_file) + " confirmed"
+        );
+
+        return confirmed;
+    })
+    .peek(
+        [](auto){},
+        [&](auto){
+            for (auto pair: matching) {
+                delete pair;
+            }
+        }
+    );
+}
+
+Message SyncSystem::respond_already_removed(const File& requested_file) {
+    logger->info(
+        "Requested " + 
+        colored(msg::File::from_proto(requested_file)) + 
+        " has already been removed"
+    );
+
+    Message msg{};
+    msg.set_allocated_sync_response(
+        sync_response(requested_file, nullopt, nullopt, false, true)
+    );
+
+    return msg;
+}
+
+Message SyncSystem::respond_requesting(const File& requested_file) {
+    logger->info(
+        "Getting " + 
+        colored(msg::File::from_proto(requested_file)) + 
+        " from client"
+    );
+
+    Message msg{};
+    msg.set_allocated_sync_response(
+        sync_response(requested_file, nullopt, nullopt, true)
+    );
+
+    return msg;
+}
+
+
+Message SyncSystem::get_sync_response(const RangeSignatures& signatures) {
+    auto client_file{signatures.file()};
+
+    if (auto file{get_verified_file(client_file.name())}) {
+        return compare_ranges(signatures, file.get_ok()).or_else(received());
+    }
+    else if (auto removed{db::get_removed(client_file.name())}) {
+        return respond_already_removed(client_file);
+    }
+    else {
+        return respond_requesting(client_file);
+    }
+}
+
+// compares the client's ranges with the local ones at the same offsets,
+// asks for the sub ranges of differing ranges or, once they are blocks, 
+// corrects them like differing blocks of a signature addendum
+Result<Message> SyncSystem::compare_ranges(
+    const RangeSignatures& signatures, 
+    msg::File local_file
+) {
+    auto client_file{signatures.file()};
+    BlockSize block_size{signatures.block_size()};
+    size_t range_size{signatures.range_size()};
+
+    if (block_size == 0 
+        || 
+        block_size > MAX_BLOCK_SIZE 
+        ||
+        range_size < block_size
+        ||
+        range_size % block_size != 0
+        ||
+        signatures.offsets_size() != signatures.signatures_size()
+    ) {
+        return Result<Message>::err(
+            Error{"Invalid range signatures of " + client_file.name()}
+        );
+    }
+
+    logger->info("Comparing ranges of " + colored(local_file) + " with client");
+
+    auto tail{get_range_tail(client_file.size(), local_file.size, block_size)};
+
+    // ranges which reach past the tail differ, those before it get compared
+    vector<Offset> differing{};
+    vector<pair<Offset, size_t>> compared{};
+    vector<StrongSign> client_signatures{};
+
+    for (int i{0}; i < signatures.offsets_size(); i++) {
+        Offset offset{signatures.offsets(i)};
+
+        if (offset >= tail) {
+            continue;
+        }
+
+        size_t size{min(range_size, client_file.size() - offset)};
+
+        if (offset + size <= tail) {
+            compared.push_back({offset, size});
+            client_signatures.push_back(
+                StrongSign::from_bytes(signatures.signatures(i))
+            );
+        }
+        else {
+            differing.push_back(offset);
+        }
+    }
+
+    return
+    fs::get_range_signatures(
+        local_file.name, 
+        compared, 
+        signatures.hash_algorithm(),
+        hashing.threads
+    )
+    .flat_map<Message>([&](vector<StrongSign> local_signatures){
+        for (size_t i{0}; i < compared.size(); i++) {
+            if (local_signatures[i] != client_signatures[i]) {
+                differing.push_back(compared[i].first);
+            }
+        }
+
+        sort(differing.begin(), differing.end());
+
+        if (range_size > block_size && differing.size() > 0) {
+            Message msg{};
+            msg.set_allocated_range_request(
+                range_request(
+                    client_file, 
+                    signatures.hash_algorithm(), 
+                    block_size, 
+                    range_size, 
+                    differing
+            ));
+
+            return Result<Message>::ok(msg);
+        }
+
+        size_t client_tail_size{client_file.size() - tail};
+        size_t local_tail_size{local_file.size - tail};
+
+        if (max(client_tail_size, local_tail_size) > numeric_limits<BlockSize>::max()) {
+            return Result<Message>::err(
+                Error{"Sizes of " + client_file.name() + " differ too much for ranges"}
+            );
+        }
+
+        vector<BlockPair*> non_matching{};
+
+        // adjacent differing blocks are corrected together
+        for (size_t i{0}; i < differing.size();) {
+            size_t j{i + 1};
+            while (j < differing.size() 
+                && 
+                differing[j] == differing[j - 1] + block_size
+                &&
+                (j - i + 1) * block_size <= MAX_BLOCK_SIZE
+            ) {
+                j++;
+            }
+
+            auto size{get_ranges(
+                {differing[i]}, 
+                (j - i) * block_size, 
+                client_file.size()
+            ).at(0).second};
+            non_matching.push_back(
+                block_pair(client_file.name(), differing[i], differing[i], size)
+            );
+
+            i = j;
+        }
+
+        if (client_tail_size > 0 || local_tail_size > 0) {
+            non_matching.push_back(
+                block_pair(
+                    client_file.name(), 
+                    tail, 
+                    tail, 
+                    client_tail_size, 
+                    local_tail_size
+            ));
+        }
+
+        Message msg{};
+
+        if (client_file.timestamp() > local_file.timestamp) {
+            msg.set_allocated_sync_response(sync_response(
+                client_file,
+                partial_match(local_file.to_proto()),
+                block_pairs(swap_sides(move(non_matching)))
+            ));
+        }
+        else {
+            msg.set_allocated_sync_response(sync_response(
+                client_file,
+                partial_match(
+                    local_file.to_proto(),
+                    nullopt,
+                    get_corrections(move(non_matching), client_file.name(), true)
+                ),
+                nullopt
+            ));
+        }
+
+        return Result<Message>::ok(msg);
+    });
+}
+
+Message SyncSystem::get_range_signatures(const RangeRequest& request) {
+    auto requested_file{request.requested_file()};
+    BlockSize block_size{request.block_size()};
+    size_t range_size{request.range_size()};
+
+    if (block_size == 0 
+        || 
+        block_size > MAX_BLOCK_SIZE 
+        ||
+        range_size <= block_size
+        ||
+        range_size % (block_size * RANGE_FAN_OUT) != 0
+    ) {
+        logger->error("Invalid range request of " + requested_file.name());
+
+        return received();
+    }
+
+    return
+        get_verified_file(requested_file.name())
+        .flat_map<Message>([&](msg::File file){
+            auto sub_range_offsets{get_sub_range_offsets(
+                vector<Offset>(request.offsets().begin(), request.offsets().end()),
+                range_size,
+                file.size
+            )};
+
+            return get_range_signatures(
+                move(file),
+                request.hash_algorithm(),
+                block_size,
+                range_size / RANGE_FAN_OUT,
+                sub_range_offsets
+            );
+        })
+        .peek(
+            [](auto){},
+            [&](Error err){ logger->error(err.msg); }
+        )
+        .or_else(received());
+}
+
+Message SyncSystem::get_sync_response(const GapSignatures& signatures) {
+    auto client_file{signatures.file()};
+
+    if (auto file{get_verified_file(client_file.name())}) {
+        return 
+            match_gaps(signatures, file.get_ok())
+            .peek(
+                [](auto){},
+                [&](Error err){ logger->error(err.msg); }
+            )
+            .or_else(received());
+    }
+    else if (auto removed{db::get_removed(client_file.name())}) {
+        return respond_already_removed(client_file);
+    }
+    else {
+        return respond_requesting(client_file);
+    }
+}
+
+// matches the client's blocks of each gap within the local side of the gap,
+// the gaps between the verified matches get refined further
+Result<Message> SyncSystem::match_gaps(
+    const GapSignatures& signatures, 
+    msg::File local_file
+) {
+    auto client_file{signatures.file()};
+    auto& gaps{signatures.gaps().block_pairs()};
+    BlockSize block_size{signatures.block_size()};
+    size_t length{signatures.strong_signature_length()};
+
+    size_t block_count{0};
+    for (auto& gap: gaps) {
+        block_count += block_size > 0 ? gap.size_client() / block_size : 0;
+    }
+
+    if (block_size < MIN_REFINED_BLOCK_SIZE
+        ||
+        block_size > MAX_BLOCK_SIZE
+        ||
+        length < MIN_REFINED_STRONG_SIGNATURE_LENGTH
+        ||
+        length > StrongSign::length
+        ||
+        (size_t)signatures.weak_signatures_size() != block_count
+        ||
+        signatures.strong_signatures().size() != length * block_count
+    ) {
+        return Result<Message>::err(
+            Error{"Invalid gap signatures of " + client_file.name()}
+        );
+    }
+
+    // the matches of all gaps get verified in one batch
+    vector<BlockPair*> candidates{};
+    vector<int> candidate_gaps{};
+    vector<size_t> candidate_blocks{};
+    size_t first_block{0};
+
+    for (int i{0}; i < gaps.size(); i++) {
+        auto& gap{gaps.at(i)};
+        size_t count{gap.size_client() / block_size};
+
+        if (count > 0 && gap.size_server() >= block_size) {
+            BlockMatcher matcher{
+                vector<WeakSign>(
+                    signatures.weak_signatures().begin() + first_block,
+                    signatures.weak_signatures().begin() + first_block + count
+                ),
+                block_size
+            };
+
+            auto streamed{fs::stream_weak_signatures(
+                local_file.name,
+                block_size,
+                gap.offset_server(),
+                gap.size_server(),
+                [&](Offset offset, const vector<WeakSign>& batch){
+                    matcher.consume(offset - gap.offset_server(), batch);
+                }
+            )};
+
+            if (!streamed) {
+                for (auto candidate: candidates) {
+                    delete candidate;
+                }
+
+                return Result<Message>::err(streamed.get_err());
+            }
+
+            for (auto [client_offset, local_offset]: matcher.get_matches()) {
+                candidates.push_back(block_pair(
+                    client_file.name(),
+                    gap.offset_client() + client_offset,
+                    gap.offset_server() + local_offset,
+                    block_size
+                ));
+                candidate_gaps.push_back(i);
+                candidate_blocks.push_back(first_block + client_offset / block_size);
+            }
+        }
+
+        first_block += count;
+    }
+
+    vector<pair<Offset, size_t>> local_blocks{};
+    local_blocks.reserve(candidates.size());
+
+    for (auto candidate: candidates) {
+        local_blocks.push_back({candidate->offset_server(), block_size});
+    }
+
+    return
+    fs::get_range_signatures(
+        local_file.name, 
+        local_blocks, 
+        signatures.hash_algorithm(),
+        hashing.threads
+    )
+    .map<Message>([&](vector<StrongSign> local_signatures){
+        vector<vector<BlockPair*>> matching(gaps.size());
+        size_t confirmed{0};
+
+        for (size_t i{0}; i < candidates.size(); i++) {
+            auto client_signature{
+                signatures.strong_signatures().data() + candidate_blocks[i] * length
+            };
+
+            if (equal(
+                    local_signatures[i].bytes.begin(), 
+                    local_signatures[i].bytes.begin() + length, 
+                    (const unsigned char*)client_signature
+            )) {
+                matching[candidate_gaps[i]].push_back(candidates[i]);
+                confirmed++;
+            }
+            else {
+                delete candidates[i];
+            }
+        }
+
+        logger->debug(
+            to_string(confirmed) + " of " + to_string(candidates.size()) 
+            + " matching blocks of " + to_string(block_size) + " B in the gaps of " 
+            + colored(local_file) + " confirmed"
+        );
+
+        vector<BlockPair*> sub_gaps{};
+
+        for (int i{0}; i < gaps.size(); i++) {
+            auto between{get_block_pairs_between(matching[i], gaps.at(i))};
+            sub_gaps.insert(sub_gaps.end(), between.begin(), between.end());
+
+            for (auto pair: matching[i]) {
+                delete pair;
+            }
+        }
+
+        return refine_gaps(
+            client_file, 
+            local_file, 
+            move(sub_gaps), 
+            signatures.hash_algorithm(), 
+            block_size, 
+            signatures.refinement_floor()
+        );
+    })
+    .peek(
+        [](auto){},
+        [&](auto){
+            for (auto candidate: candidates) {
+                delete candidate;
+            }
+        }
+    );
+}
+
+// asks for the signatures of the gaps in blocks of a smaller size, 
+// gaps which can't be refined any further get corrected, 
+// the last corrections are final
+Message SyncSystem::refine_gaps(
+    const File& client_file,
+    msg::File local_file,
+    vector<BlockPair*>&& gaps,
+    HashAlgorithm algorithm,
+    BlockSize matched_block_size,
+    BlockSize refinement_floor
+) {
+    auto block_size{get_refined_block_size(matched_block_size, refinement_floor)};
+
+    vector<BlockPair*> refined{};
+    vector<BlockPair*> corrected{};
+
+    for (auto gap: gaps) {
+        bool refinable{
+            block_size < matched_block_size
+            &&
+            gap->size_client() >= block_size
+            &&
+            gap->size_server() >= block_size
+        };
+
+        (refinable ? refined : corrected).push_back(gap);
+    }
+
+    bool final{refined.empty()};
+    optional<GapRequest*> request{};
+
+    if (!final) {
+        logger->info(
+            "Refining " + to_string(refined.size()) + " gaps of " + colored(local_file) 
+            + " in blocks of " + to_string(block_size) + " B"
+        );
+
+        request = gap_request(algorithm, block_size, refinement_floor, refined);
+    }
+
+    Message msg{};
+
+    if (client_file.timestamp() > local_file.timestamp) {
+        // client file is newer
+
+        msg.set_allocated_sync_response(sync_response(
+            client_file,
+            partial_match(local_file.to_proto(), nullopt, nullopt, algorithm, request),
+            block_pairs(swap_sides(move(corrected)))
+        ));
+    }
+    else {
+        // server file is newer
+
+        msg.set_allocated_sync_response(sync_response(
+            client_file,
+            partial_match(
+                local_file.to_proto(),
+                nullopt,
+                get_corrections(move(corrected), client_file.name(), final),
+                algorithm,
+                request
+            ),
+            nullopt
+        ));
+    }
+
+    return msg;
+}
+
+
+vector<Message> SyncSystem::handle_sync_response(const SyncResponse& response) {
+    auto file{response.requested_file()};
+
+    if (response.requsting_file()) {
+        return {get_file(response.requested_file())};
+    }
+    else if (response.removed()) {
+        remove(file.name());
+
+        return {received()};
+    }
+    else if (response.has_partial_match()) {
+        return sync(response);
+    }
+    else {
+        return {received()};
+    }
+}
+
+vector<Message> SyncSystem::sync(const SyncResponse& response) {
+    auto file{response.requested_file()};
+    auto match{response.partial_match()};
     vector<Message> msgs;
 
     bool has_signature_requests{
@@ -494,54 +1512,82 @@ vector<Message> SyncSystem::sync(const SyncResponse& response) {
     };
 
     if (has_signature_requests) {
-        auto signatures{
-            Sequence(vector(
-                match.signature_requests().block_pairs().begin(),
-                match.signature_requests().block_pairs().end()
-            ))
-            .map<Result<BlockWithSignature*>>([](BlockPair pair){
-                return
-                fs::get_strong_signature(
-                    pair.file_name(),
-                    pair.offset_client(),
-                    pair.size_client()
-                )
-                .map<BlockWithSignature*>([&](StrongSign signature){
-                    return block_with_signature(
-                        new BlockPair(pair),
-                        signature
-                    );
-                });
-            })
-            .peek([](Result<BlockWithSignature*> result){
-                result.peek(
-                    [](auto){},
-                    [&](Error err){ logger->error(err.msg); }
+        auto stored{get_stored_block_signatures(file.name())};
+
+        if (stored && stored->algorithm != match.hash_algorithm()) {
+            stored = nullopt;
+        }
+
+        vector<BlockWithSignature*> signatures{};
+
+        // the blocks without stored signature get hashed in one batch
+        vector<BlockPair> unhashed_pairs{};
+        vector<pair<Offset, size_t>> unhashed_blocks{};
+
+        for (auto& pair: match.signature_requests().block_pairs()) {
+            if (auto signature{get_block_signature(stored, pair, file.size())}) {
+                signatures.push_back(
+                    block_with_signature(new BlockPair(pair), signature.value())
                 );
-            })
-            .where([](Result<BlockWithSignature*> result){
-                return result.is_ok();
-            })
-            .map<BlockWithSignature*>([](Result<BlockWithSignature*> result){
-                return result.get_ok();
-            })
-            .to_vector()
-        };
+            }
+            else {
+                unhashed_pairs.push_back(pair);
+                unhashed_blocks.push_back({pair.offset_client(), pair.size_client()});
+            }
+        }
+
+        if (unhashed_blocks.size() > 0) {
+            fs::get_range_signatures(
+                file.name(), 
+                unhashed_blocks, 
+                match.hash_algorithm(), 
+                hashing.threads
+            )
+            .apply(
+                [&](vector<StrongSign> block_signatures){
+                    for (size_t i{0}; i < unhashed_pairs.size(); i++) {
+                        signatures.push_back(block_with_signature(
+                            new BlockPair(unhashed_pairs[i]), 
+                            block_signatures[i]
+                        ));
+                    }
+                },
+                [&](Error err){ logger->error(err.msg); }
+            );
+        }
 
         Message msg{};
         msg.set_allocated_signature_addendum(
-            signature_addendum(file, move(signatures))
+            signature_addendum(file, move(signatures), match.hash_algorithm())
+        );
+        msg.mutable_signature_addendum()->set_refinement_floor(
+            get_refinement_floor(config)
         );
 
         msgs.push_back(move(msg));
     }
 
+    if (match.has_gap_request()) {
+        get_gap_signatures(file, match.gap_request())
+        .apply(
+            [&](Message msg){ msgs.push_back(move(msg)); },
+            [&](Error err){ logger->error(err.msg); }
+        );
+    }
+
+    // the last corrections are sent even without blocks, 
+    // the server builds the file once it gets them
+    bool final{!has_signature_requests && !match.has_gap_request()};
+
     if (match.has_corrections()) {
-        correct(match.corrections());
+        if (!apply(match.corrections(), match.matched_file())) {
+            // the server's whole file replaces the local one
+            msgs.push_back(request(match.matched_file()));
+        }
     }
     else if (response.has_correction_request()
             &&
-            response.correction_request().block_pairs_size() > 0
+            (response.correction_request().block_pairs_size() > 0 || final)
     ) {
         Message msg{};
         msg.set_allocated_corrections(get_corrections(
@@ -554,9 +1600,14 @@ vector<Message> SyncSystem::sync(const SyncResponse& response) {
             })
             .to_vector(),
             file.name(),
-            !has_signature_requests
+            final
         ));
 
+        if (final) {
+            // the server checks the built file against it
+            msg.mutable_corrections()->mutable_file()->CopyFrom(file);
+        }
+
         msgs.push_back(move(msg));
     }
 
@@ -566,7 +1617,109 @@ vector<Message> SyncSystem::sync(const SyncResponse& response) {
         : vector{received()};
 }
 
+// returns the signatures of the consecutive blocks of the local side of each gap
+Result<Message> SyncSystem::get_gap_signatures(
+    const File& file, 
+    const GapRequest& request
+) {
+    BlockSize block_size{request.block_size()};
+
+    if (block_size < MIN_REFINED_BLOCK_SIZE || block_size > MAX_BLOCK_SIZE) {
+        return Result<Message>::err(
+            Error{"Invalid gap request of " + file.name()}
+        );
+    }
+
+    vector<WeakSign> weak_signatures{};
+    vector<StrongSign> strong_signatures{};
+
+    // the gaps are read in parts of whole blocks, each part is hashed at once
+    size_t part_size{max(STREAM_BUFFER_SIZE / block_size, (size_t)1) * block_size};
+
+    for (auto& gap: request.gaps().block_pairs()) {
+        size_t size{gap.size_client() / block_size * block_size};
+
+        for (Offset offset{0}; offset < size; offset += part_size) {
+            size_t read_size{min(part_size, size - offset)};
+            auto part{fs::read(file.name(), gap.offset_client() + offset, read_size)};
+
+            if (!part || part.get_const_ok().size() != read_size) {
+                return Result<Message>::err(
+                    part 
+                    ? Error{file.name() + " changed during syncing"}
+                    : part.get_err()
+                );
+            }
+
+            auto data{part.get_ok()};
+            vector<const char*> blocks{};
+
+            for (Offset block{0}; block < data.size(); block += block_size) {
+                weak_signatures.push_back(get_weak_signature(data, block_size, block));
+                blocks.push_back(data.data() + block);
+            }
+
+            auto signatures{
+                get_strong_signatures(blocks, block_size, request.hash_algorithm())
+            };
+            strong_signatures.insert(
+                strong_signatures.end(), 
+                signatures.begin(), 
+                signatures.end()
+            );
+        }
+    }
+
+    Message msg{};
+    msg.set_allocated_gap_signatures(gap_signatures(
+        file, 
+        request, 
+        weak_signatures, 
+        strong_signatures, 
+        get_refined_strong_signature_length(file.size(), block_size)
+    ));
+
+    return Result<Message>::ok(msg);
+}
+
+// returns the stored strong signature of the client's block of the pair,
+// if the block is one of the stored blocks
+optional<StrongSign> get_block_signature(
+    const optional<BlockSignatures>& stored,
+    const BlockPair& pair,
+    size_t file_size
+) {
+    if (!stored || pair.offset_client() % stored->block_size != 0) {
+        return nullopt;
+    }
+
+    size_t block{pair.offset_client() / stored->block_size};
+
+    if (block < stored->strong.size()
+        &&
+        pair.size_client() == min(
+            (size_t)stored->block_size, 
+            file_size - pair.offset_client()
+        )
+    ) {
+        return stored->strong[block];
+    }
+
+    return nullopt;
+}
+
 Message SyncSystem::correct(const Corrections& corrections) {
+    if (!apply(corrections, corrections.file())) {
+        // the client's whole file replaces the local one
+        return respond_requesting(corrections.file());
+    }
+
+    return received();
+}
+
+// stores the corrections, the final ones build the corrected file,
+// returns false if it didn't get the signature of the corrected file
+bool SyncSystem::apply(const Corrections& corrections, const File& corrected_file) {
     if (corrections.corrections_size() > 0) {
         db::insert_data(
             Sequence(vector(
@@ -580,11 +1733,7 @@ Message SyncSystem::correct(const Corrections& corrections) {
         );
     }
 
-    if(corrections.final()) {
-        ::correct(corrections.file_name());
-    }
-
-    return received();
+    return !corrections.final() || ::correct(corrected_file);
 }
 
 
@@ -592,39 +1741,87 @@ Message SyncSystem::get_sync_response(const SignatureAddendum& addendum) {
     auto client_file{addendum.matched_file()};
 
     return
-    db::get_file(client_file.name())
+    get_verified_file(client_file.name())
     .map<Message>([&](msg::File local_file){
+        vector<pair<Offset, size_t>> local_blocks{};
+        local_blocks.reserve(addendum.blocks_with_signature_size());
+
+        for (auto& block_with_signature: addendum.blocks_with_signature()) {
+            local_blocks.push_back({
+                block_with_signature.block().offset_server(),
+                block_with_signature.block().size_server()
+            });
+        }
+
+        // blocks which can't be read count as not matching
+        auto local_signatures{
+            fs::get_range_signatures(
+                local_file.name,
+                local_blocks,
+                addendum.hash_algorithm(),
+                hashing.threads
+            )
+            .peek(
+                [](auto){},
+                [&](Error err){ logger->error(err.msg); }
+            )
+            .or_else(vector<StrongSign>{})
+        };
+
         vector<BlockPair*> matching{};
         vector<BlockPair*> non_matching{};
+        BlockSize matched_block_size{0};
 
-        for (auto block_with_signature: addendum.blocks_with_signature()) {
-            auto block_pair{new BlockPair(block_with_signature.block())};
-            auto signature{block_with_signature.strong_signature()};
-
-            bool match{
-                fs::get_strong_signature(
-                    block_pair->file_name(),
-                    block_pair->size_server(),
-                    block_pair->offset_server()
-                )
-                .map<bool>([&](StrongSign local_signature){
-                    return local_signature == signature;
-                })
-                .peek(
-                    [](auto){},
-                    [&](Error err){ logger->error(err.msg); }
-                )
-                .or_else(false)
-            };
+        for (int i{0}; i < addendum.blocks_with_signature_size(); i++) {
+            auto& block_with_signature{addendum.blocks_with_signature(i)};
+            matched_block_size = max(
+                matched_block_size, 
+                block_with_signature.block().size_client()
+            );
 
-            if (match) {
-                matching.push_back(block_pair);
+            if ((size_t)i >= local_signatures.size()
+                ||
+                local_signatures[i] 
+                != 
+                StrongSign::from_bytes(block_with_signature.strong_signature())
+            ) {
+                non_matching.push_back(new BlockPair(block_with_signature.block()));
             }
             else {
-                non_matching.push_back(block_pair);
+                matching.push_back(new BlockPair(block_with_signature.block()));
             }
         }
 
+        if (addendum.refinement_floor() > 0) {
+            // the gaps weren't corrected yet, all of them get refined
+            for (auto pair: non_matching) {
+                delete pair;
+            }
+
+            auto gaps{get_block_pairs_between(
+                matching, 
+                client_file.name(), 
+                client_file.size(), 
+                local_file.size
+            )};
+            for (auto pair: matching) {
+                delete pair;
+            }
+
+            return refine_gaps(
+                client_file, 
+                local_file, 
+                move(gaps), 
+                addendum.hash_algorithm(), 
+                matched_block_size, 
+                addendum.refinement_floor()
+            );
+        }
+
+        for (auto pair: matching) {
+            delete pair;
+        }
+
         Message msg{};
 
         if (client_file.timestamp() > local_file.timestamp) {
@@ -633,7 +1830,7 @@ Message SyncSystem::get_sync_response(const SignatureAddendum& addendum) {
             msg.set_allocated_sync_response(sync_response(
                 client_file,
                 partial_match(local_file.to_proto()),
-                block_pairs(non_matching)
+                block_pairs(swap_sides(move(non_matching)))
             ));
         }
         else {
@@ -660,16 +1857,35 @@ Message SyncSystem::get_sync_response(const SignatureAddendum& addendum) {
 }
 
 
-Message SyncSystem::get_file(const File& file) {
+// sends one chunk of the file at a time, the peer requests the next one
+// after writing it, so neither side holds more than a chunk in memory,
+// a file which differs from the requested one is answered as unknown
+Message SyncSystem::get_file(const File& file, Offset offset) {
+    auto requested_file{msg::File::from_proto(file)};
+
     return
-        db::get_file(file.name())
-        .flat_map<string>([](msg::File file){
-            return fs::read(file.name);
+        get_verified_file(file.name())
+        .flat_map<pair<string, bool>>([&](msg::File local_file){
+            if (local_file.signature != requested_file.signature
+                ||
+                local_file.size != requested_file.size
+            ) {
+                Error changed{
+                    colored(local_file) + " changed since it was requested"
+                };
+                logger->warn(changed.msg);
+
+                return Result<pair<string, bool>>::err(changed);
+            }
+
+            return fs::read_file_chunk(local_file.name, offset, FILE_CHUNK_SIZE);
         })
-        .map<Message>([&](string data){
+        .map<Message>([&](pair<string, bool> chunk){
+            auto [data, more]{move(chunk)};
+
             Message msg{};
             msg.set_allocated_file_response(
-                file_response(file, move(data))
+                file_response(file, move(data), offset, more)
             );
 
             return msg;
@@ -685,22 +1901,63 @@ Message SyncSystem::get_file(const File& file) {
 }
 
 
+// writes the chunk to the receiving file and requests the next one,
+// the file replaces the local one after its last chunk
 Message SyncSystem::create_file(const FileResponse& response) {
     auto file{msg::File::from_proto(response.requested_file())};
+    auto receiving_path{fs::get_receiving_path(file.name)};
+
+    if (response.unknown()) {
+        logger->warn(colored(file) + " is unknown to the peer");
+
+        // the peer may abort a transfer after some of its chunks
+        fs::remove_file(receiving_path);
+
+        return received();
+    }
+
+    auto written{
+        fs::write_file_chunk(receiving_path, response.offset(), response.data())
+    };
+
+    if (written.is_err()) {
+        logger->error(written.get_err().msg);
+        fs::remove_file(receiving_path);
+
+        return received();
+    }
+    else if (response.more()) {
+        Message msg{};
+        msg.set_allocated_file_request(file_request(
+            response.requested_file(), 
+            response.offset() + response.data().size()
+        ));
+
+        return msg;
+    }
 
-    logger->info("Got " + colored(file));
-    
     file.timestamp = 
         get_timestamp(
             cast_clock<chrono::time_point<filesystem::file_time_type::clock>>(
                 chrono::system_clock::now()
             ));
 
-    db::insert_file(file);
-
-    fs::write(file.name, string{response.data()})
+    // the file is recorded only once it replaced the local one
+    fs::move_received_file(file)
     .apply(
-        [](auto){},
+        [&](bool moved){
+            if (moved) {
+                logger->info("Got " + colored(file));
+
+                db::insert_file(file);
+            }
+            else {
+                logger->warn(
+                    "The received " + colored(file) 
+                    + " doesn't match the peer's file"
+                );
+            }
+        },
         [&](Error err){
             logger->error(err.msg);
         }
@@ -5,17 +5,66 @@
 #include "messages/sync.pb.h"
 
 #include <algorithm>
+#include <cstdint>
+#include <optional>
 #include <utility>
 #include <vector>
 
 using namespace std;
 
+vector<BlockPair*> get_block_pairs_between(
+    vector<BlockPair*>&, 
+    const FileName&, 
+    Offset client_start, 
+    Offset server_start, 
+    Offset client_end, 
+    Offset server_end
+);
+vector<Offset> get_block_offsets(size_t count, BlockSize);
+WeakSign get_chunk_key(const Chunk&);
+WeakSign get_index_key(WeakSign);
+WeakSign get_index_key(WeakSign64);
+template<typename Signature>
+vector<WeakSign> get_index_keys(const vector<Signature>&);
+
 
 vector<BlockPair*> get_block_pairs_between(
     vector<BlockPair*>& matching,
     const FileName& name,
     size_t client_file_size,
     size_t server_file_size
+) {
+    return get_block_pairs_between(
+        matching, 
+        name, 
+        0, 
+        0, 
+        client_file_size, 
+        server_file_size
+    );
+}
+
+vector<BlockPair*> get_block_pairs_between(
+    vector<BlockPair*>& matching,
+    const BlockPair& gap
+) {
+    return get_block_pairs_between(
+        matching,
+        gap.file_name(),
+        gap.offset_client(),
+        gap.offset_server(),
+        gap.offset_client() + gap.size_client(),
+        gap.offset_server() + gap.size_server()
+    );
+}
+
+vector<BlockPair*> get_block_pairs_between(
+    vector<BlockPair*>& matching,
+    const FileName& name,
+    Offset client_start,
+    Offset server_start,
+    Offset client_end,
+    Offset server_end
 ) {
     sort(
         matching.begin(),
@@ -27,8 +76,8 @@ vector<BlockPair*> get_block_pairs_between(
 
     vector<BlockPair*> non_matching{};
 
-    Offset last_client_block_end{0};
-    Offset last_server_block_end{0};
+    Offset last_client_block_end{client_start};
+    Offset last_server_block_end{server_start};
     for (auto pair: matching) {
         if (last_client_block_end < pair->offset_client()
             ||
@@ -47,16 +96,16 @@ vector<BlockPair*> get_block_pairs_between(
         last_server_block_end = pair->offset_server() + pair->size_server();
     }
 
-    if (last_client_block_end < client_file_size
+    if (last_client_block_end < client_end
         ||
-        last_server_block_end < server_file_size
+        last_server_block_end < server_end
     ) {
         non_matching.push_back(block_pair(
             name,
             last_client_block_end,
             last_server_block_end,
-            client_file_size - last_client_block_end,
-            server_file_size - last_server_block_end
+            client_end - last_client_block_end,
+            server_end - last_server_block_end
         ));
     }
 
@@ -111,3 +160,315 @@ vector<pair<msg::Data, bool /* has data */>> get_data_spaces(
 
     return blocks;
 }
+
+
+SignatureIndex::SignatureIndex(
+    const vector<WeakSign>& signatures,
+    BlockSize block_size
+): SignatureIndex{signatures, get_block_offsets(signatures.size(), block_size)} {}
+
+SignatureIndex::SignatureIndex(
+    const vector<WeakSign>& signatures,
+    const vector<Offset>& block_offsets
+): tags(65536 / 64) {
+    // the block numbers get grouped by signature, 
+    // within a group they stay in ascending order
+    vector<uint32_t> blocks(signatures.size());
+    for (uint32_t i{0}; i < blocks.size(); i++) {
+        blocks[i] = i;
+    }
+    stable_sort(
+        blocks.begin(),
+        blocks.end(),
+        [&](uint32_t a, uint32_t b){
+            return signatures[a] < signatures[b];
+        }
+    );
+
+    size_t capacity{16};
+    slot_shift = 28;
+    while (capacity < 2 * signatures.size()) {
+        capacity *= 2;
+        slot_shift--;
+    }
+    keys.resize(capacity, empty_key);
+    groups.resize(capacity + 1, Group{0, 0, 0});
+    slot_mask = capacity - 1;
+
+    offsets.reserve(blocks.size());
+    for (auto block: blocks) {
+        auto signature{signatures[block]};
+        auto slot{find_slot(signature)};
+        auto& group{groups[slot]};
+
+        if (group.count == 0) {
+            auto t{tag(signature)};
+            tags[t >> 6] |= uint64_t{1} << (t & 63);
+
+            if (slot < keys.size()) {
+                keys[slot] = signature;
+            }
+            group.first = offsets.size();
+        }
+
+        group.count++;
+        offsets.push_back(block_offsets[block]);
+    }
+}
+
+vector<Offset> get_block_offsets(size_t count, BlockSize block_size) {
+    vector<Offset> offsets(count);
+    for (size_t i{0}; i < count; i++) {
+        offsets[i] = (Offset)i * block_size;
+    }
+
+    return offsets;
+}
+
+size_t SignatureIndex::find_slot(WeakSign signature) const {
+    if (signature == empty_key) {
+        return keys.size();
+    }
+
+    // multiplicative (Fibonacci) hashing with linear probing
+    size_t slot{(uint32_t)(signature * 2654435761u) >> slot_shift};
+
+    while (keys[slot] != empty_key && keys[slot] != signature) {
+        slot = (slot + 1) & slot_mask;
+    }
+
+    return slot;
+}
+
+template<typename Signature>
+BasicBlockMatcher<Signature>::BasicBlockMatcher(
+    const vector<Signature>& client_signatures,
+    BlockSize block_size
+): block_size{block_size}, 
+   client_signatures{client_signatures},
+   index{get_index_keys(client_signatures), block_size} 
+{}
+
+template<typename Signature>
+void BasicBlockMatcher<Signature>::consume(
+    Offset batch_offset, 
+    const vector<Signature>& signatures
+) {
+    for (Offset local_offset{max(batch_offset, next_local_offset)}; 
+        local_offset < batch_offset + signatures.size();
+        local_offset++
+    ) {
+        auto signature{signatures[local_offset - batch_offset]};
+        optional<Offset> client_offset{};
+
+        if (matches.size() > 0 
+            && 
+            local_offset == next_local_offset
+            &&
+            next_client_offset / block_size < client_signatures.size()
+            &&
+            client_signatures[next_client_offset / block_size] == signature
+        ) {
+            // the run of equal blocks goes on, the index would return 
+            // the same block, since it is the next one not taken yet
+            client_offset = next_client_offset;
+            extended++;
+        }
+        else if (index.may_contain(get_index_key(signature))) {
+            client_offset = index.take(
+                get_index_key(signature), 
+                next_client_offset,
+                [&](Offset offset){
+                    if (client_signatures[offset / block_size] == signature) {
+                        return true;
+                    }
+
+                    rejected++;
+                    return false;
+                }
+            );
+        }
+
+        if (client_offset) {
+            matches.push_back({client_offset.value(), local_offset});
+            next_client_offset = client_offset.value() + block_size;
+            
+            // the matched block is skipped
+            local_offset += block_size - 1;
+            next_local_offset = local_offset + 1;
+        }
+    }
+}
+
+template<typename Signature>
+const vector<pair<Offset, Offset>>& BasicBlockMatcher<Signature>::get_matches() const {
+    return matches;
+}
+
+template<typename Signature>
+size_t BasicBlockMatcher<Signature>::get_extended_count() const {
+    return extended;
+}
+
+template<typename Signature>
+size_t BasicBlockMatcher<Signature>::get_rejected_count() const {
+    return rejected;
+}
+
+template class BasicBlockMatcher<WeakSign>;
+template class BasicBlockMatcher<WeakSign64>;
+
+WeakSign get_index_key(WeakSign signature) {
+    return signature;
+}
+
+// both halves are folded into the key, since the low bits 
+// of the polynomial hash only depend on the low bits of its terms
+WeakSign get_index_key(WeakSign64 signature) {
+    return (WeakSign)(signature ^ (signature >> 32));
+}
+
+template<typename Signature>
+vector<WeakSign> get_index_keys(const vector<Signature>& signatures) {
+    vector<WeakSign> keys(signatures.size());
+    for (size_t i{0}; i < signatures.size(); i++) {
+        keys[i] = get_index_key(signatures[i]);
+    }
+
+    return keys;
+}
+
+
+vector<pair<Chunk, Chunk>> match_chunks(
+    const vector<Chunk>& client_chunks,
+    const vector<Chunk>& local_chunks
+) {
+    vector<WeakSign> keys(client_chunks.size());
+    vector<Offset> offsets(client_chunks.size());
+    for (size_t i{0}; i < client_chunks.size(); i++) {
+        keys[i] = get_chunk_key(client_chunks[i]);
+        offsets[i] = client_chunks[i].offset;
+    }
+
+    SignatureIndex index{keys, offsets};
+    vector<pair<Chunk, Chunk>> matches{};
+    Offset client_offset{0};
+
+    auto client_chunk_at{[&](Offset offset) -> const Chunk& {
+        return *lower_bound(
+            client_chunks.begin(),
+            client_chunks.end(),
+            offset,
+            [](const Chunk& chunk, Offset offset){ return chunk.offset < offset; }
+        );
+    }};
+
+    for (auto& local_chunk: local_chunks) {
+        auto key{get_chunk_key(local_chunk)};
+
+        if (!index.may_contain(key)) {
+            continue;
+        }
+
+        // chunks with different sizes might still have the same key,
+        // the offset of such a chunk stays in the index for a later match
+        auto offset{index.take(key, client_offset, [&](Offset offset){
+            auto& client_chunk{client_chunk_at(offset)};
+
+            return 
+                client_chunk.signature == local_chunk.signature 
+                && 
+                client_chunk.size == local_chunk.size;
+        })};
+
+        if (offset) {
+            auto& client_chunk{client_chunk_at(offset.value())};
+
+            matches.push_back({client_chunk, local_chunk});
+            client_offset = client_chunk.offset + client_chunk.size;
+        }
+    }
+
+    return matches;
+}
+
+// the size is part of the key, since chunks of different sizes never match
+WeakSign get_chunk_key(const Chunk& chunk) {
+    return chunk.signature ^ (chunk.size * 2654435761u);
+}
+
+
+BlockSize get_refined_block_size(BlockSize block_size, BlockSize refinement_floor) {
+    return max({
+        block_size / REFINEMENT_FACTOR, 
+        refinement_floor, 
+        MIN_REFINED_BLOCK_SIZE
+    });
+}
+
+size_t get_refined_strong_signature_length(size_t file_size, BlockSize block_size) {
+    return max(
+        get_strong_signature_length(file_size, block_size), 
+        MIN_REFINED_STRONG_SIGNATURE_LENGTH
+    );
+}
+
+size_t get_top_range_size(size_t file_size, BlockSize block_size) {
+    size_t range_size{block_size};
+
+    while (range_size * RANGE_FAN_OUT * RANGE_FAN_OUT < file_size) {
+        range_size *= RANGE_FAN_OUT;
+    }
+
+    return range_size;
+}
+
+vector<pair<Offset, size_t>> get_ranges(
+    const vector<Offset>& offsets, 
+    size_t range_size, 
+    size_t file_size
+) {
+    vector<pair<Offset, size_t>> ranges{};
+    ranges.reserve(offsets.size());
+
+    for (auto offset: offsets) {
+        if (offset < file_size) {
+            ranges.push_back({offset, min(range_size, file_size - offset)});
+        }
+    }
+
+    return ranges;
+}
+
+vector<Offset> get_sub_range_offsets(
+    const vector<Offset>& offsets, 
+    size_t range_size, 
+    size_t file_size
+) {
+    size_t sub_range_size{range_size / RANGE_FAN_OUT};
+    vector<Offset> sub_offsets{};
+    sub_offsets.reserve(offsets.size() * RANGE_FAN_OUT);
+
+    for (auto offset: offsets) {
+        for (Offset sub_offset{offset}; 
+            sub_offset < min(offset + range_size, file_size); 
+            sub_offset += sub_range_size
+        ) {
+            sub_offsets.push_back(sub_offset);
+        }
+    }
+
+    return sub_offsets;
+}
+
+Offset get_range_tail(
+    size_t client_file_size, 
+    size_t server_file_size, 
+    BlockSize block_size
+) {
+    if (client_file_size == server_file_size) {
+        return client_file_size;
+    }
+
+    return min(client_file_size, server_file_size) / block_size * block_size;
+}
@@ -68,6 +68,7 @@ int run(const Config& config) {
             launch::async, 
             bind(run_server, 
                 config.act_as_server.value(), 
+                config.sync,
                 ref(file_operator_inbox)
           ))
         : async(launch::deferred, [](){ return 0; })
@@ -79,6 +80,8 @@ int run(const Config& config) {
             launch::async, 
             bind(run_client, 
                 config.server.value(), 
+                get_framing(config.sync.framing),
+                config.sync.requests_in_flight,
                 ref(file_operator_inbox)
           ))
         : async(launch::deferred, [](){ return 0; })
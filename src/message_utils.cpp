@@ -14,6 +14,8 @@
 
 using namespace std;
 
+string truncated_signatures(const vector<StrongSign>&, size_t);
+
 
 // creational functions for basic message types
 
@@ -21,13 +23,17 @@ File* file(
     const FileName& name,
     Timestamp timestamp,
     size_t size,
-    const StrongSign& signature
+    const StrongSign& signature,
+    HashAlgorithm signature_algorithm,
+    size_t signature_chunk_size
 ) {
     auto file{new File};
     file->set_name(name);
     file->set_timestamp(timestamp);
     file->set_size(size);
-    file->set_signature(signature);
+    file->set_signature(signature.to_bytes());
+    file->set_signature_algorithm(signature_algorithm);
+    file->set_signature_chunk_size(signature_chunk_size);
 
     return file;
 }
@@ -91,19 +97,24 @@ BlockPairs* block_pairs(const vector<BlockPair* /* used */>& block_vector) {
 
 // creational functions for download message types
 
-FileRequest* file_request(const File& file) {
+FileRequest* file_request(const File& file, Offset offset) {
     auto request{new FileRequest};
     request->set_allocated_file(new File(file));
+    request->set_offset(offset);
 
     return request;
 }
 
 FileResponse* file_response(
     const File& requested_file, 
-    variant<string, bool>&& response
+    variant<string, bool>&& response,
+    Offset offset,
+    bool more
 ) {
     auto file_response{new FileResponse};
     file_response->set_allocated_requested_file(new File(requested_file));
+    file_response->set_offset(offset);
+    file_response->set_more(more);
 
     if (auto data{get_if<string>(&response)}) {
         file_response->set_data(move(*data));
@@ -149,16 +160,34 @@ QueryOptions* query_options(
     return query_options;
 }
 
-ShowFiles* show_files(QueryOptions* /* used */ options) {
+ShowFiles* show_files(
+    QueryOptions* /* used */ options,
+    const vector<HashAlgorithm>& offered_algorithms,
+    Chunking chunking,
+    bool range_signatures,
+    WeakHash weak_hash
+) {
     auto show_files{new ShowFiles};
     show_files->set_allocated_options(options);
 
+    for (auto algorithm: offered_algorithms) {
+        show_files->add_hash_algorithms(algorithm);
+    }
+
+    show_files->set_chunking(chunking);
+    show_files->set_range_signatures(range_signatures);
+    show_files->set_weak_hash(weak_hash);
+
     return show_files;
 }
 
 FileList* file_list(
     const vector<File* /* copied */>& files, 
-    QueryOptions* /* used */ options
+    QueryOptions* /* used */ options,
+    HashAlgorithm hash_algorithm,
+    Chunking chunking,
+    bool range_signatures,
+    WeakHash weak_hash
 ) {
     auto file_list{new FileList};
 
@@ -167,6 +196,10 @@ FileList* file_list(
     }
 
     file_list->set_allocated_options(options);
+    file_list->set_hash_algorithm(hash_algorithm);
+    file_list->set_chunking(chunking);
+    file_list->set_range_signatures(range_signatures);
+    file_list->set_weak_hash(weak_hash);
 
     return file_list;
 }
@@ -204,7 +237,7 @@ BlockWithSignature* block_with_signature(
 ) {
     auto block_with_signature{new BlockWithSignature};
     block_with_signature->set_allocated_block(block_pair);
-    block_with_signature->set_strong_signature(strong_signature);
+    block_with_signature->set_strong_signature(strong_signature.to_bytes());
 
     return block_with_signature;
 }
@@ -212,7 +245,9 @@ BlockWithSignature* block_with_signature(
 PartialMatch* partial_match(
     File* /* used */ matched_file, 
     optional<BlockPairs* /* used */> signature_requests,
-    optional<Corrections* /* used */> corrections
+    optional<Corrections* /* used */> corrections,
+    HashAlgorithm hash_algorithm,
+    optional<GapRequest* /* used */> gap_request
 ) {
     auto partial_match{new PartialMatch};
     partial_match->set_allocated_matched_file(matched_file);
@@ -227,12 +262,20 @@ PartialMatch* partial_match(
         partial_match->set_allocated_corrections(corrections.value());
     }
 
+    partial_match->set_hash_algorithm(hash_algorithm);
+
+    if (gap_request.has_value()) {
+        partial_match->set_allocated_gap_request(gap_request.value());
+    }
+
     return partial_match;
 }
 
 SyncRequest* sync_request(
     File* /* used */ file,
     const vector<WeakSign>& weak_signatures,
+    BlockSize block_size,
+    HashAlgorithm hash_algorithm,
     bool removed
 ) {
     auto request{new SyncRequest};
@@ -242,7 +285,89 @@ SyncRequest* sync_request(
         request->add_weak_signatures(signature);
     }
 
+    request->set_block_size(block_size);
+
     request->set_removed(removed);
+    request->set_hash_algorithm(hash_algorithm);
+
+    return request;
+}
+
+SyncRequest* sync_request(
+    File* /* used */ file,
+    const vector<WeakSign64>& weak_signatures,
+    BlockSize block_size,
+    HashAlgorithm hash_algorithm
+) {
+    auto request{new SyncRequest};
+    request->set_allocated_file(file);
+
+    for (auto signature: weak_signatures) {
+        request->add_weak_signatures64(signature);
+    }
+
+    request->set_block_size(block_size);
+    request->set_weak_hash(WEAK_HASH_RABIN_KARP64);
+    request->set_hash_algorithm(hash_algorithm);
+
+    return request;
+}
+
+// returns the strong signatures truncated to the given length and concatenated
+string truncated_signatures(
+    const vector<StrongSign>& signatures, 
+    size_t strong_signature_length
+) {
+    string strong_signatures{};
+    strong_signatures.reserve(signatures.size() * strong_signature_length);
+
+    for (auto& signature: signatures) {
+        strong_signatures.append(
+            (const char*)signature.bytes.data(), 
+            strong_signature_length
+        );
+    }
+
+    return strong_signatures;
+}
+
+void set_strong_signatures(
+    SyncRequest* request,
+    const vector<StrongSign>& signatures,
+    size_t strong_signature_length
+) {
+    request->set_strong_signature_length(strong_signature_length);
+    request->set_strong_signatures(
+        truncated_signatures(signatures, strong_signature_length)
+    );
+}
+
+void set_strong_signatures(
+    GapSignatures* gap_signatures,
+    const vector<StrongSign>& signatures,
+    size_t strong_signature_length
+) {
+    gap_signatures->set_strong_signature_length(strong_signature_length);
+    gap_signatures->set_strong_signatures(
+        truncated_signatures(signatures, strong_signature_length)
+    );
+}
+
+SyncRequest* sync_request(
+    File* /* used */ file,
+    const vector<Chunk>& chunks,
+    HashAlgorithm hash_algorithm
+) {
+    auto request{new SyncRequest};
+    request->set_allocated_file(file);
+
+    for (auto& chunk: chunks) {
+        request->add_weak_signatures(chunk.signature);
+        request->add_chunk_sizes(chunk.size);
+    }
+
+    request->set_hash_algorithm(hash_algorithm);
+    request->set_chunking(CHUNKING_CONTENT_DEFINED);
 
     return request;
 }
@@ -271,12 +396,93 @@ SyncResponse* sync_response(
     return response;
 }
 
+RangeSignatures* range_signatures(
+    File* /* used */ file,
+    HashAlgorithm hash_algorithm,
+    BlockSize block_size,
+    size_t range_size,
+    const vector<pair<Offset, StrongSign>>& signatures
+) {
+    auto range_signatures{new RangeSignatures};
+    range_signatures->set_allocated_file(file);
+    range_signatures->set_hash_algorithm(hash_algorithm);
+    range_signatures->set_block_size(block_size);
+    range_signatures->set_range_size(range_size);
+
+    for (auto& [offset, signature]: signatures) {
+        range_signatures->add_offsets(offset);
+        range_signatures->add_signatures(signature.to_bytes());
+    }
+
+    return range_signatures;
+}
+
+RangeRequest* range_request(
+    const File& requested_file,
+    HashAlgorithm hash_algorithm,
+    BlockSize block_size,
+    size_t range_size,
+    const vector<Offset>& offsets
+) {
+    auto range_request{new RangeRequest};
+    range_request->set_allocated_requested_file(new File(requested_file));
+    range_request->set_hash_algorithm(hash_algorithm);
+    range_request->set_block_size(block_size);
+    range_request->set_range_size(range_size);
+
+    for (auto offset: offsets) {
+        range_request->add_offsets(offset);
+    }
+
+    return range_request;
+}
+
+GapRequest* gap_request(
+    HashAlgorithm hash_algorithm,
+    BlockSize block_size,
+    BlockSize refinement_floor,
+    const vector<BlockPair* /* used */>& gaps
+) {
+    auto gap_request{new GapRequest};
+    gap_request->set_hash_algorithm(hash_algorithm);
+    gap_request->set_block_size(block_size);
+    gap_request->set_refinement_floor(refinement_floor);
+    gap_request->set_allocated_gaps(block_pairs(gaps));
+
+    return gap_request;
+}
+
+GapSignatures* gap_signatures(
+    const File& file,
+    const GapRequest& request,
+    const vector<WeakSign>& weak_signatures,
+    const vector<StrongSign>& strong_signatures,
+    size_t strong_signature_length
+) {
+    auto signatures{new GapSignatures};
+    signatures->set_allocated_file(new File(file));
+    signatures->set_hash_algorithm(request.hash_algorithm());
+    signatures->set_block_size(request.block_size());
+    signatures->set_refinement_floor(request.refinement_floor());
+    signatures->set_allocated_gaps(new BlockPairs(request.gaps()));
+
+    for (auto signature: weak_signatures) {
+        signatures->add_weak_signatures(signature);
+    }
+
+    set_strong_signatures(signatures, strong_signatures, strong_signature_length);
+
+    return signatures;
+}
+
 SignatureAddendum* signature_addendum(
     const File& matched_file, 
-    const vector<BlockWithSignature* /* used */>& blocks_with_signature
+    const vector<BlockWithSignature* /* used */>& blocks_with_signature,
+    HashAlgorithm hash_algorithm
 ) {
     auto addendum{new SignatureAddendum};
     addendum->set_allocated_matched_file(new File(matched_file));
+    addendum->set_hash_algorithm(hash_algorithm);
 
     for (BlockWithSignature* block: blocks_with_signature) {
         addendum->mutable_blocks_with_signature()->AddAllocated(block);
@@ -295,6 +501,31 @@ Message received() {
     return msg;
 }
 
+optional<FileName> get_file_name(const Message& msg) {
+    switch (msg.message_case()) {
+        case Message::kSyncRequest:
+            return msg.sync_request().file().name();
+        case Message::kSyncResponse:
+            return msg.sync_response().requested_file().name();
+        case Message::kSignatureAddendum:
+            return msg.signature_addendum().matched_file().name();
+        case Message::kCorrections:
+            return msg.corrections().file_name();
+        case Message::kFileRequest:
+            return msg.file_request().file().name();
+        case Message::kFileResponse:
+            return msg.file_response().requested_file().name();
+        case Message::kRangeSignatures:
+            return msg.range_signatures().file().name();
+        case Message::kRangeRequest:
+            return msg.range_request().requested_file().name();
+        case Message::kGapSignatures:
+            return msg.gap_signatures().file().name();
+        default:
+            return nullopt;
+    }
+}
+
 
 // other utils
 
@@ -175,7 +175,7 @@ void CommandLine::list() {
 void CommandLine::list_long() {
     string output{get_file_list_header()};
 
-    for (auto file: get_files(get_file_paths(config))) {
+    for (auto file: get_files(get_file_paths(config), get_hashing(config))) {
         output += format_file(file) + "\n";
     }
 
@@ -41,7 +41,7 @@ string format_file(const msg::File& file) {
     )))};
 
     return 
-        file.signature + "  " +
+        file.signature.to_hex() + "  " +
         format_size(file.size) + "  " +
         (use_color
             ? fmt::format(fg(fmt::color::cadet_blue), time)
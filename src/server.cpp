@@ -1,7 +1,8 @@
 #include "server.h"
+#include "client_connection.h"
 #include "config.h"
 #include "internal_msg.h"
-#include "utils.h"
+#include "pipe.h"
 #include "exit_code.h"
 #include "presentation/logger.h"
 #include "messages/all.pb.h"
@@ -9,36 +10,49 @@
 #include <asio/io_context.hpp>
 #include <asio/ip/tcp.hpp>
 #include <asio/socket_base.hpp>
+#include <asio/steady_timer.hpp>
+#include <algorithm>
+#include <atomic>
 #include <chrono>
-#include <sstream>
-#include <streambuf>
-#include <string_view>
+#include <memory>
 #include <thread>
-#include <tuple>
+#include <vector>
 
 using namespace std;
 using namespace asio::ip;
 using namespace asio;
 
-bool wait_for(SendingPipe<InternalMsgWithOriginator>&);
-void handle_client(tcp::iostream&&, SendingPipe<InternalMsgWithOriginator>&);
-tuple<Message, bool> get_response(
-    const Message&, 
-    SendingPipe<InternalMsgWithOriginator>&
+bool start_with(SendingPipe<InternalMsgWithOriginator>&, Pipe<InternalMsg>&);
+void accept_clients(
+    io_context&,
+    tcp::acceptor&,
+    const SyncConfig&,
+    SendingPipe<InternalMsgWithOriginator>&,
+    atomic<size_t>&,
+    vector<weak_ptr<ClientConnection>>&
 );
-tuple<Message, bool> send_and_receive_response(
-    SendingPipe<InternalMsgWithOriginator>&, 
-    const Message&
+void stop_with(
+    io_context&,
+    steady_timer&,
+    SendingPipe<InternalMsgWithOriginator>&
 );
+void run(io_context&, atomic<bool>&);
 
 
 int run_server(
     const ServerData& config,
+    const SyncConfig& sync_config,
     SendingPipe<InternalMsgWithOriginator>& file_operator
 ) {
     ExitCode exit_code;
 
     try {
+        // outlives the connections, which are destroyed with the io_context
+        atomic<size_t> connections{0};
+        vector<weak_ptr<ClientConnection>> clients{};
+        // gets closed by the file operator, after its workers finished
+        Pipe<InternalMsg> file_operator_state;
+
         io_context io_ctx;
         tcp::endpoint tcp_ep{
             make_address(config.address), 
@@ -48,20 +62,50 @@ int run_server(
 
         acceptor.listen();
 
-        socket_base::keep_alive keep_alive;
+        if (start_with(file_operator, file_operator_state)) {
+            accept_clients(
+                io_ctx, 
+                acceptor, 
+                sync_config, 
+                file_operator, 
+                connections, 
+                clients
+            );
+
+            steady_timer timer{io_ctx};
+            stop_with(io_ctx, timer, file_operator);
+
+            auto thread_count{
+                sync_config.server_threads > 0
+                ? sync_config.server_threads
+                : max(thread::hardware_concurrency(), 1u)
+            };
+
+            atomic<bool> failed{false};
+            vector<thread> threads{};
+            for (size_t i{1}; i < thread_count; i++) {
+                threads.emplace_back(run, ref(io_ctx), ref(failed));
+            }
+            run(io_ctx, failed);
 
-        if (wait_for(file_operator)) {
-            while (file_operator.is_open()) {
-                tcp::socket socket{io_ctx};
-                acceptor.accept(socket);
-                socket.set_option(keep_alive);
-                tcp::iostream client{move(socket)};
+            for (auto& thread: threads) {
+                thread.join();
+            }
 
-                thread{handle_client, move(client), ref(file_operator)}
-                    .detach();
+            // the workers of the file operator may still post responses,
+            // so they are waited for, before the io_context gets destroyed
+            file_operator.close();
+            while (file_operator_state.receive()) {}
+
+            // the requests, which the file operator dropped, 
+            // don't keep their connections alive anymore
+            for (auto& client: clients) {
+                if (auto connection{client.lock()}) {
+                    connection->stop();
+                }
             }
 
-            exit_code = Success;
+            exit_code = failed ? ServerException : Success;
         }
         else {
             logger->critical("File operator hasn't started");
@@ -82,11 +126,17 @@ int run_server(
     return exit_code;
 }
 
-bool wait_for(SendingPipe<InternalMsgWithOriginator>& file_operator) {
-    Pipe<InternalMsg> responder;
-    file_operator.send(
+// waits for the file operator, which closes the responder after it finished
+bool start_with(
+    SendingPipe<InternalMsgWithOriginator>& file_operator,
+    Pipe<InternalMsg>& responder
+) {
+    bool sent{file_operator.send(
         InternalMsgWithOriginator(InternalMsgType::ServerWaits, responder)
-    );
+    )};
+    if (!sent) {
+        return false;
+    }
 
     if (auto optional_response{responder.receive()}) {
         auto response{optional_response.value()};
@@ -97,89 +147,105 @@ bool wait_for(SendingPipe<InternalMsgWithOriginator>& file_operator) {
     }
 }
 
-void handle_client(
-    tcp::iostream&& client, 
-    SendingPipe<InternalMsgWithOriginator>& file_operator
+// accepts clients until the io_context stops, 
+// a client above the limit is disconnected right away
+void accept_clients(
+    io_context& io_ctx,
+    tcp::acceptor& acceptor,
+    const SyncConfig& sync_config,
+    SendingPipe<InternalMsgWithOriginator>& file_operator,
+    atomic<size_t>& connections,
+    vector<weak_ptr<ClientConnection>>& clients
 ) {
-    logger->info("Client connected");
-
-    bool finished{false};
-    while (client && !finished) {
-        Message request{msg_from_base64(client)};
-
-        if (client) {
-            logger->debug("Received:\n" + request.DebugString());
-            
-            auto [response, finish]{get_response(request, file_operator)};
-            logger->debug("Sending:\n" + response.DebugString());
-            client << msg_to_base64(response) << "\n";
-
-            if (finish) {
-                client.close();
-                finished = true;
+    acceptor.async_accept(
+        [&](const asio::error_code& err, tcp::socket socket){
+            if (err == error::operation_aborted) {
+                return;
             }
-        }
-    }
-
-    if (client.error()) {
-        logger->error(
-            "Following connection error occurred: "
-            + client.error().message()
-        );
-    }
-    if (finished) {
-        logger->info("Client disconnected");
-    }
-}
 
-tuple<Message, bool> get_response(
-    const Message& request, 
-    SendingPipe<InternalMsgWithOriginator>& file_operator
-) {
-    Message response{};
-    bool finish{false};
-
-    switch (request.message_case()) {
-        case Message::kReceived:
-            response.set_received(true);
-            break;
-        case Message::kFinish:
-            response.set_finish(true);
-            finish = true;
-            break;
-        case Message::MESSAGE_NOT_SET:
-            logger->warn("Received an undefined message");
-            break;
-        default:
-            auto [file_operator_response, file_operator_success] = 
-                send_and_receive_response(file_operator, request);
-
-            if (file_operator_success) {
-                response = file_operator_response;
+            if (err) {
+                logger->error(
+                    "Following error occurred while accepting a client: "
+                    + err.message()
+                );
+            }
+            else if (connections >= sync_config.max_clients) {
+                logger->warn(
+                    "Rejected a client, because "
+                    + to_string(sync_config.max_clients)
+                    + " clients are connected"
+                );
             }
             else {
-                response.set_finish(true);
-                finish = true;
+                socket.set_option(socket_base::keep_alive{});
+
+                auto connection{make_shared<ClientConnection>(
+                    io_ctx,
+                    move(socket),
+                    file_operator,
+                    connections,
+                    sync_config.requests_in_flight
+                )};
+                connection->start();
+
+                // only one accept is pending at a time
+                clients.erase(
+                    remove_if(
+                        clients.begin(), 
+                        clients.end(), 
+                        [](auto& client){ return client.expired(); }
+                    ),
+                    clients.end()
+                );
+                clients.push_back(connection);
             }
 
-            break;
-    }
-
-    return {response, finish};
+            accept_clients(
+                io_ctx, 
+                acceptor, 
+                sync_config, 
+                file_operator, 
+                connections, 
+                clients
+            );
+        }
+    );
 }
 
-tuple<Message, bool> send_and_receive_response(
-    SendingPipe<InternalMsgWithOriginator>& file_operator, 
-    const Message& request
+// stops the io_context once the file operator is closed
+void stop_with(
+    io_context& io_ctx,
+    steady_timer& timer,
+    SendingPipe<InternalMsgWithOriginator>& file_operator
 ) {
-    Pipe<InternalMsg> responder;
-    file_operator.send(get_msg_to_file_operator(responder, request));
+    timer.expires_after(std::chrono::milliseconds(250));
+    timer.async_wait([&](const asio::error_code& err){
+        if (err) {
+            return;
+        }
 
-    if (auto optional_msg{responder.receive()}) {
-        auto msg{optional_msg.value()};
-        return {msg.msg, msg.type == InternalMsgType::SendMessage};
+        if (file_operator.is_closed()) {
+            io_ctx.stop();
+        }
+        else {
+            stop_with(io_ctx, timer, file_operator);
+        }
+    });
+}
+
+// runs the handlers of the io_context, an exception stops it 
+// on every thread
+void run(io_context& io_ctx, atomic<bool>& failed) {
+    try {
+        io_ctx.run();
     }
-    else {
-        return {Message{}, false};
+    catch (exception& err) {
+        logger->critical(
+            "Following exception occurred during server execution: " 
+            + string{err.what()}
+        );
+
+        failed = true;
+        io_ctx.stop();
     }
 }
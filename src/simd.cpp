@@ -0,0 +1,45 @@
+#include "simd.h"
+
+#include <string>
+#include <vector>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define X86_KERNELS
+#endif
+
+using namespace std;
+using namespace simd;
+
+
+vector<Kernel> simd::supported_kernels() {
+    vector<Kernel> kernels{Kernel::Scalar};
+
+#ifdef X86_KERNELS
+    __builtin_cpu_init();
+
+    if (__builtin_cpu_supports("sse4.1")) {
+        kernels.push_back(Kernel::SSE41);
+    }
+    if (__builtin_cpu_supports("avx2")) {
+        kernels.push_back(Kernel::AVX2);
+    }
+#endif
+
+    return kernels;
+}
+
+Kernel simd::best_kernel() {
+    static const Kernel best{supported_kernels().back()};
+    return best;
+}
+
+string simd::kernel_name(Kernel kernel) {
+    switch (kernel) {
+        case Kernel::SSE41:
+            return "SSE4.1";
+        case Kernel::AVX2:
+            return "AVX2";
+        default:
+            return "scalar";
+    }
+}
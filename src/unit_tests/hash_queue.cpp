@@ -0,0 +1,172 @@
+#include "file_operator/hash_queue.h"
+#include "unit_tests/doctest_utils.h"
+
+#include <doctest.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+// sleep is needed since multiple threads are used
+#define sleep() this_thread::sleep_for(chrono::milliseconds(25))
+
+
+TEST_SUITE("hash queue") {
+    TEST_CASE("hash queue") {
+        mutex hashed_mtx{};
+        vector<string> hashed{};
+        atomic<bool> blocked{false};
+
+        HashQueue queue{[&](const vector<filesystem::path>& files){
+            for (auto& file: files) {
+                while (blocked && file == "a") {
+                    sleep();
+                }
+
+                lock_guard hashed_lck{hashed_mtx};
+                hashed.push_back(file);
+            }
+        }};
+
+        SUBCASE("all files get hashed once") {
+            queue.push({"a", "b", "c"});
+            queue.push({"b", "d"});
+            queue.wait();
+
+            sort(hashed.begin(), hashed.end());
+            CHECK(hashed == vector<string>{"a", "b", "c", "d"});
+            CHECK_FALSE(queue.is_pending("a"));
+        }
+
+        SUBCASE("a prioritised file gets hashed before waiting files") {
+            blocked = true;
+            queue.push({"a", "b", "c"});
+            sleep(); // the worker blocks on "a"
+
+            CHECK(queue.is_pending("c"));
+
+            queue.prioritise("c");
+
+            {
+                lock_guard hashed_lck{hashed_mtx};
+                CHECK(hashed == vector<string>{"c"});
+            }
+
+            CHECK_FALSE(queue.is_pending("c"));
+            CHECK(queue.is_pending("a"));
+            CHECK(queue.is_pending("b"));
+
+            blocked = false;
+            queue.wait();
+
+            CHECK(hashed.size() == 3);
+        }
+
+        SUBCASE("prioritised files get hashed in one batch") {
+            vector<vector<string>> batches{};
+            HashQueue batch_queue{
+                [&](const vector<filesystem::path>& files){
+                    while (blocked && files.front() == "a") {
+                        sleep();
+                    }
+
+                    lock_guard hashed_lck{hashed_mtx};
+                    batches.push_back({files.begin(), files.end()});
+                }
+            };
+
+            blocked = true;
+            batch_queue.push({"a", "b", "c", "d"});
+            sleep(); // the worker blocks on "a"
+
+            batch_queue.prioritise(vector<FileName>{"d", "b", "unknown"});
+
+            {
+                lock_guard hashed_lck{hashed_mtx};
+                CHECK(batches == vector<vector<string>>{{"b", "d"}});
+            }
+
+            CHECK_FALSE(batch_queue.is_pending("b"));
+            CHECK_FALSE(batch_queue.is_pending("d"));
+            CHECK(batch_queue.is_pending("c"));
+
+            blocked = false;
+            batch_queue.wait();
+
+            CHECK(batches.size() == 3);
+        }
+
+        SUBCASE("prioritising waits for a file which is being hashed") {
+            blocked = true;
+            queue.push({"a"});
+            sleep(); // the worker blocks on "a"
+
+            thread t{[&](){
+                sleep();
+                blocked = false;
+            }};
+            queue.prioritise("a");
+
+            {
+                lock_guard hashed_lck{hashed_mtx};
+                CHECK(hashed == vector<string>{"a"});
+            }
+
+            t.join();
+        }
+
+        SUBCASE("pending files") {
+            blocked = true;
+            queue.push({"a", "b"});
+            sleep(); // the worker blocks on "a"
+
+            auto pending{queue.get_pending()};
+            sort(pending.begin(), pending.end());
+            CHECK(pending == vector<FileName>{"a", "b"});
+
+            blocked = false;
+            queue.wait();
+
+            CHECK(queue.get_pending().empty());
+        }
+
+        SUBCASE("unknown files don't need to be hashed") {
+            queue.prioritise("unknown");
+
+            CHECK_FALSE(queue.is_pending("unknown"));
+            CHECK(hashed.empty());
+        }
+    }
+
+    TEST_CASE("hash queue in batches") {
+        mutex batches_mtx{};
+        vector<vector<string>> batches{};
+
+        HashQueue queue{
+            [&](const vector<filesystem::path>& files){
+                lock_guard batches_lck{batches_mtx};
+                batches.push_back({files.begin(), files.end()});
+            },
+            2
+        };
+
+        queue.push({"a", "b", "c", "d", "e"});
+        queue.wait();
+
+        vector<string> hashed{};
+        for (auto& batch: batches) {
+            CHECK(batch.size() <= 2);
+            hashed.insert(hashed.end(), batch.begin(), batch.end());
+        }
+
+        sort(hashed.begin(), hashed.end());
+        CHECK(hashed == vector<string>{"a", "b", "c", "d", "e"});
+        CHECK(batches.size() >= 3);
+    }
+}
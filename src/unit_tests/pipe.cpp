@@ -1,9 +1,12 @@
 #include "pipe.h"
+#include "message_utils.h"
 #include "unit_tests/doctest_utils.h"
 #include "messages/all.pb.h"
 
 #include <algorithm>
+#include <atomic>
 #include <doctest.h>
+#include <functional>
 #include <thread>
 #include <vector>
 
@@ -178,6 +181,53 @@ TEST_SUITE("pipe") {
         }
     }
 
+    TEST_CASE("bounded pipe") {
+        BoundedPipe<int> pipe{2};
+
+        SUBCASE("sending blocks while the pipe is full") {
+            REQUIRE(pipe.send(1));
+            REQUIRE(pipe.send(2));
+
+            atomic<bool> sent{false};
+
+            thread t{[&](){
+                sent = pipe.send(3);
+            }};
+
+            sleep();
+            CHECK_FALSE(sent);
+
+            CHECK(pipe.receive() == 1);
+            t.join();
+
+            CHECK(sent);
+            CHECK(pipe.receive() == 2);
+            CHECK(pipe.receive() == 3);
+        }
+
+        SUBCASE("remaining messages get received after closing") {
+            REQUIRE(pipe.send(1));
+            pipe.close();
+
+            CHECK_FALSE(pipe.send(2));
+            CHECK(pipe.receive() == 1);
+            CHECK_FALSE(pipe.receive().has_value());
+        }
+
+        SUBCASE("closing releases a blocked sender") {
+            REQUIRE(pipe.send(vector<int>{1, 2}));
+
+            thread t{[&](){
+                sleep();
+                pipe.close();
+            }};
+
+            CHECK_FALSE(pipe.send(3));
+
+            t.join();
+        }
+    }
+
     TEST_CASE("pipe as receiving and sending end") {
         Pipe<Message> pipe;
 
@@ -213,4 +263,66 @@ TEST_SUITE("pipe") {
         CHECK(receiving->is_closed());
         CHECK(sending->is_closed()); 
     }
+
+    TEST_CASE("sharded pipe") {
+        ShardedPipe<Message> pipe{4, [](const Message& msg){
+            return hash<FileName>{}(get_file_name(msg).value_or(""));
+        }};
+
+        REQUIRE(pipe.size() == 4);
+        REQUIRE(pipe.is_open());
+        REQUIRE(pipe.is_empty());
+
+        auto request{[](const FileName& name, Offset offset){
+            File file{};
+            file.set_name(name);
+
+            Message msg{};
+            msg.set_allocated_file_request(file_request(file, offset));
+
+            return msg;
+        }};
+
+        SUBCASE("requests for one file are received in order from one shard") {
+            // two requests for file "a" are in flight at once
+            vector<pair<FileName, Offset>> requests{
+                {"a", 0}, {"b", 0}, {"c", 0}, {"d", 0}, {"e", 0}, {"f", 0}, {"a", 1}, {"b", 1}
+            };
+            for (auto [name, offset]: requests) {
+                REQUIRE(pipe.send(request(name, offset)));
+            }
+
+            vector<Offset> offsets_of_a{};
+            size_t shards_with_a{0};
+
+            for (size_t i{0}; i < pipe.size(); i++) {
+                bool with_a{false};
+
+                while (pipe.shard(i).is_not_empty()) {
+                    auto msg{pipe.shard(i).receive().value()};
+
+                    if (get_file_name(msg) == "a") {
+                        offsets_of_a.push_back(msg.file_request().offset());
+                        with_a = true;
+                    }
+                }
+
+                shards_with_a += with_a ? 1 : 0;
+            }
+
+            CHECK(shards_with_a == 1);
+            CHECK(offsets_of_a == vector<Offset>{0, 1});
+            CHECK(pipe.is_empty());
+        }
+
+        SUBCASE("closing closes all shards") {
+            pipe.close();
+
+            CHECK(pipe.is_closed());
+            for (size_t i{0}; i < pipe.size(); i++) {
+                CHECK(pipe.shard(i).is_closed());
+            }
+            CHECK_FALSE(pipe.send(request("a", 0)));
+        }
+    }
 }
@@ -0,0 +1,76 @@
+#include "request_window.h"
+#include "unit_tests/doctest_utils.h"
+
+#include <atomic>
+#include <chrono>
+#include <doctest.h>
+#include <thread>
+
+using namespace std;
+
+// sleep is needed since multiple threads are used
+#define sleep() this_thread::sleep_for(chrono::milliseconds(25))
+
+
+TEST_SUITE("request window") {
+    TEST_CASE("request window") {
+        RequestWindow window;
+
+        SUBCASE("requests are added until the window is full") {
+            atomic<bool> answered{false};
+
+            REQUIRE(window.add(2));
+            REQUIRE(window.add(2));
+
+            thread t{[&](){
+                sleep();
+                answered = true;
+                window.remove();
+            }};
+
+            CHECK(window.add(2));
+            CHECK(answered);
+            CHECK(window.size() == 2);
+
+            t.join();
+        }
+
+        SUBCASE("a window of size 0 holds one request") {
+            REQUIRE(window.add(0));
+            CHECK(window.size() == 1);
+        }
+
+        SUBCASE("waiting for no requests ends with the last response") {
+            atomic<bool> answered{false};
+
+            REQUIRE(window.add(4));
+            REQUIRE(window.add(4));
+
+            thread t{[&](){
+                window.remove();
+                sleep();
+                answered = true;
+                window.remove();
+            }};
+
+            CHECK(window.wait_for_none());
+            CHECK(answered);
+
+            t.join();
+        }
+
+        SUBCASE("closing releases waiting threads") {
+            REQUIRE(window.add(1));
+
+            thread t{[&](){
+                sleep();
+                window.close();
+            }};
+
+            CHECK_FALSE(window.add(1));
+            CHECK_FALSE(window.wait_for_none());
+
+            t.join();
+        }
+    }
+}
@@ -1,9 +1,19 @@
 #include "file_operator/signatures.h"
+#include "file_operator/checksum_kernels.h"
+#include "file_operator/md5_kernels.h"
+#include "file_operator/strong_hash.h"
+#include "messages/basic.h"
+#include "simd.h"
 #include "unit_tests/doctest_utils.h"
 
 #include <doctest.h>
+#include <algorithm>
+#include <random>
 #include <sstream>
+#include <stdexcept>
+#include <string>
 #include <tuple>
+#include <vector>
 
 using namespace std;
 
@@ -22,7 +32,7 @@ TEST_SUITE("sync_utils") {
             DOCTEST_VALUE_PARAMETERIZED_DATA(msg_signature_pair, msg_signature_pairs);
 
             CHECK(
-                get_strong_signature(get<0>(msg_signature_pair)) 
+                get_strong_signature(get<0>(msg_signature_pair)).to_hex()
                 == 
                 get<1>(msg_signature_pair)
             );
@@ -31,11 +41,97 @@ TEST_SUITE("sync_utils") {
             DOCTEST_VALUE_PARAMETERIZED_DATA(msg_signature_pair, msg_signature_pairs);
             istringstream msg_stream{get<0>(msg_signature_pair)};
             CHECK(
-                get_strong_signature(msg_stream) == get<1>(msg_signature_pair)
+                get_strong_signature(msg_stream).to_hex() 
+                == 
+                get<1>(msg_signature_pair)
             );
         }        
     }
 
+    TEST_CASE("strong signature as bytes") {
+        auto signature{get_strong_signature("ABC")};
+
+        CHECK(signature.to_bytes().size() == StrongSign::length);
+        CHECK(StrongSign::from_bytes(signature.to_bytes()) == signature);
+        CHECK(StrongSign::from_bytes(signature.to_bytes()).to_hex() == signature.to_hex());
+        CHECK(signature != get_strong_signature("ABD"));
+        CHECK(StrongSign{} != signature);
+        CHECK(StrongSign::from_bytes("") == StrongSign{});
+        CHECK(StrongSign{}.to_hex() == string(2 * StrongSign::length, '0'));
+    }
+
+    TEST_CASE("strong hash algorithms") {
+        // digests truncated to the length of a StrongSign
+        vector<tuple<HashAlgorithm, string, string>> algorithm_msg_signatures{
+            {HASH_MD5,      "",    "d41d8cd98f00b204e9800998ecf8427e"},
+            {HASH_MD5,      "ABC", "902fbdd2b1df0c4f70b4a5d23525e932"},
+            {HASH_XXH3_128, "",    "99aa06d3014798d86001c324468d497f"},
+            {HASH_XXH3_128, "ABC", "9e947f00ecd6acb2244da40f405c870e"},
+            {HASH_BLAKE3,   "",    "af1349b9f5f9a1a6a0404dea36dcc949"},
+            {HASH_BLAKE3,   "ABC", "d1717274597cf0289694f75d96d444b9"}
+        };
+        tuple<HashAlgorithm, string, string> algorithm_msg_signature;
+
+        SUBCASE("known digests") {
+            DOCTEST_VALUE_PARAMETERIZED_DATA(
+                algorithm_msg_signature,
+                algorithm_msg_signatures
+            );
+            auto [algorithm, msg, signature]{algorithm_msg_signature};
+
+            if (strong_hash::is_supported(algorithm)) {
+                istringstream msg_stream{msg};
+
+                CHECK(get_strong_signature(msg, algorithm).to_hex() == signature);
+                CHECK(get_strong_signature(msg_stream, algorithm).to_hex() == signature);
+            }
+            else {
+                CHECK_THROWS_AS(
+                    get_strong_signature(msg, algorithm),
+                    invalid_argument
+                );
+            }
+        }
+        SUBCASE("incremental") {
+            string data(100000, '\0');
+            mt19937 random_bytes{7};
+            generate(data.begin(), data.end(), [&](){ return (char)random_bytes(); });
+
+            for (auto algorithm: strong_hash::supported_algorithms()) {
+                auto hasher{strong_hash::make_hasher(algorithm)};
+                hasher->update(data.data(), 1);
+                hasher->update(data.data() + 1, 40000);
+                hasher->update(data.data() + 40001, data.size() - 40001);
+
+                CHECK(hasher->finish() == get_strong_signature(data, algorithm));
+            }
+        }
+        SUBCASE("names") {
+            for (auto algorithm: {HASH_MD5, HASH_XXH3_128, HASH_BLAKE3}) {
+                CHECK(
+                    strong_hash::from_name(strong_hash::algorithm_name(algorithm))
+                    ==
+                    algorithm
+                );
+            }
+            CHECK(!strong_hash::from_name("sha1").has_value());
+        }
+        SUBCASE("negotiation") {
+            CHECK(strong_hash::is_supported(HASH_MD5));
+            CHECK(strong_hash::negotiate({}) == HASH_MD5);
+            CHECK(strong_hash::negotiate({(HashAlgorithm)42}) == HASH_MD5);
+
+            for (auto algorithm: strong_hash::supported_algorithms()) {
+                auto offered{strong_hash::offered_algorithms(algorithm)};
+
+                CHECK(offered.front() == algorithm);
+                CHECK(count(offered.begin(), offered.end(), HASH_MD5) == 1);
+                CHECK(offered.size() == strong_hash::supported_algorithms().size());
+                CHECK(strong_hash::negotiate(offered) == algorithm);
+            }
+        }
+    }
+
     TEST_CASE("weak signature") {
         vector<tuple<string, unsigned int>> msg_signature_pairs{
             {"ABC", 25821382}, 
@@ -127,8 +223,411 @@ TEST_SUITE("sync_utils") {
                     CHECK(signatures[i] == get_weak_signature(msg_stream, 4, i + offset));
                 }
             }
-            
-            
+
+            SUBCASE("istream larger than the stream buffer") {
+                mt19937 random_bytes{7};
+                string data(STREAM_BUFFER_SIZE * 5 / 2, '\0');
+                for (auto& c: data) {
+                    c = (char)(random_bytes() % 256);
+                }
+                istringstream data_stream{data};
+
+                Offset expected_offset{13};
+                auto expected{get_weak_signatures(data, BLOCK_SIZE, 13)};
+
+                stream_weak_signatures(
+                    data_stream, 
+                    data.length(), 
+                    BLOCK_SIZE, 
+                    13,
+                    [&](Offset offset, const vector<WeakSign>& batch){
+                        REQUIRE(offset == expected_offset);
+                        REQUIRE(offset + batch.size() <= 13 + expected.size());
+                        CHECK(equal(
+                            batch.begin(), 
+                            batch.end(), 
+                            expected.begin() + (offset - 13)
+                        ));
+
+                        expected_offset += batch.size();
+                    }
+                );
+
+                CHECK(expected_offset == 13 + expected.size());
+            }
+        }
+    }
+
+    TEST_CASE("64 bit weak signature") {
+        mt19937 random_bytes{11};
+        string data(STREAM_BUFFER_SIZE * 3 / 2, '\0');
+        for (auto& c: data) {
+            c = (char)(random_bytes() % 256);
+        }
+        BlockSize block_size{700};
+
+        SUBCASE("rolled signatures equal those of the blocks") {
+            auto signatures{get_weak_signatures64(data, block_size, 5)};
+
+            REQUIRE(signatures.size() == data.size() - block_size + 1 - 5);
+            bool equal_signatures{true};
+            for (size_t i{0}; i < signatures.size(); i += 997) {
+                equal_signatures = 
+                    equal_signatures 
+                    && 
+                    signatures[i] == get_weak_signature64(data, block_size, 5 + i);
+            }
+            CHECK(equal_signatures);
+            CHECK(signatures.back() == get_weak_signature64(data, block_size, data.size() - block_size));
+        }
+
+        SUBCASE("istream") {
+            istringstream data_stream{data};
+
+            CHECK(
+                get_weak_signature64(data_stream, block_size, 42) 
+                == 
+                get_weak_signature64(data, block_size, 42)
+            );
+        }
+
+        SUBCASE("streamed signatures equal the rolled ones") {
+            istringstream data_stream{data};
+            auto expected{get_weak_signatures64(data, block_size, 13)};
+            vector<WeakSign64> streamed{};
+
+            stream_weak_signatures64(
+                data_stream, 
+                data.length(), 
+                block_size, 
+                13,
+                [&](Offset offset, const vector<WeakSign64>& batch){
+                    REQUIRE(offset == 13 + streamed.size());
+                    streamed.insert(streamed.end(), batch.begin(), batch.end());
+                }
+            );
+
+            CHECK(streamed == expected);
+        }
+
+        SUBCASE("blocks which differ in one byte") {
+            auto changed{data};
+            changed[100]++;
+
+            CHECK(
+                get_weak_signature64(changed, block_size) 
+                != 
+                get_weak_signature64(data, block_size)
+            );
+        }
+    }
+
+    TEST_CASE("weak signature kernels") {
+        mt19937 random_bytes{42};
+        string data(20000, '\0');
+        for (auto& c: data) {
+            c = (char)(random_bytes() % 256);
+        }
+        auto bytes{(const unsigned char*)data.data()};
+
+        vector<BlockSize> block_sizes{1, 3, 15, 16, 17, 31, 32, 33, 100, 6000};
+        BlockSize block_size{};
+        auto kernels{simd::supported_kernels()};
+        simd::Kernel kernel{};
+        DOCTEST_VALUE_PARAMETERIZED_DATA(kernel, kernels);
+
+        SUBCASE("block sums") {
+            DOCTEST_VALUE_PARAMETERIZED_DATA(block_size, block_sizes);
+
+            for (Offset offset: {0, 1, 7, 1000}) {
+                auto expected{checksum::block_sums(
+                    bytes + offset, 
+                    block_size, 
+                    simd::Kernel::Scalar
+                )};
+                auto sums{checksum::block_sums(bytes + offset, block_size, kernel)};
+
+                CHECK(sums.r1 == expected.r1);
+                CHECK(sums.r2 == expected.r2);
+                CHECK(
+                    checksum::to_signature(sums) 
+                    == 
+                    get_weak_signature(data, block_size, offset)
+                );
+            }
+        }
+        SUBCASE("rolling") {
+            DOCTEST_VALUE_PARAMETERIZED_DATA(block_size, block_sizes);
+
+            for (size_t count: {1, 3, 4, 7, 8, 9, 1000, 13999}) {
+                auto start{checksum::block_sums(bytes, block_size)};
+                vector<WeakSign> expected(count);
+                vector<WeakSign> signatures(count);
+
+                auto expected_end{checksum::roll(
+                    bytes, 
+                    block_size, 
+                    count, 
+                    start, 
+                    expected.data(), 
+                    simd::Kernel::Scalar
+                )};
+                auto end{checksum::roll(
+                    bytes, 
+                    block_size, 
+                    count, 
+                    start, 
+                    signatures.data(), 
+                    kernel
+                )};
+
+                CHECK(signatures == expected);
+                CHECK(end.r1 == expected_end.r1);
+                CHECK(end.r2 == expected_end.r2);
+                CHECK(
+                    signatures.back() 
+                    == 
+                    get_weak_signature(data, block_size, count)
+                );
+            }
+        }
+        SUBCASE("zero filled and saturated data") {
+            DOCTEST_VALUE_PARAMETERIZED_DATA(block_size, block_sizes);
+
+            for (char c: {'\0', '\xff'}) {
+                string uniform(block_size + 100, c);
+                auto uniform_bytes{(const unsigned char*)uniform.data()};
+                vector<WeakSign> expected(100);
+                vector<WeakSign> signatures(100);
+
+                auto start{checksum::block_sums(uniform_bytes, block_size, kernel)};
+                CHECK(
+                    checksum::to_signature(start) 
+                    == 
+                    get_weak_signature(uniform, block_size)
+                );
+
+                checksum::roll(
+                    uniform_bytes, 
+                    block_size, 
+                    100, 
+                    start, 
+                    expected.data(), 
+                    simd::Kernel::Scalar
+                );
+                checksum::roll(
+                    uniform_bytes, 
+                    block_size, 
+                    100, 
+                    start, 
+                    signatures.data(), 
+                    kernel
+                );
+
+                CHECK(signatures == expected);
+            }
+        }
+    }
+
+    TEST_CASE("signatures of blocks") {
+        mt19937 random_bytes{13};
+        string data(100000, '\0');
+        for (auto& c: data) {
+            c = (char)(random_bytes() % 256);
+        }
+
+        vector<size_t> sizes{0, 1, 6000, 100000};
+        size_t size{};
+        DOCTEST_VALUE_PARAMETERIZED_DATA(size, sizes);
+
+        istringstream data_stream{data.substr(0, size)};
+        auto blocks{get_block_signatures(data_stream, HASH_MD5, 6000)};
+
+        CHECK(blocks.block_size == 6000);
+        REQUIRE(blocks.weak.size() == (size + 5999) / 6000);
+        REQUIRE(blocks.strong.size() == blocks.weak.size());
+
+        for (size_t i{0}; i < blocks.weak.size(); i++) {
+            auto block{data.substr(i * 6000, min((size_t)6000, size - i * 6000))};
+
+            CHECK(blocks.weak[i] == get_weak_signature(block, block.size()));
+            CHECK(blocks.strong[i] == get_strong_signature(block));
+        }
+
+        SUBCASE("stored block signatures") {
+            auto signature{get_strong_signature(data.substr(0, size))};
+            msg::File file{"file", 0, size, signature, HASH_MD5, 0, 1, 2, 3, 4};
+            auto stored{msg::BlockSignatures{file, blocks}.to_signatures()};
+
+            CHECK(stored.block_size == blocks.block_size);
+            CHECK(stored.algorithm == blocks.algorithm);
+            CHECK(stored.weak == blocks.weak);
+            CHECK(stored.strong == blocks.strong);
+        }
+    }
+
+    TEST_CASE("block size per file") {
+        CHECK(get_block_size(0) == MIN_BLOCK_SIZE);
+        CHECK(get_block_size(7000) == MIN_BLOCK_SIZE);
+        CHECK(get_block_size(6000 * 6000) == 6000);
+        CHECK(get_block_size(6000 * 6000 + 1) == 6008);
+        CHECK(get_block_size(1000000000) == 31624);
+        CHECK(get_block_size(size_t{1} << 40) == MAX_BLOCK_SIZE);
+        CHECK(get_block_size(~size_t{0}) == MAX_BLOCK_SIZE);
+
+        // above the minimum
+        for (size_t size: {1000000, 123456789, 98765432}) {
+            CHECK(get_block_size(size) % 8 == 0);
+        }
+    }
+
+    TEST_CASE("strong signatures of many blocks") {
+        mt19937 random_bytes{17};
+        string data(64 * 6000, '\0');
+        for (auto& c: data) {
+            c = (char)random_bytes();
+        }
+
+        auto kernels{simd::supported_kernels()};
+        simd::Kernel kernel{};
+        DOCTEST_VALUE_PARAMETERIZED_DATA(kernel, kernels);
+
+        SUBCASE("MD5 in lanes") {
+            // around the sizes at which the padding needs another chunk
+            for (size_t block_size: {0, 1, 55, 56, 63, 64, 65, 119, 120, 6000}) {
+                for (size_t count: {1, 3, 4, 5, 8, 9, 17}) {
+                    vector<const unsigned char*> blocks{};
+                    for (size_t i{0}; i < count; i++) {
+                        // the blocks overlap and are not aligned
+                        blocks.push_back((const unsigned char*)data.data() + 7 * i + 1);
+                    }
+
+                    vector<StrongSign> digests(count);
+                    md5::hash_blocks(
+                        blocks.data(), 
+                        count, 
+                        block_size, 
+                        digests.data(), 
+                        kernel
+                    );
+
+                    for (size_t i{0}; i < count; i++) {
+                        CHECK(
+                            digests[i] 
+                            == 
+                            get_strong_signature(data.substr(7 * i + 1, block_size))
+                        );
+                    }
+                }
+            }
+        }
+
+        SUBCASE("batch of blocks") {
+            vector<const char*> blocks{};
+            for (size_t i{0}; i < 64; i++) {
+                blocks.push_back(data.data() + i * 6000);
+            }
+
+            for (auto algorithm: strong_hash::supported_algorithms()) {
+                auto signatures{get_strong_signatures(blocks, 6000, algorithm)};
+
+                REQUIRE(signatures.size() == blocks.size());
+                for (size_t i{0}; i < blocks.size(); i++) {
+                    CHECK(
+                        signatures[i] 
+                        == 
+                        get_strong_signature(data.substr(i * 6000, 6000), algorithm)
+                    );
+                }
+            }
+
+            CHECK(get_strong_signatures({}, 6000).empty());
+        }
+    }
+
+    TEST_CASE("strong signature length per file") {
+        CHECK(get_strong_signature_length(0, MIN_BLOCK_SIZE) == 2);
+        CHECK(get_strong_signature_length(1000000, get_block_size(1000000)) == 2);
+        CHECK(get_strong_signature_length(1000000000, get_block_size(1000000000)) == 3);
+        CHECK(get_strong_signature_length(size_t{1} << 40, MAX_BLOCK_SIZE) == 6);
+        CHECK(get_strong_signature_length(~size_t{0}, MAX_BLOCK_SIZE) <= StrongSign::length);
+
+        // longer for more blocks
+        CHECK(
+            get_strong_signature_length(size_t{1} << 40, MIN_BLOCK_SIZE)
+            >
+            get_strong_signature_length(size_t{1} << 40, MAX_BLOCK_SIZE)
+        );
+    }
+
+    TEST_CASE("content defined chunks") {
+        mt19937 random_bytes{11};
+        string data(STREAM_BUFFER_SIZE * 5 / 2, '\0');
+        for (auto& c: data) {
+            c = (char)(random_bytes() % 256);
+        }
+
+        auto chunks{get_chunks(data)};
+
+        SUBCASE("chunks cover the data within the size bounds") {
+            Offset offset{0};
+            for (size_t i{0}; i < chunks.size(); i++) {
+                REQUIRE(chunks[i].offset == offset);
+                CHECK(chunks[i].size <= MAX_CHUNK_SIZE);
+                if (i + 1 < chunks.size()) {
+                    CHECK(chunks[i].size >= MIN_CHUNK_SIZE);
+                }
+                CHECK(chunks[i].signature == get_weak_signature(data, chunks[i].size, offset));
+
+                offset += chunks[i].size;
+            }
+
+            CHECK(offset == data.size());
+            CHECK(chunks.size() > data.size() / MAX_CHUNK_SIZE);
+            CHECK(chunks.size() < data.size() / MIN_CHUNK_SIZE);
+        }
+
+        SUBCASE("istream larger than the stream buffer") {
+            istringstream data_stream{data};
+            auto streamed{get_chunks(data_stream, data.size())};
+
+            REQUIRE(streamed.size() == chunks.size());
+            for (size_t i{0}; i < chunks.size(); i++) {
+                CHECK(streamed[i].offset == chunks[i].offset);
+                CHECK(streamed[i].size == chunks[i].size);
+                CHECK(streamed[i].signature == chunks[i].signature);
+            }
+        }
+
+        SUBCASE("insertion changes only the chunks around it") {
+            string inserted{data};
+            inserted.insert(100000, "inserted");
+            auto inserted_chunks{get_chunks(inserted)};
+
+            size_t equal_chunks{0};
+            for (auto& chunk: inserted_chunks) {
+                equal_chunks += count_if(
+                    chunks.begin(), 
+                    chunks.end(), 
+                    [&](const Chunk& other){
+                        return 
+                            other.signature == chunk.signature 
+                            && 
+                            other.size == chunk.size;
+                    }
+                ) > 0;
+            }
+
+            CHECK(equal_chunks >= chunks.size() - 2);
+        }
+
+        SUBCASE("zero filled and small data") {
+            auto zeros{get_chunks(string(200000, '\0'))};
+
+            CHECK(zeros.size() == 4);
+            CHECK(zeros.back().size == 200000 - 3 * MAX_CHUNK_SIZE);
+            CHECK(get_chunks(string(100, 'a')).size() == 1);
+            CHECK(get_chunks("").empty());
         }
     }
 }
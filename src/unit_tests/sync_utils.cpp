@@ -5,6 +5,9 @@
 #include "messages/sync.pb.h"
 
 #include <doctest.h>
+#include <algorithm>
+#include <optional>
+#include <utility>
 #include <vector>
 
 using namespace std;
@@ -192,6 +195,36 @@ TEST_SUITE("sync_utils") {
             CHECK(in_between[0]->size_client() == 0);
             CHECK(in_between[0]->size_server() == 333);
         }
+
+        SUBCASE("the missing blocks within a gap") {
+            auto gap{block_pair("D", 1000, 2000, 400, 500)};
+            vector<BlockPair*> blocks{
+                block_pair("D", 1100, 2300, 100)
+            };
+
+            auto in_between{get_block_pairs_between(blocks, *gap)};
+
+            REQUIRE(in_between.size() == 2);
+
+            CHECK(in_between[0]->offset_client() == 1000);
+            CHECK(in_between[0]->offset_server() == 2000);
+            CHECK(in_between[0]->size_client() == 100);
+            CHECK(in_between[0]->size_server() == 300);
+
+            CHECK(in_between[1]->offset_client() == 1200);
+            CHECK(in_between[1]->offset_server() == 2400);
+            CHECK(in_between[1]->size_client() == 200);
+            CHECK(in_between[1]->size_server() == 100);
+
+            vector<BlockPair*> none{};
+            auto whole{get_block_pairs_between(none, *gap)};
+
+            REQUIRE(whole.size() == 1);
+            CHECK(whole[0]->offset_client() == 1000);
+            CHECK(whole[0]->offset_server() == 2000);
+            CHECK(whole[0]->size_client() == 400);
+            CHECK(whole[0]->size_server() == 500);
+        }
     }
 
     TEST_CASE("get_data_spaces") {
@@ -368,4 +401,250 @@ TEST_SUITE("sync_utils") {
             REQUIRE(all.size() == 0);
         }
     }
-} 
+
+    TEST_CASE("SignatureIndex") {
+        vector<WeakSign> signatures{7, 0x10001, 7, 0x20000, 7, 0xffffffff};
+        SignatureIndex index{signatures, 10};
+
+        SUBCASE("contains all signatures") {
+            for (auto signature: signatures) {
+                CHECK(index.may_contain(signature));
+            }
+        }
+
+        SUBCASE("takes the offsets in ascending order") {
+            CHECK(index.take(7, 0) == 0);
+            CHECK(index.take(7, 0) == 20);
+            CHECK(index.take(7, 0) == 40);
+            CHECK(index.take(7, 0) == nullopt);
+        }
+
+        SUBCASE("drops offsets smaller than the minimum") {
+            CHECK(index.take(7, 15) == 20);
+            CHECK(index.take(7, 0) == 40);
+            CHECK(index.take(7, 0) == nullopt);
+        }
+
+        SUBCASE("signatures with the same tag are distinct") {
+            // 0x10001 and 0x20000 have the same tag
+            CHECK(index.take(0x20000, 0) == 30);
+            CHECK(index.take(0x20000, 0) == nullopt);
+            CHECK(index.take(0x10001, 0) == 10);
+            CHECK(index.take(0x10001, 0) == nullopt);
+        }
+
+        SUBCASE("signature of the empty slots") {
+            CHECK(index.take(0xffffffff, 0) == 50);
+            CHECK(index.take(0xffffffff, 0) == nullopt);
+        }
+
+        SUBCASE("unknown signatures") {
+            CHECK(index.take(8, 0) == nullopt);
+            CHECK(index.take(0x30000 - 1, 0) == nullopt);
+            CHECK(SignatureIndex({}, 10).take(0xffffffff, 0) == nullopt);
+        }
+
+        SUBCASE("only accepted offsets are taken") {
+            auto odd_tens{[](Offset offset){ return offset / 10 % 2 == 1; }};
+
+            CHECK(index.take(7, 0, odd_tens) == nullopt);
+            CHECK(index.take(7, 0, [](Offset offset){ return offset == 20; }) == 20);
+            CHECK(index.take(7, 0) == 0);
+            CHECK(index.take(7, 21) == 40);
+        }
+
+        SUBCASE("many equal signatures") {
+            SignatureIndex uniform{vector<WeakSign>(100000, 0), 6000};
+
+            bool ascending{true};
+            for (Offset i{0}; i < 100000; i++) {
+                ascending = ascending && uniform.take(0, i * 6000) == i * 6000;
+            }
+            CHECK(ascending);
+            CHECK(uniform.take(0, 0) == nullopt);
+        }
+    }
+
+    TEST_CASE("BlockMatcher") {
+        vector<WeakSign> client_signatures{11, 22, 33, 22};
+        vector<WeakSign> local_signatures{
+            0, 0, 11, 22, 0, 0, 22, 0, 0, 0, 33, 0, 
+            0, 0, 11, 0, 0, 0, 22, 0, 0, 0, 0, 0
+        };
+        vector<pair<Offset, Offset>> expected_matches{
+            {0, 2}, {4, 6}, {8, 10}, {12, 18}
+        };
+
+        SUBCASE("all signatures in one batch") {
+            BlockMatcher matcher{client_signatures, 4};
+            matcher.consume(0, local_signatures);
+
+            CHECK(matcher.get_matches() == expected_matches);
+            // the blocks after the first match follow without the index
+            CHECK(matcher.get_extended_count() == 2);
+        }
+
+        SUBCASE("signatures in multiple batches") {
+            vector<size_t> batch_sizes{1, 2, 3, 5, 7, 24};
+            size_t batch_size{};
+            DOCTEST_VALUE_PARAMETERIZED_DATA(batch_size, batch_sizes);
+
+            BlockMatcher matcher{client_signatures, 4};
+            for (size_t offset{0}; 
+                offset < local_signatures.size(); 
+                offset += batch_size
+            ) {
+                matcher.consume(
+                    offset, 
+                    vector<WeakSign>(
+                        local_signatures.begin() + offset,
+                        local_signatures.begin() 
+                            + min(offset + batch_size, local_signatures.size())
+                ));
+            }
+
+            CHECK(matcher.get_matches() == expected_matches);
+        }
+
+        SUBCASE("blocks of an extended run are not matched again") {
+            BlockMatcher matcher{{7, 7, 7}, 2};
+            matcher.consume(0, {7, 0, 7, 0, 0, 7, 0, 7, 0});
+
+            CHECK(
+                matcher.get_matches() 
+                == 
+                vector<pair<Offset, Offset>>{{0, 0}, {2, 2}, {4, 5}}
+            );
+            CHECK(matcher.get_extended_count() == 1);
+        }
+
+        SUBCASE("64 bit signatures are compared in full") {
+            // 1 << 32 and 1 have the same key in the index
+            BlockMatcher64 matcher{{1ul << 32, 1, 2}, 2};
+            matcher.consume(0, {1, 0, 2, 0});
+
+            CHECK(
+                matcher.get_matches() 
+                == 
+                vector<pair<Offset, Offset>>{{2, 0}, {4, 2}}
+            );
+            CHECK(matcher.get_rejected_count() == 1);
+        }
+
+        SUBCASE("no client signatures") {
+            BlockMatcher matcher{{}, 4};
+            matcher.consume(0, local_signatures);
+
+            CHECK(matcher.get_matches().empty());
+        }
+    }
+
+    TEST_CASE("match_chunks") {
+        vector<Chunk> client_chunks{
+            {0, 10, 1}, {10, 20, 2}, {30, 5, 3}, {35, 10, 1}, {45, 10, 4}
+        };
+
+        SUBCASE("equal chunks at other offsets") {
+            vector<Chunk> local_chunks{
+                {0, 7, 9}, {7, 10, 1}, {17, 20, 2}, {37, 6, 3}, {43, 10, 4}
+            };
+            auto matches{match_chunks(client_chunks, local_chunks)};
+
+            REQUIRE(matches.size() == 3);
+            CHECK(matches[0].first.offset == 0);
+            CHECK(matches[0].second.offset == 7);
+            CHECK(matches[1].first.offset == 10);
+            CHECK(matches[1].second.offset == 17);
+            CHECK(matches[2].first.offset == 45);
+            CHECK(matches[2].second.offset == 43);
+        }
+
+        SUBCASE("matches are ascending in both files") {
+            vector<Chunk> local_chunks{{0, 10, 4}, {10, 10, 1}, {20, 10, 1}};
+            auto matches{match_chunks(client_chunks, local_chunks)};
+
+            // client chunks in front of the last match are not taken anymore
+            REQUIRE(matches.size() == 1);
+            CHECK(matches[0].first.offset == 45);
+            CHECK(matches[0].second.offset == 0);
+        }
+
+        SUBCASE("chunks with the same signature but another size") {
+            vector<Chunk> local_chunks{{0, 11, 1}, {11, 20, 2}};
+            auto matches{match_chunks(client_chunks, local_chunks)};
+
+            REQUIRE(matches.size() == 1);
+            CHECK(matches[0].first.offset == 10);
+            CHECK(matches[0].second.offset == 11);
+        }
+
+        SUBCASE("a chunk with a colliding key doesn't take the client chunk") {
+            // the key of the first client chunk, for a chunk of size 20
+            WeakSign colliding{1u ^ (10 * 2654435761u) ^ (20 * 2654435761u)};
+            vector<Chunk> local_chunks{{0, 20, colliding}, {20, 10, 1}};
+            auto matches{match_chunks(client_chunks, local_chunks)};
+
+            REQUIRE(matches.size() == 1);
+            CHECK(matches[0].first.offset == 0);
+            CHECK(matches[0].second.offset == 20);
+        }
+
+        SUBCASE("no chunks") {
+            CHECK(match_chunks({}, client_chunks).empty());
+            CHECK(match_chunks(client_chunks, {}).empty());
+        }
+    }
+
+    TEST_CASE("refined block size") {
+        CHECK(get_refined_block_size(6000, 64) == 1500);
+        CHECK(get_refined_block_size(200, 64) == 64);
+        CHECK(get_refined_block_size(64, 64) == 64);
+        // the floor is never below the smallest refined block size
+        CHECK(get_refined_block_size(64, 1) == MIN_REFINED_BLOCK_SIZE);
+    }
+
+    TEST_CASE("strong signature length of refined blocks") {
+        CHECK(get_refined_strong_signature_length(1000, 32) == MIN_REFINED_STRONG_SIGNATURE_LENGTH);
+        CHECK(get_refined_strong_signature_length(1'000'000'000, 32) == 8);
+        CHECK(get_refined_strong_signature_length(size_t{1} << 60, 32) == 12);
+    }
+
+    TEST_CASE("ranges") {
+        SUBCASE("top range size") {
+            CHECK(get_top_range_size(0, 8) == 8);
+            CHECK(get_top_range_size(8 * 256, 8) == 8);
+            CHECK(get_top_range_size(8 * 256 + 1, 8) == 8 * 16);
+            CHECK(get_top_range_size(8 * 16 * 256, 8) == 8 * 16);
+
+            size_t file_size{1'000'000'000};
+            auto range_size{get_top_range_size(file_size, 1024)};
+            CHECK(range_size % 1024 == 0);
+            CHECK(file_size <= range_size * RANGE_FAN_OUT * RANGE_FAN_OUT);
+        }
+
+        SUBCASE("ranges are clipped to the file") {
+            CHECK(
+                get_ranges({0, 10, 20, 30}, 10, 25) 
+                == 
+                vector<pair<Offset, size_t>>{{0, 10}, {10, 10}, {20, 5}}
+            );
+        }
+
+        SUBCASE("sub ranges") {
+            CHECK(
+                get_sub_range_offsets({0, 64}, 32, 1000) 
+                == 
+                vector<Offset>{0, 2, 4, 6, 8, 10, 12, 14, 16, 18, 20, 22, 24, 26, 28, 30,
+                    64, 66, 68, 70, 72, 74, 76, 78, 80, 82, 84, 86, 88, 90, 92, 94}
+            );
+            CHECK(get_sub_range_offsets({32}, 32, 37) == vector<Offset>{32, 34, 36});
+        }
+
+        SUBCASE("tail") {
+            CHECK(get_range_tail(100, 100, 8) == 100);
+            CHECK(get_range_tail(100, 90, 8) == 88);
+            CHECK(get_range_tail(80, 90, 8) == 80);
+            CHECK(get_range_tail(0, 90, 8) == 0);
+        }
+    }
+}
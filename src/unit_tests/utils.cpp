@@ -1,10 +1,16 @@
 #include "utils.h"
+#include "base64_kernels.h"
 #include "config.h"
+#include "simd.h"
 #include "unit_tests/doctest_utils.h"
 
 #include <doctest.h>
 #include <filesystem>
 #include <optional>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
 #include <tuple>
 #include <unordered_map>
 #include <vector>
@@ -157,6 +163,157 @@ TEST_SUITE("utils") {
         }
     } 
 
+    TEST_CASE("base 64 kernels") {
+        mt19937 random_bytes{42};
+        string data(5000, '\0');
+        for (auto& byte: data) {
+            byte = (char)random_bytes();
+        }
+
+        auto kernels{simd::supported_kernels()};
+        simd::Kernel kernel;
+
+        SUBCASE("all sizes round trip and equal the scalar encoding") {
+            DOCTEST_VALUE_PARAMETERIZED_DATA(kernel, kernels);
+
+            for (size_t size: {0, 1, 2, 3, 11, 12, 13, 16, 23, 24, 25, 28, 47, 48, 99, 1000, 4999, 5000}) {
+                string scalar(base64::encoded_size(size), '\0');
+                base64::encode(
+                    (const unsigned char*)data.data(), size, scalar.data(), 
+                    simd::Kernel::Scalar
+                );
+
+                string encoded(base64::encoded_size(size), '\0');
+                base64::encode(
+                    (const unsigned char*)data.data(), size, encoded.data(), kernel
+                );
+                CHECK(encoded == scalar);
+
+                string decoded(base64::decoded_size(encoded.size()), '\0');
+                auto decoded_size{base64::decode(
+                    encoded.data(), encoded.size(), (unsigned char*)decoded.data(), kernel
+                )};
+                REQUIRE(decoded_size.has_value());
+                CHECK(decoded.substr(0, decoded_size.value()) == data.substr(0, size));
+            }
+        }
+
+        SUBCASE("invalid chars are found at any position") {
+            DOCTEST_VALUE_PARAMETERIZED_DATA(kernel, kernels);
+
+            string encoded{to_base64(data.substr(0, 300))};
+            string decoded(base64::decoded_size(encoded.size()), '\0');
+
+            for (size_t position: {0, 5, 31, 32, 63, 64, 100, 397, 398, 399}) {
+                for (char invalid: {'*', '=', '\n', '\x80', '\xff', '\0'}) {
+                    string corrupted{encoded};
+                    corrupted[position] = invalid;
+
+                    // a padding char only fits at the end
+                    if (invalid == '=' && position == 399) {
+                        continue;
+                    }
+
+                    CHECK_FALSE(base64::decode(
+                        corrupted.data(), corrupted.size(), 
+                        (unsigned char*)decoded.data(), kernel
+                    ).has_value());
+                }
+            }
+        }
+    }
+
+    TEST_CASE("base 64 padding") {
+        CHECK(from_base64("QUI") == "AB");
+        CHECK(from_base64("QQ") == "A");
+        CHECK(from_base64("") == "");
+        CHECK_THROWS_AS(from_base64("Q"), invalid_argument);
+        CHECK_THROWS_AS(from_base64("QUJD="), invalid_argument);
+        CHECK_THROWS_AS(from_base64("Q==="), invalid_argument);
+        CHECK_THROWS_AS(from_base64("QU=D"), invalid_argument);
+    }
+
+    TEST_CASE("message framing") {
+        Message sync_request{};
+        sync_request.mutable_sync_request()->mutable_file()->set_name("a\nb");
+        sync_request.mutable_sync_request()->set_strong_signatures(
+            string{"\0\n\xff\r", 4}
+        );
+        for (unsigned int i{0}; i < 1000; i++) {
+            sync_request.mutable_sync_request()->add_weak_signatures(i * 2654435761u);
+        }
+
+        Message finish{};
+        finish.set_finish(true);
+
+        vector<Framing> framings{FRAMING_BASE64, FRAMING_BINARY};
+        Framing framing;
+
+        SUBCASE("messages in a row are read again") {
+            DOCTEST_VALUE_PARAMETERIZED_DATA(framing, framings);
+
+            stringstream frames{};
+            frames << msg_to_frame(sync_request, framing) 
+                   << msg_to_frame(Message{}, framing) 
+                   << msg_to_frame(finish, framing);
+
+            CHECK(
+                msg_from_frame(frames, framing).SerializeAsString() 
+                == sync_request.SerializeAsString()
+            );
+            CHECK(msg_from_frame(frames, framing).message_case() == Message::MESSAGE_NOT_SET);
+            CHECK(msg_from_frame(frames, framing).finish());
+            CHECK(frames);
+
+            msg_from_frame(frames, framing);
+            CHECK_FALSE(frames);
+        }
+
+        SUBCASE("a truncated binary frame fails the stream") {
+            string frame{msg_to_frame(sync_request, FRAMING_BINARY)};
+            stringstream frames{frame.substr(0, frame.size() / 2)};
+
+            msg_from_frame(frames, FRAMING_BINARY);
+            CHECK_FALSE(frames);
+        }
+
+        SUBCASE("an oversize binary frame fails the stream") {
+            size_t size{MAX_FRAME_SIZE + 1};
+            stringstream frames{
+                string{
+                    (char)(size >> 24), 
+                    (char)(size >> 16), 
+                    (char)(size >> 8), 
+                    (char)size
+                } 
+                + finish.SerializeAsString()
+            };
+
+            msg_from_frame(frames, FRAMING_BINARY);
+            CHECK_FALSE(frames);
+        }
+    }
+
+    TEST_CASE("binary frames") {
+        Message finish{};
+        finish.set_finish(true);
+
+        string frame{msg_to_frame(finish, FRAMING_BINARY)};
+
+        CHECK(frame == string{"\0\0\0\x02", 4} + finish.SerializeAsString());
+
+        Message file_request{};
+        file_request.mutable_file_request()->mutable_file()->set_name(string(300, 'a'));
+
+        CHECK(
+            msg_to_frame(file_request, FRAMING_BINARY).size() 
+            < msg_to_frame(file_request, FRAMING_BASE64).size()
+        );
+
+        CHECK(get_framing("binary") == FRAMING_BINARY);
+        CHECK(get_framing("base64") == FRAMING_BASE64);
+    }
+
     TEST_CASE("unordered_map contains") {
         unordered_map<string, string> map{
             {"A", ""}, {"B", ""}, {"C", ""}